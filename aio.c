@@ -0,0 +1,994 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif /* HAVE_LIBURING */
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "aio.h"
+#include "examples.h"
+
+#define AIO_METATABLE "aio.op"
+
+/* Default read size and listen backlog */
+#define DEFAULT_READ 4096
+#define DEFAULT_BACKLOG 128
+
+/* Events taken from the kernel per poll */
+#define MAX_EVENTS 64
+
+/* Submission queue size */
+#define URING_ENTRIES 256
+
+#define BACKEND_EPOLL 0
+#define BACKEND_URING 1
+
+#define OP_READ	  0
+#define OP_RECV	  1
+#define OP_ACCEPT 2
+#define OP_WRITE  3
+
+struct aio_op {
+	struct aio *aio; /* NULL once the event loop is gone */
+	int kind;
+	int fd;
+	char *buf;	 /* read buffer or copy of the data to write */
+	size_t len;	 /* buffer size */
+	size_t done;	 /* bytes written so far */
+	int result;	 /* io_uring completion: count, fd or -errno */
+	int in_flight;	 /* watched or submitted */
+	int orphaned;	 /* Lua handle collected while submitted */
+
+	/* Operations in flight */
+	struct aio_op *prev;
+	struct aio_op *next;
+};
+
+/* epoll interest of a descriptor, one operation per direction */
+struct watch {
+	struct aio_op *reader;
+	struct aio_op *writer;
+	uint32_t events; /* registered mask, 0 if not in the epoll set */
+	int known;	 /* already switched to non-blocking mode */
+};
+
+struct aio {
+	struct scheduler *s;
+	lua_State *L;
+	int backend;
+
+	struct aio_op *in_flight;
+	size_t pending;
+	int wake_fd; /* see scheduler_wake_fd */
+
+	/* epoll backend, indexed by descriptor */
+	int epfd;
+	struct watch *watches;
+	size_t nwatches;
+
+#ifdef HAVE_LIBURING
+	struct io_uring ring;
+	unsigned unsubmitted;
+	int wake_armed; /* poll on wake_fd submitted */
+#endif /* HAVE_LIBURING */
+};
+
+static void
+op_free(struct aio_op *op)
+{
+	free(op->buf);
+	free(op);
+}
+
+static void
+link_op(struct aio *a, struct aio_op *op)
+{
+	op->prev = NULL;
+	op->next = a->in_flight;
+	if (a->in_flight != NULL) {
+		a->in_flight->prev = op;
+	}
+	a->in_flight = op;
+	op->in_flight = 1;
+	a->pending++;
+}
+
+static void
+unlink_op(struct aio *a, struct aio_op *op)
+{
+	if (op->prev != NULL) {
+		op->prev->next = op->next;
+	} else {
+		a->in_flight = op->next;
+	}
+	if (op->next != NULL) {
+		op->next->prev = op->prev;
+	}
+	op->in_flight = 0;
+	a->pending--;
+}
+
+static int
+set_nonblock(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Wake the task waiting on op, see op_yield */
+static void
+wake(struct aio *a, struct aio_op *op)
+{
+	lua_pushlightuserdata(a->L, op);
+	scheduler_notify(a->s, a->L, -1);
+	lua_pop(a->L, 1);
+}
+
+/*
+ * epoll backend: level triggered readiness, the operation itself is done
+ * by the continuation.
+ */
+
+static struct watch *
+get_watch(struct aio *a, int fd)
+{
+	if ((size_t)fd >= a->nwatches) {
+		size_t n = a->nwatches > 0 ? a->nwatches : 64;
+
+		while (n <= (size_t)fd) {
+			n *= 2;
+		}
+
+		struct watch *w = realloc(a->watches, n * sizeof(*w));
+		if (w == NULL) {
+			return NULL;
+		}
+
+		memset(w + a->nwatches, 0, (n - a->nwatches) * sizeof(*w));
+		a->watches = w;
+		a->nwatches = n;
+	}
+
+	return &a->watches[fd];
+}
+
+static int
+update_watch(struct aio *a, int fd, struct watch *w)
+{
+	struct epoll_event ev = { 0 };
+
+	ev.events = (w->reader != NULL ? EPOLLIN : 0) |
+	    (w->writer != NULL ? EPOLLOUT : 0);
+	ev.data.fd = fd;
+
+	if (ev.events == w->events) {
+		return 0;
+	}
+
+	int op = ev.events == 0 ? EPOLL_CTL_DEL
+	    : w->events == 0	? EPOLL_CTL_ADD
+				: EPOLL_CTL_MOD;
+
+	if (epoll_ctl(a->epfd, op, fd, &ev) < 0) {
+		return -1;
+	}
+	w->events = ev.events;
+
+	return 0;
+}
+
+static int
+watch_op(struct aio *a, struct aio_op *op)
+{
+	struct watch *w = get_watch(a, op->fd);
+
+	if (w == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	struct aio_op **slot = op->kind == OP_WRITE ? &w->writer : &w->reader;
+
+	if (*slot != NULL) {
+		errno = EBUSY; /* another task is already waiting */
+		return -1;
+	}
+
+	*slot = op;
+	if (update_watch(a, op->fd, w) < 0) {
+		*slot = NULL;
+		return -1;
+	}
+	link_op(a, op);
+
+	return 0;
+}
+
+static void
+unwatch_op(struct aio *a, struct aio_op *op)
+{
+	struct watch *w = &a->watches[op->fd];
+
+	if (w->reader == op) {
+		w->reader = NULL;
+	}
+	if (w->writer == op) {
+		w->writer = NULL;
+	}
+	update_watch(a, op->fd, w);
+	unlink_op(a, op);
+}
+
+static int
+epoll_poll(struct aio *a, int timeout)
+{
+	struct epoll_event events[MAX_EVENTS];
+
+	int n = epoll_wait(a->epfd, events, MAX_EVENTS, timeout);
+	if (n < 0) {
+		return 0; /* interrupted */
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (events[i].data.fd == a->wake_fd) {
+			continue; /* the scheduler takes its wakeups */
+		}
+
+		struct watch *w = &a->watches[events[i].data.fd];
+		uint32_t ev = events[i].events;
+		struct aio_op *reader = w->reader;
+		struct aio_op *writer = w->writer;
+
+		/* Errors and hangups are reported by the retried call */
+		if (reader != NULL && (ev & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+			unwatch_op(a, reader);
+			wake(a, reader);
+		}
+		if (writer != NULL &&
+		    (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+			unwatch_op(a, writer);
+			wake(a, writer);
+		}
+	}
+
+	return n;
+}
+
+#ifdef HAVE_LIBURING
+/*
+ * io_uring backend: the operation is submitted as is and the task gets
+ * the completion. Submissions are batched until the next poll.
+ */
+
+static int
+uring_submit(struct aio *a, struct aio_op *op)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&a->ring);
+
+	if (sqe == NULL) {
+		/* Queue full, flush it */
+		io_uring_submit(&a->ring);
+		a->unsubmitted = 0;
+		sqe = io_uring_get_sqe(&a->ring);
+		if (sqe == NULL) {
+			errno = EBUSY;
+			return -1;
+		}
+	}
+
+	switch (op->kind) {
+	case OP_READ:
+		io_uring_prep_read(sqe, op->fd, op->buf, op->len, -1);
+		break;
+	case OP_RECV:
+		io_uring_prep_recv(sqe, op->fd, op->buf, op->len, 0);
+		break;
+	case OP_ACCEPT:
+		io_uring_prep_accept(sqe, op->fd, NULL, NULL, SOCK_CLOEXEC);
+		break;
+	case OP_WRITE:
+		io_uring_prep_write(sqe, op->fd, op->buf + op->done,
+		    op->len - op->done, -1);
+		break;
+	}
+	io_uring_sqe_set_data(sqe, op);
+	a->unsubmitted++;
+	link_op(a, op);
+
+	return 0;
+}
+
+static int
+uring_poll(struct aio *a, int timeout)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	/* Channel wakeups of the scheduler end the wait too */
+	if (!a->wake_armed) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&a->ring);
+
+		if (sqe != NULL) {
+			io_uring_prep_poll_add(sqe, a->wake_fd, POLLIN);
+			io_uring_sqe_set_data(sqe, NULL);
+			a->unsubmitted++;
+			a->wake_armed = 1;
+		}
+	}
+
+	if (a->unsubmitted > 0) {
+		io_uring_submit(&a->ring);
+		a->unsubmitted = 0;
+	}
+
+	if (timeout == 0) {
+		ret = io_uring_peek_cqe(&a->ring, &cqe);
+	} else if (timeout < 0) {
+		ret = io_uring_wait_cqe(&a->ring, &cqe);
+	} else {
+		struct __kernel_timespec ts = { timeout / 1000,
+			(timeout % 1000) * 1000000 };
+
+		ret = io_uring_wait_cqe_timeout(&a->ring, &cqe, &ts);
+	}
+	if (ret < 0) {
+		return 0; /* nothing completed in time */
+	}
+
+	unsigned head;
+	int n = 0;
+
+	io_uring_for_each_cqe(&a->ring, head, cqe)
+	{
+		struct aio_op *op = io_uring_cqe_get_data(cqe);
+
+		n++;
+		if (op == NULL) {
+			a->wake_armed = 0; /* wake_fd readable */
+			continue;
+		}
+		op->result = cqe->res;
+		unlink_op(a, op);
+		if (op->orphaned) {
+			op_free(op);
+		} else {
+			wake(a, op);
+		}
+	}
+	io_uring_cq_advance(&a->ring, n);
+
+	return n;
+}
+
+/**
+ * Cancel every operation in flight and wait for their completions, the
+ * kernel may write to their buffers until then.
+ */
+static void
+uring_drain(struct aio *a)
+{
+	for (struct aio_op *op = a->in_flight; op != NULL; op = op->next) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&a->ring);
+
+		if (sqe == NULL) {
+			io_uring_submit(&a->ring);
+			sqe = io_uring_get_sqe(&a->ring);
+		}
+		if (sqe != NULL) {
+			io_uring_prep_cancel(sqe, op, 0);
+			io_uring_sqe_set_data(sqe, NULL);
+		}
+	}
+	io_uring_submit(&a->ring);
+	a->unsubmitted = 0;
+
+	while (a->pending > 0) {
+		struct io_uring_cqe *cqe;
+		int ret = io_uring_wait_cqe(&a->ring, &cqe);
+
+		if (ret == -EINTR) {
+			continue;
+		}
+		if (ret < 0) {
+			break;
+		}
+
+		struct aio_op *op = io_uring_cqe_get_data(cqe);
+
+		io_uring_cqe_seen(&a->ring, cqe);
+		if (op == NULL) {
+			continue; /* a cancellation or the wake_fd poll */
+		}
+		unlink_op(a, op);
+		op->aio = NULL;
+		if (op->orphaned) {
+			op_free(op);
+		}
+	}
+}
+#endif /* HAVE_LIBURING */
+
+static int
+aio_poll(void *ud, int timeout)
+{
+	struct aio *a = ud;
+
+	if (a->pending == 0) {
+		return -1;
+	}
+
+#ifdef HAVE_LIBURING
+	if (a->backend == BACKEND_URING) {
+		return uring_poll(a, timeout);
+	}
+#endif /* HAVE_LIBURING */
+
+	return epoll_poll(a, timeout);
+}
+
+/*
+ * Operations
+ */
+
+/*
+ * Make sure fd is in the mode the backend expects, `fresh` descriptors
+ * were just created by us and may reuse the number of a stale entry.
+ */
+static void
+prepare_fd(struct aio *a, int fd, int fresh)
+{
+	if (a->backend != BACKEND_EPOLL) {
+		return;
+	}
+
+	struct watch *w = get_watch(a, fd);
+	if (w != NULL && (fresh || !w->known)) {
+		set_nonblock(fd);
+		w->known = 1;
+	}
+}
+
+static ssize_t
+op_syscall(struct aio_op *op)
+{
+	switch (op->kind) {
+	case OP_READ:
+		return read(op->fd, op->buf, op->len);
+	case OP_RECV:
+		return recv(op->fd, op->buf, op->len, 0);
+	case OP_ACCEPT:
+		return accept(op->fd, NULL, NULL);
+	default:
+		return write(op->fd, op->buf + op->done, op->len - op->done);
+	}
+}
+
+/* Block until op can go on, for callers that can't yield */
+static void
+op_block(struct aio_op *op)
+{
+	struct pollfd pfd = { op->fd, op->kind == OP_WRITE ? POLLOUT : POLLIN,
+		0 };
+
+	poll(&pfd, 1, -1);
+}
+
+static int
+op_error(lua_State *L, int err)
+{
+	errno = err;
+
+	return luaL_fileresult(L, 0, NULL);
+}
+
+/*
+ * Account `n` bytes done. Returns 1 with the result pushed when op is
+ * complete, 0 when a partial write must go on.
+ */
+static int
+op_complete(lua_State *L, struct aio_op *op, ssize_t n)
+{
+	switch (op->kind) {
+	case OP_READ:
+	case OP_RECV:
+		lua_pushlstring(L, op->buf, n);
+		break;
+	case OP_ACCEPT:
+		if (op->aio != NULL) {
+			prepare_fd(op->aio, n, 1);
+		}
+		lua_pushinteger(L, n);
+		break;
+	default:
+		op->done += n;
+		if (op->done < op->len) {
+			return 0;
+		}
+		lua_pushinteger(L, op->done);
+		break;
+	}
+
+	/* Done with the buffer, the handle goes with the stack */
+	free(op->buf);
+	op->buf = NULL;
+
+	return 1;
+}
+
+static int op_k(lua_State *L, int status, lua_KContext ctx);
+
+/* Park the task until op makes progress, the handle stays at `idx`. */
+static int
+op_yield(lua_State *L, struct aio_op *op, int idx)
+{
+	lua_pushliteral(L, "wait");
+	lua_pushlightuserdata(L, op);
+
+	return lua_yieldk(L, 2, idx, op_k);
+}
+
+/* Do the call now, or wait for readiness (epoll) and try again. */
+static int
+op_try(lua_State *L, struct aio_op *op, int idx)
+{
+	for (;;) {
+		ssize_t n = op_syscall(op);
+
+		if (n >= 0) {
+			if (op_complete(L, op, n)) {
+				return 1;
+			}
+			continue;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			return op_error(L, errno);
+		}
+
+		if (op->aio == NULL || !lua_isyieldable(L)) {
+			op_block(op);
+			continue;
+		}
+		if (watch_op(op->aio, op) < 0) {
+			return op_error(L, errno);
+		}
+
+		return op_yield(L, op, idx);
+	}
+}
+
+/* Start op, with its handle at the top of the stack */
+static int
+op_start(lua_State *L, struct aio_op *op)
+{
+	int idx = lua_gettop(L);
+
+#ifdef HAVE_LIBURING
+	if (op->aio->backend == BACKEND_URING && lua_isyieldable(L)) {
+		if (uring_submit(op->aio, op) < 0) {
+			return op_error(L, errno);
+		}
+
+		return op_yield(L, op, idx);
+	}
+#endif /* HAVE_LIBURING */
+
+	return op_try(L, op, idx);
+}
+
+static int
+op_k(lua_State *L, __UNUSED int status, lua_KContext ctx)
+{
+	int idx = (int)ctx;
+	struct aio_op *op = *(struct aio_op **)lua_touserdata(L, idx);
+
+	if (op->aio == NULL) {
+		return op_error(L, ECANCELED);
+	}
+
+#ifdef HAVE_LIBURING
+	if (op->aio->backend == BACKEND_URING) {
+		if (op->result < 0) {
+			return op_error(L, -op->result);
+		}
+		if (op_complete(L, op, op->result)) {
+			return 1;
+		}
+		if (uring_submit(op->aio, op) < 0) {
+			return op_error(L, errno);
+		}
+
+		return op_yield(L, op, idx);
+	}
+#endif /* HAVE_LIBURING */
+
+	return op_try(L, op, idx);
+}
+
+static int
+op_gc(lua_State *L)
+{
+	struct aio_op *op = *(struct aio_op **)lua_touserdata(L, 1);
+
+	if (op == NULL) {
+		return 0;
+	}
+
+	if (op->in_flight && op->aio != NULL) {
+		if (op->aio->backend == BACKEND_URING) {
+			/* The kernel still owns the buffer */
+			op->orphaned = 1;
+			return 0;
+		}
+		unwatch_op(op->aio, op);
+	}
+	op_free(op);
+
+	return 0;
+}
+
+static struct aio *
+to_aio(lua_State *L)
+{
+	return lua_touserdata(L, lua_upvalueindex(1));
+}
+
+/*
+ * Push the handle of a new operation. Its buffer holds `len` bytes, copied
+ * from `data` if given.
+ */
+static struct aio_op *
+new_op(lua_State *L, int kind, int fd, const char *data, size_t len)
+{
+	struct aio *a = to_aio(L);
+	struct aio_op **box = lua_newuserdatauv(L, sizeof(*box), 0);
+
+	*box = NULL;
+	luaL_setmetatable(L, AIO_METATABLE);
+
+	struct aio_op *op = calloc(1, sizeof(*op));
+	if (op == NULL || (len > 0 && (op->buf = malloc(len)) == NULL)) {
+		free(op);
+		luaL_error(L, "not enough memory");
+		return NULL;
+	}
+
+	op->aio = a;
+	op->kind = kind;
+	op->fd = fd;
+	op->len = len;
+	if (data != NULL) {
+		memcpy(op->buf, data, len);
+	}
+	*box = op;
+
+	prepare_fd(a, fd, 0);
+
+	return op;
+}
+
+static lua_Integer
+check_size(lua_State *L, int arg)
+{
+	lua_Integer n = luaL_optinteger(L, arg, DEFAULT_READ);
+
+	luaL_argcheck(L, n > 0, arg, "size must be positive");
+
+	return n;
+}
+
+static int
+aio_read(lua_State *L)
+{
+	int fd = luaL_checkinteger(L, 1);
+	lua_Integer n = check_size(L, 2);
+
+	return op_start(L, new_op(L, OP_READ, fd, NULL, n));
+}
+
+static int
+aio_recv(lua_State *L)
+{
+	int fd = luaL_checkinteger(L, 1);
+	lua_Integer n = check_size(L, 2);
+
+	return op_start(L, new_op(L, OP_RECV, fd, NULL, n));
+}
+
+static int
+aio_write(lua_State *L)
+{
+	int fd = luaL_checkinteger(L, 1);
+	size_t len;
+	const char *data = luaL_checklstring(L, 2, &len);
+
+	if (len == 0) {
+		lua_pushinteger(L, 0);
+		return 1;
+	}
+
+	return op_start(L, new_op(L, OP_WRITE, fd, data, len));
+}
+
+static int
+aio_accept(lua_State *L)
+{
+	int fd = luaL_checkinteger(L, 1);
+
+	return op_start(L, new_op(L, OP_ACCEPT, fd, NULL, 0));
+}
+
+/* Fill a Unix socket address, raising an error if path doesn't fit */
+static void
+unix_address(lua_State *L, int arg, struct sockaddr_un *addr)
+{
+	size_t len;
+	const char *path = luaL_checklstring(L, arg, &len);
+
+	luaL_argcheck(L, len < sizeof(addr->sun_path), arg, "path too long");
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path, path, len);
+}
+
+static int
+aio_listen(lua_State *L)
+{
+	struct aio *a = to_aio(L);
+	struct sockaddr_un addr;
+
+	unix_address(L, 1, &addr);
+	int backlog = luaL_optinteger(L, 2, DEFAULT_BACKLOG);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return luaL_fileresult(L, 0, addr.sun_path);
+	}
+
+	unlink(addr.sun_path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, backlog) < 0) {
+		int err = errno;
+
+		close(fd);
+		errno = err;
+		return luaL_fileresult(L, 0, addr.sun_path);
+	}
+
+	prepare_fd(a, fd, 1);
+	lua_pushinteger(L, fd);
+
+	return 1;
+}
+
+static int
+aio_connect(lua_State *L)
+{
+	struct aio *a = to_aio(L);
+	struct sockaddr_un addr;
+
+	unix_address(L, 1, &addr);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return luaL_fileresult(L, 0, addr.sun_path);
+	}
+
+	/* Local connects don't wait for the peer, just for its backlog */
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int err = errno;
+
+		close(fd);
+		errno = err;
+		return luaL_fileresult(L, 0, addr.sun_path);
+	}
+
+	prepare_fd(a, fd, 1);
+	lua_pushinteger(L, fd);
+
+	return 1;
+}
+
+static int
+aio_pipe(lua_State *L)
+{
+	struct aio *a = to_aio(L);
+	int fds[2];
+
+	if (pipe(fds) < 0) {
+		return luaL_fileresult(L, 0, NULL);
+	}
+
+	prepare_fd(a, fds[0], 1);
+	prepare_fd(a, fds[1], 1);
+	lua_pushinteger(L, fds[0]);
+	lua_pushinteger(L, fds[1]);
+
+	return 2;
+}
+
+static int
+aio_close(lua_State *L)
+{
+	struct aio *a = to_aio(L);
+	int fd = luaL_checkinteger(L, 1);
+
+	/* The number can be reused by a descriptor in blocking mode */
+	if ((size_t)fd < a->nwatches) {
+		struct watch *w = &a->watches[fd];
+
+		luaL_argcheck(L, w->reader == NULL && w->writer == NULL, 1,
+		    "descriptor in use");
+		w->known = 0;
+	}
+
+	return luaL_fileresult(L, close(fd) == 0, NULL);
+}
+
+static int
+aio_backend_name(lua_State *L)
+{
+	lua_pushstring(L, aio_backend(to_aio(L)));
+
+	return 1;
+}
+
+static const luaL_Reg aio_funcs[] = {
+	{ "read", aio_read },
+	{ "recv", aio_recv },
+	{ "write", aio_write },
+	{ "accept", aio_accept },
+	{ "listen", aio_listen },
+	{ "connect", aio_connect },
+	{ "pipe", aio_pipe },
+	{ "close", aio_close },
+	{ "backend", aio_backend_name },
+	{ NULL, NULL },
+};
+
+struct aio *
+aio_create(struct scheduler *s, lua_State *L)
+{
+	struct aio *a = calloc(1, sizeof(*a));
+
+	if (a == NULL) {
+		return NULL;
+	}
+
+	a->s = s;
+	a->L = L;
+	a->epfd = -1;
+	a->wake_fd = scheduler_wake_fd(s);
+
+#ifdef HAVE_LIBURING
+	/* Older kernels or seccomp profiles may refuse it */
+	if (io_uring_queue_init(URING_ENTRIES, &a->ring, 0) == 0) {
+		a->backend = BACKEND_URING;
+	} else
+#endif /* HAVE_LIBURING */
+	{
+		a->backend = BACKEND_EPOLL;
+		struct epoll_event ev = { 0 };
+
+		ev.events = EPOLLIN;
+		ev.data.fd = a->wake_fd;
+		a->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (a->epfd < 0 ||
+		    epoll_ctl(a->epfd, EPOLL_CTL_ADD, a->wake_fd, &ev) < 0) {
+			if (a->epfd >= 0) {
+				close(a->epfd);
+			}
+			free(a);
+			return NULL;
+		}
+	}
+
+	if (luaL_newmetatable(L, AIO_METATABLE)) {
+		lua_pushcfunction(L, op_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_pop(L, 1);
+
+	/* Install the `aio` global */
+	luaL_newlibtable(L, aio_funcs);
+	lua_pushlightuserdata(L, a);
+	luaL_setfuncs(L, aio_funcs, 1);
+	lua_setglobal(L, "aio");
+
+	scheduler_set_poller(s, aio_poll, a);
+
+	return a;
+}
+
+void
+aio_destroy(struct aio *a)
+{
+	if (a == NULL) {
+		return;
+	}
+
+	scheduler_set_poller(a->s, NULL, NULL);
+
+	/* `aio` functions point to the event loop */
+	lua_pushnil(a->L);
+	lua_setglobal(a->L, "aio");
+
+#ifdef HAVE_LIBURING
+	/* Done with the kernel before freeing any buffer it was given */
+	if (a->backend == BACKEND_URING) {
+		uring_drain(a);
+		io_uring_queue_exit(&a->ring);
+	}
+#endif /* HAVE_LIBURING */
+
+	/*
+	 * Handles still on a stack are freed by their __gc. Orphans are only
+	 * left here by a failed drain and may still be the kernel's: leaked.
+	 */
+	while (a->in_flight != NULL) {
+		struct aio_op *op = a->in_flight;
+
+		unlink_op(a, op);
+		op->aio = NULL;
+	}
+	if (a->epfd >= 0) {
+		close(a->epfd);
+	}
+	free(a->watches);
+	free(a);
+}
+
+const char *
+aio_backend(struct aio *a)
+{
+	return a->backend == BACKEND_URING ? "io_uring" : "epoll";
+}
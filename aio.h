@@ -0,0 +1,94 @@
+#ifndef AIO_H
+#define AIO_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <lua.h>
+
+#include "scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Asynchronous I/O for scheduler tasks.
+ *
+ * Same pattern as the C coroutine of c2lua.c: a C function starts the
+ * operation and yields with lua_yieldk, the scheduler parks the task
+ * ("wait" on the operation) and the event loop notifies it once the
+ * operation can complete, resuming into the continuation that returns
+ * the result. Other tasks keep running meanwhile.
+ *
+ * With io_uring (built with make URING=1 and supported by the kernel)
+ * the operation itself is submitted and its completion wakes the task,
+ * otherwise epoll reports readiness and the continuation does the call.
+ *
+ * The `aio` global:
+ *
+ *   aio.read(fd [, n])     string of up to n bytes ("" at end of file)
+ *   aio.recv(fd [, n])     same on a socket
+ *   aio.write(fd, s)       writes all of s, returns the byte count
+ *   aio.accept(fd)         new connection fd
+ *   aio.listen(path)       listening Unix socket fd
+ *   aio.connect(path)      connected Unix socket fd
+ *   aio.pipe()             read fd, write fd
+ *   aio.close(fd)
+ *   aio.backend()          "io_uring" or "epoll"
+ *
+ * Failures return nil, the message and the errno. Outside of a task the
+ * calls simply block. With epoll, descriptors are switched to
+ * non-blocking mode the first time they're used and should be closed with
+ * aio.close.
+ */
+
+struct aio;
+
+/*
+ * Create the event loop of a scheduler running in L, install the `aio`
+ * global and register as the scheduler event source. Returns NULL on
+ * failure.
+ */
+struct aio *aio_create(struct scheduler *s, lua_State *L);
+
+/*
+ * Unregister and free the event loop, operations in flight are dropped
+ * (io_uring ones cancelled and waited for first).
+ */
+void aio_destroy(struct aio *a);
+
+/* Name of the backend in use. */
+const char *aio_backend(struct aio *a);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* AIO_H */
@@ -0,0 +1,421 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "memstat.h"
+
+/* Every block is aligned (and rounded) to this size. */
+#define BLOCK_ALIGN 16
+
+/* Largest block served from the size-class pools. */
+#define POOL_MAX 512
+
+/* Largest block served from the arena, bigger ones go to malloc. */
+#define ARENA_MAX 4096
+
+/* Number of size classes: 16, 32, 48, ... POOL_MAX */
+#define NUM_CLASSES (POOL_MAX / BLOCK_ALIGN)
+
+/* Size of every slab requested from malloc. */
+#define SLAB_SIZE (64 * 1024)
+
+/* Room reserved at the start of a slab to link it with the others. */
+#define SLAB_HEADER BLOCK_ALIGN
+
+#define ROUND_UP(n) (((n) + (BLOCK_ALIGN - 1)) & ~(size_t)(BLOCK_ALIGN - 1))
+
+/* Free block, the link is stored inside the block itself. */
+struct free_block {
+	struct free_block *next;
+};
+
+struct size_class {
+	struct free_block *free_list; /* recycled blocks */
+	char *cur;		      /* unused tail of the last slab */
+	char *end;
+};
+
+struct allocator {
+	int flags;
+	void *slabs; /* every slab, linked through its header */
+
+	/* ALLOCATOR_POOL */
+	struct size_class classes[NUM_CLASSES];
+
+	/* ALLOCATOR_ARENA */
+	char *arena_cur;
+	char *arena_end;
+	char *arena_last; /* last block, it can grow or shrink in place */
+};
+
+/**
+ * Request a new slab from malloc and return the first usable byte.
+ */
+static char *
+slab_new(struct allocator *a)
+{
+	char *slab = malloc(SLAB_SIZE);
+
+	if (slab == NULL) {
+		return NULL;
+	}
+
+	*(void **)slab = a->slabs;
+	a->slabs = slab;
+
+	return slab + SLAB_HEADER;
+}
+
+static inline int
+is_small(struct allocator *a, size_t size)
+{
+	if (a->flags & ALLOCATOR_ARENA) {
+		return size <= ARENA_MAX;
+	}
+	return size <= POOL_MAX;
+}
+
+static inline size_t
+class_index(size_t size)
+{
+	return (size - 1) / BLOCK_ALIGN;
+}
+
+static void *
+pool_alloc(struct allocator *a, size_t size)
+{
+	size_t idx = class_index(size);
+	size_t csize = (idx + 1) * BLOCK_ALIGN;
+	struct size_class *c = &a->classes[idx];
+
+	/* Reuse a freed block first */
+	if (c->free_list != NULL) {
+		struct free_block *b = c->free_list;
+		c->free_list = b->next;
+		return b;
+	}
+
+	/* Carve a new block from the current slab, start another if needed */
+	if (c->cur == NULL || (size_t)(c->end - c->cur) < csize) {
+		char *p = slab_new(a);
+
+		if (p == NULL) {
+			return NULL;
+		}
+		c->cur = p;
+		c->end = p + (SLAB_SIZE - SLAB_HEADER);
+	}
+
+	void *block = c->cur;
+	c->cur += csize;
+
+	return block;
+}
+
+static inline void
+pool_free(struct allocator *a, void *ptr, size_t size)
+{
+	struct size_class *c = &a->classes[class_index(size)];
+	struct free_block *b = ptr;
+
+	b->next = c->free_list;
+	c->free_list = b;
+}
+
+static void *
+arena_alloc(struct allocator *a, size_t size)
+{
+	size = ROUND_UP(size);
+
+	if (a->arena_cur == NULL ||
+	    (size_t)(a->arena_end - a->arena_cur) < size) {
+		char *p = slab_new(a);
+
+		if (p == NULL) {
+			return NULL;
+		}
+		a->arena_cur = p;
+		a->arena_end = p + (SLAB_SIZE - SLAB_HEADER);
+	}
+
+	a->arena_last = a->arena_cur;
+	a->arena_cur += size;
+
+	return a->arena_last;
+}
+
+static inline void
+arena_free(struct allocator *a, void *ptr)
+{
+	/* Only the last block can be given back, the rest waits for close */
+	if (ptr == a->arena_last) {
+		a->arena_cur = a->arena_last;
+		a->arena_last = NULL;
+	}
+}
+
+static void *
+block_alloc(struct allocator *a, size_t size)
+{
+	if (!is_small(a, size)) {
+		return malloc(size);
+	}
+	if (a->flags & ALLOCATOR_ARENA) {
+		return arena_alloc(a, size);
+	}
+	return pool_alloc(a, size);
+}
+
+static void
+block_free(struct allocator *a, void *ptr, size_t size)
+{
+	if (ptr == NULL) {
+		return;
+	}
+	if (!is_small(a, size)) {
+		free(ptr);
+	} else if (a->flags & ALLOCATOR_ARENA) {
+		arena_free(a, ptr);
+	} else {
+		pool_free(a, ptr, size);
+	}
+}
+
+static void *
+block_realloc(struct allocator *a, void *ptr, size_t osize, size_t nsize)
+{
+	int osmall = is_small(a, osize);
+	int nsmall = is_small(a, nsize);
+
+	/* Both sizes belong to malloc */
+	if (!osmall && !nsmall) {
+		return realloc(ptr, nsize);
+	}
+
+	if (osmall && nsmall) {
+		if (a->flags & ALLOCATOR_ARENA) {
+			/* The last block can be resized in place */
+			if (ptr == a->arena_last &&
+			    ROUND_UP(nsize) <=
+				(size_t)(a->arena_end - a->arena_last)) {
+				a->arena_cur = a->arena_last + ROUND_UP(nsize);
+				return ptr;
+			}
+			/* Shrinking keeps the block, arena never reuses it */
+			if (nsize <= osize) {
+				return ptr;
+			}
+		} else if (class_index(osize) == class_index(nsize)) {
+			/* Same size class, nothing to do */
+			return ptr;
+		}
+	}
+
+	void *block = block_alloc(a, nsize);
+
+	if (block == NULL) {
+		return NULL;
+	}
+
+	memcpy(block, ptr, osize < nsize ? osize : nsize);
+	block_free(a, ptr, osize);
+
+	return block;
+}
+
+struct allocator *
+allocator_create(int flags)
+{
+	struct allocator *a = calloc(1, sizeof(*a));
+
+	if (a != NULL) {
+		a->flags = flags;
+	}
+
+	return a;
+}
+
+void
+allocator_destroy(struct allocator *a)
+{
+	if (a == NULL) {
+		return;
+	}
+
+	/* Drop every slab at once, no need to walk the blocks */
+	void *slab = a->slabs;
+	while (slab != NULL) {
+		void *next = *(void **)slab;
+		free(slab);
+		slab = next;
+	}
+
+	free(a);
+}
+
+void *
+allocator_lua_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	struct allocator *a = ud;
+
+	/* When ptr is NULL, osize encodes the kind of object, not a size */
+	if (ptr == NULL) {
+		osize = 0;
+	}
+
+	if (nsize == 0) {
+		block_free(a, ptr, osize);
+		return NULL;
+	}
+
+	if (ptr == NULL) {
+		return block_alloc(a, nsize);
+	}
+
+	return block_realloc(a, ptr, osize, nsize);
+}
+
+/**
+ * Panic handler, same behaviour as the one installed by luaL_newstate.
+ */
+static int
+panic(lua_State *L)
+{
+	const char *msg = lua_tostring(L, -1);
+
+	if (msg == NULL) {
+		msg = "error object is not a string";
+	}
+	fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n",
+	    msg);
+
+	return 0; /* return to Lua to abort */
+}
+
+/*
+ * Warning functions, same behaviour as the ones installed by luaL_newstate:
+ * warnings start disabled and "@on"/"@off" switch them.
+ */
+static void warn_off(void *ud, const char *message, int tocont);
+static void warn_on(void *ud, const char *message, int tocont);
+static void warn_cont(void *ud, const char *message, int tocont);
+
+static int
+warn_control(lua_State *L, const char *message, int tocont)
+{
+	if (tocont || *(message++) != '@') {
+		return 0; /* not a control message */
+	}
+
+	if (strcmp(message, "off") == 0) {
+		lua_setwarnf(L, warn_off, L);
+	} else if (strcmp(message, "on") == 0) {
+		lua_setwarnf(L, warn_on, L);
+	}
+
+	return 1;
+}
+
+static void
+warn_off(void *ud, const char *message, int tocont)
+{
+	warn_control((lua_State *)ud, message, tocont);
+}
+
+static void
+warn_cont(void *ud, const char *message, int tocont)
+{
+	lua_State *L = ud;
+
+	fputs(message, stderr);
+	if (tocont) {
+		lua_setwarnf(L, warn_cont, L);
+	} else {
+		fputs("\n", stderr);
+		lua_setwarnf(L, warn_on, L);
+	}
+}
+
+static void
+warn_on(void *ud, const char *message, int tocont)
+{
+	if (warn_control((lua_State *)ud, message, tocont)) {
+		return;
+	}
+
+	fputs("Lua warning: ", stderr);
+	warn_cont(ud, message, tocont);
+}
+
+lua_State *
+allocator_newstate(int flags)
+{
+	struct allocator *a = allocator_create(flags);
+
+	if (a == NULL) {
+		return NULL;
+	}
+
+	lua_State *L = lua_newstate(allocator_lua_alloc, a);
+
+	if (L == NULL) {
+		allocator_destroy(a);
+		return NULL;
+	}
+
+	lua_atpanic(L, panic);
+	lua_setwarnf(L, warn_off, L);
+
+	return L;
+}
+
+void
+allocator_close(lua_State *L)
+{
+	/* Unwrap the memory counters to find our allocator */
+	memstat_detach(L);
+
+	void *ud;
+	lua_Alloc f = lua_getallocf(L, &ud);
+
+	lua_close(L);
+
+	/* The allocator outlives lua_close, it receives the last frees */
+	if (f == allocator_lua_alloc) {
+		allocator_destroy(ud);
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+/*
+ * Allocation strategies.
+ *
+ * ALLOCATOR_POOL keeps small blocks in size-class slabs and recycles them
+ * through per-class free lists. ALLOCATOR_ARENA bump-allocates small and
+ * medium blocks without ever reusing them; the whole arena is dropped in
+ * one shot when the state is closed, so it is meant for short-lived
+ * per-request states.
+ */
+#define ALLOCATOR_POOL	0x0
+#define ALLOCATOR_ARENA 0x1
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+struct allocator;
+
+/* Create a new allocator with the given strategy. */
+struct allocator *allocator_create(int flags);
+
+/* Release every block and slab owned by the allocator. */
+void allocator_destroy(struct allocator *a);
+
+/* lua_Alloc compatible entry point, `ud` must be a struct allocator. */
+void *allocator_lua_alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+/*
+ * Create a new Lua state backed by its own allocator, replacement for
+ * luaL_newstate. Returns NULL if the state can't be created.
+ */
+lua_State *allocator_newstate(int flags);
+
+/* Close a state created with allocator_newstate and drop its allocator. */
+void allocator_close(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* ALLOCATOR_H */
@@ -0,0 +1,187 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Async I/O benchmarks, everything on one thread driven by the scheduler.
+ * One operation is one round trip:
+ *
+ *   pipes   pairs of tasks bounce a message over two pipes
+ *   socket  clients echo through a server task on a Unix socket
+ *
+ * The backend in use is printed to stderr first. Same options and JSON
+ * output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "aio.h"
+#include "allocator.h"
+#include "bench/harness.h"
+#include "scheduler.h"
+
+/* Pairs of pipe tasks, socket clients */
+#define TASKS 128
+
+static const char *pipe_script =
+    "local pairs, rounds = ...\n"
+    "for p = 1, pairs do\n"
+    "    local r1, w1 = aio.pipe()\n"
+    "    local r2, w2 = aio.pipe()\n"
+    "    sched.spawn(function()\n"
+    "        for i = 1, rounds do\n"
+    "            aio.write(w1, 'ping')\n"
+    "            assert(aio.read(r2, 4) == 'pong')\n"
+    "        end\n"
+    "        aio.close(w1)\n"
+    "        aio.close(r2)\n"
+    "    end)\n"
+    "    sched.spawn(function()\n"
+    "        for i = 1, rounds do\n"
+    "            assert(aio.read(r1, 4) == 'ping')\n"
+    "            aio.write(w2, 'pong')\n"
+    "        end\n"
+    "        aio.close(r1)\n"
+    "        aio.close(w2)\n"
+    "    end)\n"
+    "end\n";
+
+static const char *socket_script =
+    "local clients, rounds, path = ...\n"
+    "local server = assert(aio.listen(path))\n"
+    "sched.spawn(function()\n"
+    "    for c = 1, clients do\n"
+    "        local fd = assert(aio.accept(server))\n"
+    "        sched.spawn(function()\n"
+    "            while true do\n"
+    "                local s = aio.recv(fd, 64)\n"
+    "                if s == nil or s == '' then break end\n"
+    "                aio.write(fd, s)\n"
+    "            end\n"
+    "            aio.close(fd)\n"
+    "        end)\n"
+    "    end\n"
+    "    aio.close(server)\n"
+    "end)\n"
+    "for c = 1, clients do\n"
+    "    sched.spawn(function()\n"
+    "        local fd = assert(aio.connect(path))\n"
+    "        for i = 1, rounds do\n"
+    "            aio.write(fd, 'echo')\n"
+    "            assert(aio.recv(fd, 4) == 'echo')\n"
+    "        end\n"
+    "        aio.close(fd)\n"
+    "    end)\n"
+    "end\n";
+
+struct context {
+	lua_State *L;
+	struct scheduler *s;
+	char path[64];
+};
+
+/**
+ * Spawn the script as the first task for `iterations` round trips and run
+ * everything.
+ */
+static void
+run(struct context *c, const char *script, long iterations)
+{
+	long rounds = iterations / TASKS;
+
+	if (luaL_loadstring(c->L, script) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(c->L, -1));
+		exit(1);
+	}
+	lua_pushinteger(c->L, TASKS);
+	lua_pushinteger(c->L, rounds > 0 ? rounds : 1);
+	lua_pushstring(c->L, c->path);
+	scheduler_spawn(c->s, c->L, 3);
+
+	size_t stuck = scheduler_run(c->s);
+
+	if (stuck > 0) {
+		fprintf(stderr, "%zu tasks never completed\n", stuck);
+		exit(1);
+	}
+}
+
+static void
+bench_pipes(void *ctx, long iterations)
+{
+	run(ctx, pipe_script, iterations);
+}
+
+static void
+bench_socket(void *ctx, long iterations)
+{
+	run(ctx, socket_script, iterations);
+}
+
+static const struct bench_def benches[] = {
+	{ "pipes", bench_pipes, 1 },
+	{ "socket", bench_socket, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+	c.s = scheduler_create(c.L);
+
+	struct aio *a = aio_create(c.s, c.L);
+
+	if (a == NULL) {
+		fprintf(stderr, "can't create the event loop\n");
+		return 1;
+	}
+
+	fprintf(stderr, "aio backend: %s\n", aio_backend(a));
+	snprintf(c.path, sizeof(c.path), "/tmp/bench_aio.%ld",
+	    (long)getpid());
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	unlink(c.path);
+	aio_destroy(a);
+	scheduler_destroy(c.s);
+	allocator_close(c.L);
+
+	return status;
+}
@@ -0,0 +1,178 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Allocator benchmarks, one operation is one iteration of the same
+ * allocation-heavy script (small tables, strings and closures), state
+ * setup and teardown included:
+ *
+ *   default  allocator of luaL_newstate
+ *   pool     allocator.c size-class pools
+ *   arena    allocator.c arena
+ *
+ * Every run happens in its own child process so the max RSS, printed to
+ * stderr after the timings, isn't polluted by the other allocators. Same
+ * options and JSON output as bench_boundary.
+ */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+
+#define MODE_DEFAULT (-1)
+
+static const char *churn_script =
+    "local n = ...\n"
+    "local keep = {}\n"
+    "for i = 1, n do\n"
+    "    local s = 'key' .. i\n"
+    "    keep[i % 1024 + 1] = { s, i, function() return s end }\n"
+    "end\n";
+
+/* Largest max RSS of the children, in KiB */
+struct context {
+	long rss_default;
+	long rss_pool;
+	long rss_arena;
+};
+
+static int
+churn(int mode, long iterations)
+{
+	lua_State *L;
+
+	if (mode == MODE_DEFAULT) {
+		L = luaL_newstate();
+	} else {
+		L = allocator_newstate(mode);
+	}
+	luaL_openlibs(L);
+
+	if (luaL_loadstring(L, churn_script) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return 1;
+	}
+	lua_pushinteger(L, iterations);
+	if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return 1;
+	}
+
+	/* Include the final teardown, the arena is built for it */
+	if (mode == MODE_DEFAULT) {
+		lua_close(L);
+	} else {
+		allocator_close(L);
+	}
+
+	return 0;
+}
+
+/**
+ * Churn in a child process and keep its max RSS in `rss`.
+ */
+static void
+run(int mode, long iterations, long *rss)
+{
+	struct rusage ru;
+	int status;
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		_exit(churn(mode, iterations));
+	}
+	if (pid < 0 || wait4(pid, &status, 0, &ru) != pid ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "churn failed\n");
+		exit(1);
+	}
+
+	if (ru.ru_maxrss > *rss) {
+		*rss = ru.ru_maxrss;
+	}
+}
+
+static void
+bench_default(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run(MODE_DEFAULT, iterations, &c->rss_default);
+}
+
+static void
+bench_pool(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run(ALLOCATOR_POOL, iterations, &c->rss_pool);
+}
+
+static void
+bench_arena(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run(ALLOCATOR_ARENA, iterations, &c->rss_arena);
+}
+
+static const struct bench_def benches[] = {
+	{ "default", bench_default, 1 },
+	{ "pool", bench_pool, 1 },
+	{ "arena", bench_arena, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c = { 0, 0, 0 };
+
+	/* Children inherit what's still buffered */
+	fflush(stdout);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	fprintf(stderr, "max RSS: default %ld KiB, pool %ld KiB, "
+			"arena %ld KiB\n",
+	    c.rss_default, c.rss_pool, c.rss_arena);
+
+	return status;
+}
@@ -0,0 +1,328 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Table binding benchmarks.
+ *
+ * Converts a 20-field record to and from a Lua table with one
+ * lua_setfield/lua_getfield per field and with a binding (see binding.h):
+ *
+ *   setfield_push  new table filled with lua_setfield
+ *   binding_push   new table filled through the interned names
+ *   getfield_read  record read back with lua_getfield
+ *   binding_get    record read back through the interned names
+ *   setfield_one   one field stored with lua_setfield
+ *   binding_one    one field stored with binding_setfield
+ *
+ * Same options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "binding.h"
+#include "examples.h"
+
+struct record {
+	int id;
+	int parent;
+	int owner;
+	int group;
+	int flags;
+	lua_Integer created;
+	lua_Integer updated;
+	lua_Integer size;
+	double x;
+	double y;
+	double z;
+	double weight;
+	double score;
+	int active;
+	int hidden;
+	int locked;
+	char name[32];
+	char kind[16];
+	char path[64];
+	const char *note;
+};
+
+#define FIELD(member, kind) BINDING_FIELD(struct record, member, kind)
+
+static const struct binding_field record_fields[] = {
+	FIELD(id, BINDING_INT),
+	FIELD(parent, BINDING_INT),
+	FIELD(owner, BINDING_INT),
+	FIELD(group, BINDING_INT),
+	FIELD(flags, BINDING_INT),
+	FIELD(created, BINDING_INTEGER),
+	FIELD(updated, BINDING_INTEGER),
+	FIELD(size, BINDING_INTEGER),
+	FIELD(x, BINDING_NUMBER),
+	FIELD(y, BINDING_NUMBER),
+	FIELD(z, BINDING_NUMBER),
+	FIELD(weight, BINDING_NUMBER),
+	FIELD(score, BINDING_NUMBER),
+	FIELD(active, BINDING_BOOLEAN),
+	FIELD(hidden, BINDING_BOOLEAN),
+	FIELD(locked, BINDING_BOOLEAN),
+	FIELD(name, BINDING_CHARS),
+	FIELD(kind, BINDING_CHARS),
+	FIELD(path, BINDING_CHARS),
+	FIELD(note, BINDING_STRING),
+};
+
+#define NFIELDS (sizeof(record_fields) / sizeof(record_fields[0]))
+
+struct context {
+	lua_State *L;
+	struct binding *b;
+	struct record rec;
+};
+
+/**
+ * What a hand written binding does, one lua_setfield per member.
+ */
+static void
+push_by_name(lua_State *L, const struct record *r)
+{
+	lua_createtable(L, 0, NFIELDS);
+	lua_pushinteger(L, r->id);
+	lua_setfield(L, -2, "id");
+	lua_pushinteger(L, r->parent);
+	lua_setfield(L, -2, "parent");
+	lua_pushinteger(L, r->owner);
+	lua_setfield(L, -2, "owner");
+	lua_pushinteger(L, r->group);
+	lua_setfield(L, -2, "group");
+	lua_pushinteger(L, r->flags);
+	lua_setfield(L, -2, "flags");
+	lua_pushinteger(L, r->created);
+	lua_setfield(L, -2, "created");
+	lua_pushinteger(L, r->updated);
+	lua_setfield(L, -2, "updated");
+	lua_pushinteger(L, r->size);
+	lua_setfield(L, -2, "size");
+	lua_pushnumber(L, r->x);
+	lua_setfield(L, -2, "x");
+	lua_pushnumber(L, r->y);
+	lua_setfield(L, -2, "y");
+	lua_pushnumber(L, r->z);
+	lua_setfield(L, -2, "z");
+	lua_pushnumber(L, r->weight);
+	lua_setfield(L, -2, "weight");
+	lua_pushnumber(L, r->score);
+	lua_setfield(L, -2, "score");
+	lua_pushboolean(L, r->active);
+	lua_setfield(L, -2, "active");
+	lua_pushboolean(L, r->hidden);
+	lua_setfield(L, -2, "hidden");
+	lua_pushboolean(L, r->locked);
+	lua_setfield(L, -2, "locked");
+	lua_pushstring(L, r->name);
+	lua_setfield(L, -2, "name");
+	lua_pushstring(L, r->kind);
+	lua_setfield(L, -2, "kind");
+	lua_pushstring(L, r->path);
+	lua_setfield(L, -2, "path");
+	lua_pushstring(L, r->note);
+	lua_setfield(L, -2, "note");
+}
+
+static void
+copy_string(lua_State *L, char *dst, size_t size)
+{
+	size_t len;
+	const char *s = lua_tolstring(L, -1, &len);
+
+	len = len < size ? len : size - 1;
+	memcpy(dst, s, len);
+	dst[len] = '\0';
+}
+
+/**
+ * And reading it back, one lua_getfield per member.
+ */
+static void
+get_by_name(lua_State *L, int idx, struct record *r)
+{
+	lua_getfield(L, idx, "id");
+	r->id = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "parent");
+	r->parent = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "owner");
+	r->owner = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "group");
+	r->group = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "flags");
+	r->flags = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "created");
+	r->created = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "updated");
+	r->updated = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "size");
+	r->size = lua_tointeger(L, -1);
+	lua_getfield(L, idx, "x");
+	r->x = lua_tonumber(L, -1);
+	lua_getfield(L, idx, "y");
+	r->y = lua_tonumber(L, -1);
+	lua_getfield(L, idx, "z");
+	r->z = lua_tonumber(L, -1);
+	lua_getfield(L, idx, "weight");
+	r->weight = lua_tonumber(L, -1);
+	lua_getfield(L, idx, "score");
+	r->score = lua_tonumber(L, -1);
+	lua_getfield(L, idx, "active");
+	r->active = lua_toboolean(L, -1);
+	lua_getfield(L, idx, "hidden");
+	r->hidden = lua_toboolean(L, -1);
+	lua_getfield(L, idx, "locked");
+	r->locked = lua_toboolean(L, -1);
+	lua_getfield(L, idx, "name");
+	copy_string(L, r->name, sizeof(r->name));
+	lua_getfield(L, idx, "kind");
+	copy_string(L, r->kind, sizeof(r->kind));
+	lua_getfield(L, idx, "path");
+	copy_string(L, r->path, sizeof(r->path));
+	lua_getfield(L, idx, "note");
+	r->note = lua_tostring(L, -1);
+	lua_pop(L, (int)NFIELDS);
+}
+
+static void
+bench_setfield_push(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	for (long i = 0; i < iterations; i++) {
+		push_by_name(c->L, &c->rec);
+		lua_pop(c->L, 1);
+	}
+}
+
+static void
+bench_binding_push(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	for (long i = 0; i < iterations; i++) {
+		binding_push(c->L, c->b, &c->rec);
+		lua_pop(c->L, 1);
+	}
+}
+
+static void
+bench_getfield_read(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	struct record r;
+
+	binding_push(c->L, c->b, &c->rec);
+	for (long i = 0; i < iterations; i++) {
+		get_by_name(c->L, -1, &r);
+	}
+	lua_pop(c->L, 1);
+}
+
+static void
+bench_binding_get(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	struct record r;
+
+	binding_push(c->L, c->b, &c->rec);
+	for (long i = 0; i < iterations; i++) {
+		binding_get(c->L, c->b, -1, &r);
+	}
+	lua_pop(c->L, 1);
+}
+
+static void
+bench_setfield_one(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	binding_push(c->L, c->b, &c->rec);
+	for (long i = 0; i < iterations; i++) {
+		lua_pushinteger(c->L, i);
+		lua_setfield(c->L, -2, "score");
+	}
+	lua_pop(c->L, 1);
+}
+
+static void
+bench_binding_one(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	binding_push(c->L, c->b, &c->rec);
+	for (long i = 0; i < iterations; i++) {
+		lua_pushinteger(c->L, i);
+		binding_setfield(c->L, c->b, -2, 12); /* score */
+	}
+	lua_pop(c->L, 1);
+}
+
+static const struct bench_def benches[] = {
+	{ "setfield_push", bench_setfield_push, 1 },
+	{ "binding_push", bench_binding_push, 1 },
+	{ "getfield_read", bench_getfield_read, 1 },
+	{ "binding_get", bench_binding_get, 1 },
+	{ "setfield_one", bench_setfield_one, 1 },
+	{ "binding_one", bench_binding_one, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c = {
+		.rec = { 1, 2, 3, 4, 5, 1700000000, 1700000100, 4096, 1.5,
+		    2.5, 3.5, 0.25, 99.5, 1, 0, 1, "record", "file",
+		    "/var/lib/records/1", "a note" },
+	};
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+	c.b = binding_create(c.L, record_fields, NFIELDS);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	binding_destroy(c.L, c.b);
+	allocator_close(c.L);
+
+	return status;
+}
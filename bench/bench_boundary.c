@@ -0,0 +1,223 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * C/Lua boundary benchmarks.
+ *
+ * Measures the paths the examples are built on:
+ *
+ *   c2lua_resume     C yields (coroutine_entrypoint/kfunction), Lua resumes
+ *   lua2c_resume     Lua yields, C resumes
+ *   pcallk_dispatch  lua_pcallk yielding and finishing in its continuation
+ *   repl_eval        one REPL line through the chunk cache
+ *   state_create     REPL-like state built and closed
+ *
+ * Results are written as JSON (stdout or -o file), a summary goes to
+ * stderr. Benchmark names given as arguments select which ones run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "coro_pool.h"
+#include "examples.h"
+
+/* Resumes the c2lua coroutine body until `n` resumes are done. */
+static const char *c2lua_driver = "local entry, n = ...\n"
+				  "local done = 0\n"
+				  "while done < n do\n"
+				  "    local co = coroutine.create(entry)\n"
+				  "    repeat\n"
+				  "        coroutine.resume(co)\n"
+				  "        done = done + 1\n"
+				  "    until coroutine.status(co) == 'dead'\n"
+				  "end\n";
+
+/* Echoes what it's resumed with, forever. */
+static const char *lua2c_body = "return coroutine.create(function(x)\n"
+				"    while true do\n"
+				"        x = coroutine.yield(x)\n"
+				"    end\n"
+				"end)\n";
+
+/* Yields once from Lua, run by lua_pcallk as in yield.c. */
+static const char *pcallk_body = "return function()\n"
+				 "    coroutine.yield()\n"
+				 "end\n";
+
+static const char *repl_line = "return val.key .. native\n";
+
+struct context {
+	lua_State *L;
+	int c2lua_ref;	/* compiled c2lua_driver */
+	lua_State *co;	/* lua2c_body coroutine */
+	int pcallk_ref;	/* pcallk_entry closure */
+	struct coro_pool *coros;
+};
+
+static void
+check(lua_State *L, int status)
+{
+	if (status != LUA_OK && status != LUA_YIELD) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+}
+
+static void
+bench_c2lua(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	lua_rawgeti(c->L, LUA_REGISTRYINDEX, c->c2lua_ref);
+	lua_pushcfunction(c->L, coroutine_entrypoint);
+	lua_pushinteger(c->L, iterations);
+	check(c->L, lua_pcall(c->L, 2, 0, 0));
+}
+
+static void
+bench_lua2c(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	int nres;
+
+	for (long i = 0; i < iterations; i++) {
+		lua_pushinteger(c->co, i);
+		check(c->co, lua_resume(c->co, c->L, 1, &nres));
+		lua_pop(c->co, nres);
+	}
+}
+
+static int
+pcallk_done(__UNUSED lua_State *L, __UNUSED int status,
+    __UNUSED lua_KContext k)
+{
+	return 0;
+}
+
+/**
+ * Same shape as yield.c's call_lua_with_continuation, without the output.
+ */
+static int
+pcallk_entry(lua_State *L)
+{
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_pcallk(L, 0, 0, 0, 0, pcallk_done);
+
+	return pcallk_done(L, LUA_OK, 0);
+}
+
+static void
+bench_pcallk(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	int nres;
+
+	for (long i = 0; i < iterations; i++) {
+		int ref;
+		lua_State *co = coro_pool_acquire(c->coros, &ref);
+
+		/* Yields from the Lua side, then finishes in pcallk_done */
+		lua_rawgeti(co, LUA_REGISTRYINDEX, c->pcallk_ref);
+		check(co, lua_resume(co, c->L, 0, &nres));
+		check(co, lua_resume(co, c->L, 0, &nres));
+
+		coro_pool_release(c->coros, co, ref);
+	}
+}
+
+static void
+bench_repl(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	size_t len = strlen(repl_line);
+
+	for (long i = 0; i < iterations; i++) {
+		check(c->L, repl_eval(c->L, repl_line, len));
+		lua_pop(c->L, 1);
+	}
+}
+
+static void
+bench_state(__UNUSED void *ctx, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+		luaL_openlibs(L);
+		setup_interpreter_globals(L);
+		allocator_close(L);
+	}
+}
+
+static const struct bench_def benches[] = {
+	{ "c2lua_resume", bench_c2lua, 1 },
+	{ "lua2c_resume", bench_lua2c, 1 },
+	{ "pcallk_dispatch", bench_pcallk, 1 },
+	{ "repl_eval", bench_repl, 1 },
+	{ "state_create", bench_state, 100 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+	setup_interpreter_globals(c.L);
+
+	check(c.L, luaL_loadstring(c.L, c2lua_driver));
+	c.c2lua_ref = luaL_ref(c.L, LUA_REGISTRYINDEX);
+
+	check(c.L, luaL_dostring(c.L, lua2c_body));
+	c.co = lua_tothread(c.L, -1); /* stays on the stack */
+
+	check(c.L, luaL_dostring(c.L, pcallk_body));
+	lua_pushcclosure(c.L, pcallk_entry, 1);
+	c.pcallk_ref = luaL_ref(c.L, LUA_REGISTRYINDEX);
+
+	c.coros = coro_pool_create(c.L, 16, 0);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	coro_pool_destroy(c.coros);
+	allocator_close(c.L);
+
+	return status;
+}
@@ -0,0 +1,155 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Coroutine pool benchmarks, one operation is one short coroutine (one
+ * yield) run to completion:
+ *
+ *   fresh   on a new thread left to the garbage collector
+ *   pooled  on a thread recycled by the coroutine pool
+ *
+ * Every run ends with a full collection, so the fresh threads are paid
+ * for. The pool counters are printed to stderr after the timings. Same
+ * options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "coro_pool.h"
+
+#define IDLE_THREADS 64
+
+static const char *script = "return function(n)\n"
+			    "    local x = coroutine.yield(n + 1)\n"
+			    "    return x * 2\n"
+			    "end\n";
+
+/**
+ * Run the function at the top of L to completion in `co`.
+ */
+static void
+run_coroutine(lua_State *L, lua_State *co, lua_Integer n)
+{
+	int nres;
+
+	lua_pushvalue(L, -1);
+	lua_xmove(L, co, 1);
+	lua_pushinteger(co, n);
+
+	if (lua_resume(co, L, 1, &nres) != LUA_YIELD ||
+	    lua_resume(co, L, nres, &nres) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(co, -1));
+		exit(1);
+	}
+	lua_pop(co, nres);
+}
+
+struct context {
+	lua_State *L; /* the coroutine function on top */
+	struct coro_pool *pool;
+};
+
+static void
+bench_fresh(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	lua_State *L = c->L;
+
+	for (long i = 0; i < iterations; i++) {
+		lua_State *co = lua_newthread(L);
+
+		lua_insert(L, -2);
+		run_coroutine(L, co, i);
+		lua_remove(L, -2);
+	}
+	lua_gc(L, LUA_GCCOLLECT);
+}
+
+static void
+bench_pooled(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	for (long i = 0; i < iterations; i++) {
+		int ref;
+		lua_State *co = coro_pool_acquire(c->pool, &ref);
+
+		run_coroutine(c->L, co, i);
+		coro_pool_release(c->pool, co, ref);
+	}
+	lua_gc(c->L, LUA_GCCOLLECT);
+}
+
+static const struct bench_def benches[] = {
+	{ "fresh", bench_fresh, 1 },
+	{ "pooled", bench_pooled, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+	struct coro_pool_stats stats;
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+
+	if (luaL_dostring(c.L, script) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(c.L, -1));
+		return 1;
+	}
+
+	c.pool = coro_pool_create(c.L, IDLE_THREADS, 0);
+	if (c.pool == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	coro_pool_stats(c.pool, &stats);
+	coro_pool_destroy(c.pool);
+	allocator_close(c.L);
+
+	fprintf(stderr, "created %llu reused %llu resets %llu discarded %llu\n",
+	    (unsigned long long)stats.created, (unsigned long long)stats.reused,
+	    (unsigned long long)stats.resets,
+	    (unsigned long long)stats.discarded);
+
+	return status;
+}
@@ -0,0 +1,151 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Coroutine tracing benchmarks, one operation is one resume from C of a
+ * coroutine yielding right away:
+ *
+ *   resume          lua_resume
+ *   cotrace_off     cotrace_resume, tracing disabled
+ *   cotrace_on      cotrace_resume, recording
+ *   cotrace_many    cotrace_resume, recording, 512 coroutines in turn
+ *
+ * Same options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "cotrace.h"
+#include "examples.h"
+
+#define NCOROS 512
+
+struct context {
+	lua_State *L;
+	lua_State *coros[NCOROS];
+};
+
+static int
+yield_k(lua_State *L, __UNUSED int status, __UNUSED lua_KContext ctx)
+{
+	return lua_yieldk(L, 0, 0, yield_k);
+}
+
+static int
+yield_forever(lua_State *L)
+{
+	return yield_k(L, LUA_OK, 0);
+}
+
+static void
+bench_resume(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	int nres;
+
+	for (long i = 0; i < iterations; i++) {
+		lua_resume(c->coros[0], c->L, 0, &nres);
+	}
+}
+
+static void
+bench_cotrace_off(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	int nres;
+
+	cotrace_enable(0);
+	for (long i = 0; i < iterations; i++) {
+		cotrace_resume(c->coros[0], c->L, 0, &nres);
+	}
+}
+
+static void
+bench_cotrace_on(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	int nres;
+
+	cotrace_enable(1);
+	for (long i = 0; i < iterations; i++) {
+		cotrace_resume(c->coros[0], c->L, 0, &nres);
+	}
+	cotrace_enable(0);
+}
+
+static void
+bench_cotrace_many(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+	int nres;
+
+	cotrace_enable(1);
+	for (long i = 0; i < iterations; i++) {
+		cotrace_resume(c->coros[i % NCOROS], c->L, 0, &nres);
+	}
+	cotrace_enable(0);
+}
+
+static const struct bench_def benches[] = {
+	{ "resume", bench_resume, 1 },
+	{ "cotrace_off", bench_cotrace_off, 1 },
+	{ "cotrace_on", bench_cotrace_on, 1 },
+	{ "cotrace_many", bench_cotrace_many, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+
+	/* Anchored in the main stack */
+	luaL_checkstack(c.L, NCOROS, "coroutines");
+	for (int i = 0; i < NCOROS; i++) {
+		c.coros[i] = lua_newthread(c.L);
+		lua_pushcfunction(c.coros[i], yield_forever);
+	}
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	allocator_close(c.L);
+
+	return status;
+}
@@ -0,0 +1,166 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Fork server benchmarks, one operation is a child forked, running a tiny
+ * job and reaped:
+ *
+ *   fork_warm     child of the warm master state of the fork server
+ *   cold          child building a bare state
+ *   cold_preload  child building a state and running the same preload
+ *                 script as the master
+ *
+ * Same options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "forkserver.h"
+
+#define MODE_WARM	  0
+#define MODE_COLD	  1
+#define MODE_COLD_PRELOAD 2
+
+/* Expensive setup: a large configuration table. */
+static const char *preload_script =
+    "config = {}\n"
+    "for i = 1, 50000 do\n"
+    "    config['key' .. i] = { id = i, name = 'item' .. i }\n"
+    "end\n";
+
+static const char *job = "return config and config.key1.id or 1";
+
+struct context {
+	lua_State *warm;
+	const char *preload;
+};
+
+/**
+ * Child side: get a state, run the job and exit.
+ */
+static void
+child(const struct context *c, int mode)
+{
+	lua_State *L = c->warm;
+
+	if (mode != MODE_WARM) {
+		L = luaL_newstate();
+		luaL_openlibs(L);
+		setup_interpreter_globals(L);
+		if (mode == MODE_COLD_PRELOAD &&
+		    luaL_dofile(L, c->preload) != LUA_OK) {
+			_exit(1);
+		}
+	}
+
+	_exit(luaL_dostring(L, job) == LUA_OK ? 0 : 1);
+}
+
+static void
+run(const struct context *c, int mode, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		int status;
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			child(c, mode);
+		}
+		if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+		    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "job failed\n");
+			exit(1);
+		}
+	}
+}
+
+static void
+bench_fork_warm(void *ctx, long iterations)
+{
+	run(ctx, MODE_WARM, iterations);
+}
+
+static void
+bench_cold(void *ctx, long iterations)
+{
+	run(ctx, MODE_COLD, iterations);
+}
+
+static void
+bench_cold_preload(void *ctx, long iterations)
+{
+	run(ctx, MODE_COLD_PRELOAD, iterations);
+}
+
+/* A process per operation, and the preload takes tens of milliseconds */
+static const struct bench_def benches[] = {
+	{ "fork_warm", bench_fork_warm, 1000 },
+	{ "cold", bench_cold, 1000 },
+	{ "cold_preload", bench_cold_preload, 100000 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	char preload[] = "/tmp/bench_fork_XXXXXX";
+	int fd = mkstemp(preload);
+	struct context c = { .preload = preload };
+
+	if (fd < 0 || write(fd, preload_script, strlen(preload_script)) < 0) {
+		perror(preload);
+		return 1;
+	}
+	close(fd);
+
+	c.warm = forkserver_prepare(preload);
+	if (c.warm == NULL) {
+		unlink(preload);
+		return 1;
+	}
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	allocator_close(c.warm);
+	unlink(preload);
+
+	return status;
+}
@@ -0,0 +1,338 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Generator benchmarks, one operation is one item consumed from Lua.
+ *
+ *   single_integer       C coroutine yielding one integer per resume
+ *   batch_integer        generator, batches of 64 integers
+ *   batch_integer_1024   generator, batches of 1024 integers
+ *   single_string        one lua_pushfstring string per resume, like
+ *                        kfunction in c2lua.c
+ *   batch_string         generator, 64 lua_pushfstring strings per batch
+ *   batch_string_buffer  generator, strings formatted in a reused buffer
+ *
+ * Same options and JSON output as bench_boundary, ops_per_sec is items
+ * per second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "generator.h"
+
+static const char *setup_script =
+    "local resume = coroutine.resume\n"
+    "local function drain_single(co)\n"
+    "    while true do\n"
+    "        local _, v = resume(co)\n"
+    "        if v == nil then return end\n"
+    "    end\n"
+    "end\n"
+    "local function drain_each(it)\n"
+    "    for _ in it do end\n"
+    "end\n"
+    "benches = {\n"
+    "    single_integer = function(n)\n"
+    "        drain_single(single_integers(n))\n"
+    "    end,\n"
+    "    batch_integer = function(n)\n"
+    "        drain_each(batch_integers(n, 64))\n"
+    "    end,\n"
+    "    batch_integer_1024 = function(n)\n"
+    "        drain_each(batch_integers(n, 1024))\n"
+    "    end,\n"
+    "    single_string = function(n)\n"
+    "        drain_single(single_strings(n))\n"
+    "    end,\n"
+    "    batch_string = function(n)\n"
+    "        drain_each(batch_strings(n, 64))\n"
+    "    end,\n"
+    "    batch_string_buffer = function(n)\n"
+    "        drain_each(batch_strings_buffer(n, 64))\n"
+    "    end,\n"
+    "}\n";
+
+/*
+ * One value per resume, the count of items is upvalue 1
+ */
+
+static int
+single_integers_k(lua_State *L, __UNUSED int status, lua_KContext ctx)
+{
+	if (ctx >= lua_tointeger(L, lua_upvalueindex(1))) {
+		return 0;
+	}
+
+	lua_pushinteger(L, ctx + 1);
+
+	return lua_yieldk(L, 1, ctx + 1, single_integers_k);
+}
+
+static int
+single_integers_body(lua_State *L)
+{
+	return single_integers_k(L, LUA_OK, 0);
+}
+
+static int
+single_strings_k(lua_State *L, __UNUSED int status, lua_KContext ctx)
+{
+	if (ctx >= lua_tointeger(L, lua_upvalueindex(1))) {
+		return 0;
+	}
+
+	lua_pushfstring(L, "item %d", (int)ctx + 1);
+
+	return lua_yieldk(L, 1, ctx + 1, single_strings_k);
+}
+
+static int
+single_strings_body(lua_State *L)
+{
+	return single_strings_k(L, LUA_OK, 0);
+}
+
+static void
+push_single(lua_State *L, lua_CFunction body)
+{
+	lua_Integer n = luaL_checkinteger(L, 1);
+	lua_State *co = lua_newthread(L);
+
+	lua_pushinteger(co, n);
+	lua_pushcclosure(co, body, 1);
+}
+
+static int
+single_integers(lua_State *L)
+{
+	push_single(L, single_integers_body);
+
+	return 1;
+}
+
+static int
+single_strings(lua_State *L)
+{
+	push_single(L, single_strings_body);
+
+	return 1;
+}
+
+/*
+ * Batched
+ */
+
+struct counter {
+	lua_Integer next;
+	lua_Integer last;
+	char buf[32]; /* reused for every string */
+};
+
+static int
+produce_integers(lua_State *L, void *state, int batch, int max)
+{
+	struct counter *c = state;
+	int n = 0;
+
+	while (n < max && c->next <= c->last) {
+		lua_pushinteger(L, c->next++);
+		lua_rawseti(L, batch, ++n);
+	}
+
+	return n;
+}
+
+static int
+produce_strings(lua_State *L, void *state, int batch, int max)
+{
+	struct counter *c = state;
+	int n = 0;
+
+	while (n < max && c->next <= c->last) {
+		lua_pushfstring(L, "item %d", (int)c->next++);
+		lua_rawseti(L, batch, ++n);
+	}
+
+	return n;
+}
+
+/* "item " then the digits, written backwards from the end of buf */
+static int
+produce_strings_buffer(lua_State *L, void *state, int batch, int max)
+{
+	struct counter *c = state;
+	char *end = c->buf + sizeof(c->buf);
+	int n = 0;
+
+	while (n < max && c->next <= c->last) {
+		lua_Unsigned v = c->next++;
+		char *p = end;
+
+		do {
+			*--p = '0' + v % 10;
+			v /= 10;
+		} while (v != 0);
+		p -= 5;
+		memcpy(p, "item ", 5);
+
+		lua_pushlstring(L, p, end - p);
+		lua_rawseti(L, batch, ++n);
+	}
+
+	return n;
+}
+
+static void
+push_batched(lua_State *L, generator_producer produce)
+{
+	lua_Integer n = luaL_checkinteger(L, 1);
+	int batch = (int)luaL_checkinteger(L, 2);
+	struct counter *c = generator_push(L, produce, sizeof(*c), batch);
+
+	c->next = 1;
+	c->last = n;
+}
+
+static int
+batch_integers(lua_State *L)
+{
+	push_batched(L, produce_integers);
+
+	return 1;
+}
+
+static int
+batch_strings(lua_State *L)
+{
+	push_batched(L, produce_strings);
+
+	return 1;
+}
+
+static int
+batch_strings_buffer(lua_State *L)
+{
+	push_batched(L, produce_strings_buffer);
+
+	return 1;
+}
+
+/**
+ * Drain `iterations` items with the function `name` of the `benches`
+ * table.
+ */
+static void
+consume(lua_State *L, const char *name, long iterations)
+{
+	lua_getglobal(L, "benches");
+	lua_getfield(L, -1, name);
+	lua_pushinteger(L, iterations);
+	lua_call(L, 1, 0);
+	lua_pop(L, 1);
+}
+
+static void
+bench_single_integer(void *ctx, long iterations)
+{
+	consume(ctx, "single_integer", iterations);
+}
+
+static void
+bench_batch_integer(void *ctx, long iterations)
+{
+	consume(ctx, "batch_integer", iterations);
+}
+
+static void
+bench_batch_integer_1024(void *ctx, long iterations)
+{
+	consume(ctx, "batch_integer_1024", iterations);
+}
+
+static void
+bench_single_string(void *ctx, long iterations)
+{
+	consume(ctx, "single_string", iterations);
+}
+
+static void
+bench_batch_string(void *ctx, long iterations)
+{
+	consume(ctx, "batch_string", iterations);
+}
+
+static void
+bench_batch_string_buffer(void *ctx, long iterations)
+{
+	consume(ctx, "batch_string_buffer", iterations);
+}
+
+static const struct bench_def benches[] = {
+	{ "single_integer", bench_single_integer, 1 },
+	{ "batch_integer", bench_batch_integer, 1 },
+	{ "batch_integer_1024", bench_batch_integer_1024, 1 },
+	{ "single_string", bench_single_string, 1 },
+	{ "batch_string", bench_batch_string, 1 },
+	{ "batch_string_buffer", bench_batch_string_buffer, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	luaL_openlibs(L);
+	lua_register(L, "single_integers", single_integers);
+	lua_register(L, "single_strings", single_strings);
+	lua_register(L, "batch_integers", batch_integers);
+	lua_register(L, "batch_strings", batch_strings);
+	lua_register(L, "batch_strings_buffer", batch_strings_buffer);
+
+	if (luaL_dostring(L, setup_script) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return 1;
+	}
+
+	int status = bench_main(argc, argv, benches, NBENCHES, L);
+
+	allocator_close(L);
+
+	return status;
+}
@@ -0,0 +1,235 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Script loading benchmarks.
+ *
+ * Writes a large generated script to a temporary file, one operation is
+ * the whole script compiled:
+ *
+ *   loadfile  luaL_loadfile
+ *   mmap      memory-mapped reader
+ *   stream    streaming reader on the file
+ *   pipe      streaming reader on a pipe fed by cat
+ *
+ * The script size is printed to stderr first, divided by the time per
+ * operation it gives the load throughput. Same options and JSON output
+ * as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "script_loader.h"
+
+/* Size of the generated script */
+#define SCRIPT_MB 4
+
+#define LOAD_LUAL   0
+#define LOAD_MMAP   1
+#define LOAD_STREAM 2
+#define LOAD_PIPE   3
+
+/**
+ * Write about `mb` megabytes of functions and table constructors, the
+ * kind of code configuration and data modules are made of.
+ */
+static size_t
+write_script(const char *path, long mb)
+{
+	FILE *fp = fopen(path, "w");
+	size_t size = 0;
+
+	if (fp == NULL) {
+		return 0;
+	}
+
+	fputs("#!/usr/bin/env lua\nlocal M = {}\n", fp);
+	for (long i = 0; size < (size_t)mb * 1024 * 1024; i++) {
+		int n = fprintf(fp,
+		    "function M.f%ld(a, b)\n"
+		    "    local t = { id = %ld, name = \"item%ld\", a = a }\n"
+		    "    if a > b then return t.id * 2 else return b end\n"
+		    "end\n",
+		    i, i, i);
+
+		if (n < 0) {
+			fclose(fp);
+			return 0;
+		}
+		size += n;
+	}
+	fputs("return M\n", fp);
+
+	return fclose(fp) == 0 ? size : 0;
+}
+
+/**
+ * Feed the file through a pipe from a child, as a shell pipeline would.
+ */
+static int
+load_pipe(lua_State *L, const char *path)
+{
+	int fds[2];
+
+	if (pipe(fds) != 0) {
+		return -1;
+	}
+
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		close(fds[0]);
+		dup2(fds[1], STDOUT_FILENO);
+		execlp("cat", "cat", path, (char *)NULL);
+		_exit(127);
+	}
+	close(fds[1]);
+
+	int status = script_load_stream(L, fds[0], "=pipe");
+
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+
+	return status;
+}
+
+static int
+load(lua_State *L, const char *path, int mode)
+{
+	switch (mode) {
+	case LOAD_LUAL:
+		return luaL_loadfile(L, path);
+	case LOAD_MMAP:
+		return script_load_file(L, path);
+	case LOAD_STREAM: {
+		FILE *fp = fopen(path, "r");
+		int status;
+
+		if (fp == NULL) {
+			return -1;
+		}
+		status = script_load_stream(L, fileno(fp), "=stream");
+		fclose(fp);
+		return status;
+	}
+	default:
+		return load_pipe(L, path);
+	}
+}
+
+struct context {
+	lua_State *L;
+	char path[64];
+};
+
+static void
+run(struct context *c, int mode, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		int status = load(c->L, c->path, mode);
+
+		if (status != LUA_OK) {
+			fprintf(stderr, "%s\n",
+			    status > 0 ? lua_tostring(c->L, -1) : "failed");
+			exit(1);
+		}
+		lua_pop(c->L, 1);
+	}
+}
+
+static void
+bench_loadfile(void *ctx, long iterations)
+{
+	run(ctx, LOAD_LUAL, iterations);
+}
+
+static void
+bench_mmap(void *ctx, long iterations)
+{
+	run(ctx, LOAD_MMAP, iterations);
+}
+
+static void
+bench_stream(void *ctx, long iterations)
+{
+	run(ctx, LOAD_STREAM, iterations);
+}
+
+static void
+bench_pipe(void *ctx, long iterations)
+{
+	run(ctx, LOAD_PIPE, iterations);
+}
+
+/* A load is tens of milliseconds, one per run */
+static const struct bench_def benches[] = {
+	{ "loadfile", bench_loadfile, 1000000 },
+	{ "mmap", bench_mmap, 1000000 },
+	{ "stream", bench_stream, 1000000 },
+	{ "pipe", bench_pipe, 1000000 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	snprintf(c.path, sizeof(c.path), "/tmp/bench_load.%ld.lua",
+	    (long)getpid());
+
+	size_t size = write_script(c.path, SCRIPT_MB);
+	if (size == 0) {
+		perror(c.path);
+		return 1;
+	}
+
+	fprintf(stderr, "script of %zu bytes\n", size);
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	allocator_close(c.L);
+	unlink(c.path);
+
+	return status;
+}
@@ -0,0 +1,238 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Numeric array benchmarks.
+ *
+ * One pass over 4096 numbers per operation, written as a Lua loop over a
+ * table and as a numarray method (see numarray.h):
+ *
+ *   table_sum / numarray_sum        sum of every element
+ *   table_dot / numarray_dot        dot product of two arrays
+ *   table_scale / numarray_scale    multiply in place
+ *   table_filter / numarray_filter  elements in a range
+ *
+ * The numarray_*_<isa> variants force one kernel set, they're left out
+ * when the CPU or the build lacks it. Same options and JSON output as
+ * bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "numarray.h"
+
+static const char *setup_script =
+    "N = 4096\n"
+    "t, u = {}, {}\n"
+    "for i = 1, N do t[i] = (i % 100) * 0.5; u[i] = i * 0.25 end\n"
+    "a, b = numarray.from(t), numarray.from(u)\n"
+    "function table_sum()\n"
+    "    local s = 0\n"
+    "    for i = 1, #t do s = s + t[i] end\n"
+    "    return s\n"
+    "end\n"
+    "function table_dot()\n"
+    "    local s = 0\n"
+    "    for i = 1, #t do s = s + t[i] * u[i] end\n"
+    "    return s\n"
+    "end\n"
+    "function table_scale()\n"
+    "    for i = 1, #t do t[i] = t[i] * 1.0 end\n"
+    "end\n"
+    "function table_filter()\n"
+    "    local r, n = {}, 0\n"
+    "    for i = 1, #t do\n"
+    "        local v = t[i]\n"
+    "        if v >= 10 and v <= 20 then n = n + 1; r[n] = v end\n"
+    "    end\n"
+    "    return r\n"
+    "end\n"
+    "function numarray_sum() return a:sum() end\n"
+    "function numarray_dot() return a:dot(b) end\n"
+    "function numarray_scale() a:scale(1.0) end\n"
+    "function numarray_filter() return a:filter(10, 20) end\n";
+
+/**
+ * Call the Lua function `func` `iterations` times with the kernels `isa`
+ * (NULL for the default).
+ */
+static void
+call(lua_State *L, const char *func, const char *isa, long iterations)
+{
+	numarray_use_isa(isa);
+	lua_getglobal(L, func);
+	for (long i = 0; i < iterations; i++) {
+		lua_pushvalue(L, -1);
+		lua_call(L, 0, 0);
+	}
+	lua_pop(L, 1);
+}
+
+static void
+bench_table_sum(void *ctx, long iterations)
+{
+	call(ctx, "table_sum", NULL, iterations);
+}
+
+static void
+bench_numarray_sum(void *ctx, long iterations)
+{
+	call(ctx, "numarray_sum", NULL, iterations);
+}
+
+static void
+bench_numarray_sum_avx2(void *ctx, long iterations)
+{
+	call(ctx, "numarray_sum", "avx2", iterations);
+}
+
+static void
+bench_numarray_sum_sse2(void *ctx, long iterations)
+{
+	call(ctx, "numarray_sum", "sse2", iterations);
+}
+
+static void
+bench_table_dot(void *ctx, long iterations)
+{
+	call(ctx, "table_dot", NULL, iterations);
+}
+
+static void
+bench_numarray_dot(void *ctx, long iterations)
+{
+	call(ctx, "numarray_dot", NULL, iterations);
+}
+
+static void
+bench_numarray_dot_avx2(void *ctx, long iterations)
+{
+	call(ctx, "numarray_dot", "avx2", iterations);
+}
+
+static void
+bench_numarray_dot_sse2(void *ctx, long iterations)
+{
+	call(ctx, "numarray_dot", "sse2", iterations);
+}
+
+static void
+bench_table_scale(void *ctx, long iterations)
+{
+	call(ctx, "table_scale", NULL, iterations);
+}
+
+static void
+bench_numarray_scale(void *ctx, long iterations)
+{
+	call(ctx, "numarray_scale", NULL, iterations);
+}
+
+static void
+bench_table_filter(void *ctx, long iterations)
+{
+	call(ctx, "table_filter", NULL, iterations);
+}
+
+static void
+bench_numarray_filter(void *ctx, long iterations)
+{
+	call(ctx, "numarray_filter", NULL, iterations);
+}
+
+static const struct bench_def benches[] = {
+	{ "table_sum", bench_table_sum, 10 },
+	{ "numarray_sum", bench_numarray_sum, 1 },
+	{ "table_dot", bench_table_dot, 10 },
+	{ "numarray_dot", bench_numarray_dot, 1 },
+	{ "table_scale", bench_table_scale, 10 },
+	{ "numarray_scale", bench_numarray_scale, 1 },
+	{ "table_filter", bench_table_filter, 10 },
+	{ "numarray_filter", bench_numarray_filter, 1 },
+};
+
+/* Forced kernel sets, only run if this CPU and build have them */
+static const struct bench_def avx2_benches[] = {
+	{ "numarray_sum_avx2", bench_numarray_sum_avx2, 1 },
+	{ "numarray_dot_avx2", bench_numarray_dot_avx2, 1 },
+};
+
+static const struct bench_def sse2_benches[] = {
+	{ "numarray_sum_sse2", bench_numarray_sum_sse2, 1 },
+	{ "numarray_dot_sse2", bench_numarray_dot_sse2, 1 },
+};
+
+#define NBENCHES(b) (sizeof(b) / sizeof((b)[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct bench_def all[NBENCHES(benches) + NBENCHES(avx2_benches) +
+	    NBENCHES(sse2_benches)];
+	size_t n = NBENCHES(benches);
+
+	memcpy(all, benches, sizeof(benches));
+	if (numarray_use_isa("avx2") == 0) {
+		memcpy(&all[n], avx2_benches, sizeof(avx2_benches));
+		n += NBENCHES(avx2_benches);
+	}
+	if (numarray_use_isa("sse2") == 0) {
+		memcpy(&all[n], sse2_benches, sizeof(sse2_benches));
+		n += NBENCHES(sse2_benches);
+	}
+	numarray_use_isa(NULL);
+
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	luaL_openlibs(L);
+	luaL_requiref(L, "numarray", luaopen_numarray, 1);
+	lua_pop(L, 1);
+
+	if (luaL_dostring(L, setup_script) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return 1;
+	}
+
+	fprintf(stderr, "default kernels: %s\n", numarray_isa());
+
+	int status = bench_main(argc, argv, all, n, L);
+
+	allocator_close(L);
+
+	return status;
+}
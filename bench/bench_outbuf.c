@@ -0,0 +1,170 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Output buffer benchmarks, writing to /dev/null so only the library and
+ * syscall costs are left. One operation is one call:
+ *
+ *   print_line       stock print, stdout line buffered (a terminal)
+ *   print_full       stock print, stdout fully buffered (a pipe)
+ *   outbuf_print     outbuf.print
+ *   write_4k_stdio   io.write of a 4 KB string, fully buffered
+ *   write_4k_outbuf  outbuf.write of the same string, not copied
+ *
+ * Same options and JSON output as bench_boundary.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "outbuf.h"
+
+static const char *setup_script =
+    "big = string.rep('x', 4095) .. '\\n'\n"
+    "function print_stock(n)\n"
+    "    for i = 1, n do print('item', i, 'some text') end\n"
+    "end\n"
+    "function print_outbuf(n)\n"
+    "    local p = outbuf.print\n"
+    "    for i = 1, n do p('item', i, 'some text') end\n"
+    "end\n"
+    "function write_stdio(n)\n"
+    "    local w = io.write\n"
+    "    for i = 1, n do w(big) end\n"
+    "end\n"
+    "function write_outbuf(n)\n"
+    "    local w = outbuf.write\n"
+    "    for i = 1, n do w(big) end\n"
+    "end\n";
+
+struct context {
+	lua_State *L;
+	int null;  /* /dev/null */
+	int saved; /* the real stdout */
+};
+
+/**
+ * Run the Lua function `func` for `iterations` writes. Stock print and
+ * io.write go to stdout, sent to /dev/null too while it runs so the
+ * results still reach the real one.
+ */
+static void
+call(struct context *c, const char *func, int mode, long iterations)
+{
+	fflush(stdout);
+	dup2(c->null, STDOUT_FILENO);
+	setvbuf(stdout, NULL, mode, BUFSIZ);
+
+	lua_getglobal(c->L, func);
+	lua_pushinteger(c->L, iterations);
+	lua_call(c->L, 1, 0);
+	fflush(stdout);
+	outbuf_flush(outbuf_get(c->L));
+
+	dup2(c->saved, STDOUT_FILENO);
+}
+
+static void
+bench_print_line(void *ctx, long iterations)
+{
+	call(ctx, "print_stock", _IOLBF, iterations);
+}
+
+static void
+bench_print_full(void *ctx, long iterations)
+{
+	call(ctx, "print_stock", _IOFBF, iterations);
+}
+
+static void
+bench_outbuf_print(void *ctx, long iterations)
+{
+	call(ctx, "print_outbuf", _IOFBF, iterations);
+}
+
+static void
+bench_write_stdio(void *ctx, long iterations)
+{
+	call(ctx, "write_stdio", _IOFBF, iterations);
+}
+
+static void
+bench_write_outbuf(void *ctx, long iterations)
+{
+	call(ctx, "write_outbuf", _IOFBF, iterations);
+}
+
+static const struct bench_def benches[] = {
+	{ "print_line", bench_print_line, 1 },
+	{ "print_full", bench_print_full, 1 },
+	{ "outbuf_print", bench_outbuf_print, 1 },
+	{ "write_4k_stdio", bench_write_stdio, 1 },
+	{ "write_4k_outbuf", bench_write_outbuf, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	c.null = open("/dev/null", O_WRONLY);
+	c.saved = dup(STDOUT_FILENO);
+	if (c.null < 0 || c.saved < 0) {
+		perror("/dev/null");
+		return 1;
+	}
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+	outbuf_open(c.L, c.null);
+
+	if (luaL_dostring(c.L, setup_script) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(c.L, -1));
+		return 1;
+	}
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	allocator_close(c.L);
+	close(c.saved);
+	close(c.null);
+
+	return status;
+}
@@ -0,0 +1,137 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Profiler overhead benchmarks, one operation is one run of a CPU bound
+ * script (recursive calls, table and string work):
+ *
+ *   plain    without the profiler
+ *   sampled  with the sampling profiler at its default interval
+ *
+ * The profiler counters are printed to stderr after the timings. Same
+ * options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "profiler.h"
+
+static const char *script = "local function fib(n)\n"
+			    "    if n < 2 then return n end\n"
+			    "    return fib(n - 1) + fib(n - 2)\n"
+			    "end\n"
+			    "local function strings(n)\n"
+			    "    local t = {}\n"
+			    "    for i = 1, n do t[#t + 1] = tostring(i) end\n"
+			    "    return table.concat(t, ',')\n"
+			    "end\n"
+			    "local acc = 0\n"
+			    "for i = 1, 4 do\n"
+			    "    acc = acc + fib(24) + #strings(20000)\n"
+			    "end\n"
+			    "return acc\n";
+
+struct context {
+	lua_State *L;
+	struct profiler *p;
+};
+
+static void
+run(lua_State *L, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		if (luaL_dostring(L, script) != LUA_OK) {
+			fprintf(stderr, "%s\n", lua_tostring(L, -1));
+			exit(1);
+		}
+		lua_settop(L, 0);
+	}
+}
+
+static void
+bench_plain(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run(c->L, iterations);
+}
+
+static void
+bench_sampled(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	if (profiler_start(c->p, PROFILER_DEFAULT_INTERVAL) != 0) {
+		fprintf(stderr, "can't start the profiler\n");
+		exit(1);
+	}
+	run(c->L, iterations);
+	profiler_stop(c->p);
+}
+
+/* A run of the script takes tens of milliseconds */
+static const struct bench_def benches[] = {
+	{ "plain", bench_plain, 10000 },
+	{ "sampled", bench_sampled, 10000 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+	struct profiler_stats stats;
+
+	c.L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(c.L);
+	c.p = profiler_create(c.L);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	profiler_stats(c.p, &stats);
+	fprintf(stderr,
+	    "samples %llu stacks %llu truncated %llu dropped %llu\n",
+	    (unsigned long long)stats.samples,
+	    (unsigned long long)stats.stacks,
+	    (unsigned long long)stats.truncated,
+	    (unsigned long long)stats.dropped);
+
+	profiler_destroy(c.p);
+	allocator_close(c.L);
+
+	return status;
+}
@@ -0,0 +1,169 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * REPL callbacks under threads, one operation is one line evaluated:
+ *
+ *   evals  8 threads, each with its own REPL state
+ *
+ * Odd threads call quit() all along while even ones never do and check
+ * that their own state never sees it, and that their globals hold what
+ * they stored. Exits with 1 if any state saw another one's changes. Same
+ * options and JSON output as bench_boundary.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+
+#define NTHREADS 8
+
+/* Every this many evaluations odd threads quit, even ones check */
+#define CHECK_EVERY 64
+
+static const char *count_line = "n = (n or 0) + 1\n";
+static const char *quit_line = "quit()\n";
+static const char *read_line = "return tostring(n)\n";
+
+struct worker {
+	pthread_t thread;
+	int id;
+	long evals;
+	long violations;
+};
+
+static int
+eval(lua_State *L, const char *line)
+{
+	int error = repl_eval(L, line, strlen(line));
+
+	if (error) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+	}
+
+	return error;
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct worker *w = arg;
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+	int quitter = w->id % 2;
+
+	luaL_openlibs(L);
+	setup_interpreter_globals(L);
+
+	for (long i = 1; i <= w->evals; i++) {
+		if (eval(L, count_line) != LUA_OK) {
+			w->violations++;
+		}
+		lua_pop(L, 1);
+
+		if (i % CHECK_EVERY != 0) {
+			continue;
+		}
+
+		if (quitter) {
+			eval(L, quit_line);
+			lua_pop(L, 1);
+		} else if (repl_quit_requested(L)) {
+			w->violations++; /* another state's quit() */
+		}
+
+		/* n is only ever touched by this thread */
+		eval(L, read_line);
+		if (strtol(lua_tostring(L, -1), NULL, 10) != i) {
+			w->violations++;
+		}
+		lua_pop(L, 1);
+	}
+
+	/* Quitters called quit() at least once if they got that far */
+	if (w->evals >= CHECK_EVERY && quitter != repl_quit_requested(L)) {
+		w->violations++;
+	}
+
+	allocator_close(L);
+
+	return NULL;
+}
+
+/**
+ * Spread `iterations` evaluations over the threads, the violations are
+ * added up in `ctx`.
+ */
+static void
+bench_evals(void *ctx, long iterations)
+{
+	struct worker workers[NTHREADS];
+	long *violations = ctx;
+
+	for (int i = 0; i < NTHREADS; i++) {
+		workers[i].id = i;
+		workers[i].evals = iterations / NTHREADS;
+		workers[i].violations = 0;
+		if (pthread_create(&workers[i].thread, NULL, worker_main,
+			&workers[i]) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (int i = 0; i < NTHREADS; i++) {
+		pthread_join(workers[i].thread, NULL);
+		*violations += workers[i].violations;
+	}
+}
+
+static const struct bench_def benches[] = {
+	{ "evals", bench_evals, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	long violations = 0;
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &violations);
+
+	fprintf(stderr, "violations %ld\n", violations);
+
+	return status != 0 || violations > 0;
+}
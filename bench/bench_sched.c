@@ -0,0 +1,201 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Scheduler benchmarks, one operation is one task resume:
+ *
+ *   resume           tasks yielding in a loop (some of them also sleep
+ *                    on the timer heap), through scheduler_run
+ *   runaway_trusted  the same mixed with a few runaway tasks that never
+ *                    yield
+ *   runaway_preempt  the same with the default preemption quantum
+ *
+ * The longest single resume and the preemptions of the runaway runs are
+ * printed to stderr after the timings. Same options and JSON output as
+ * bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "preempt.h"
+#include "scheduler.h"
+
+#define YIELDS	      20
+#define RUNAWAY_TASKS 4
+
+/* Additions of a runaway task per operation of the run */
+#define RUNAWAY_WORK 20
+
+static const char *task_script =
+    "local id, yields = ...\n"
+    "for i = 1, yields do\n"
+    "    if id % 10 == 0 and i % 5 == 0 then\n"
+    "        sched.sleep(0.001)\n"
+    "    else\n"
+    "        sched.yield()\n"
+    "    end\n"
+    "end\n";
+
+static const char *runaway_script = "local n = 0\n"
+				    "for i = 1, ... do\n"
+				    "    n = n + i\n"
+				    "end\n";
+
+/* A state and its scheduler */
+struct runner {
+	lua_State *L;
+	struct scheduler *s;
+};
+
+struct context {
+	struct runner plain;
+	struct runner trusted; /* runaway tasks, no quantum */
+	struct runner preempt; /* runaway tasks, default quantum */
+};
+
+/**
+ * Spawn the tasks of about `iterations` resumes and run them, with
+ * `runaway` tasks that never yield first.
+ */
+static void
+run_tasks(struct runner *r, long iterations, int runaway)
+{
+	lua_State *L = r->L;
+	struct scheduler *s = r->s;
+	long tasks = iterations / (YIELDS + 1);
+
+	luaL_loadstring(L, runaway_script);
+	for (int i = 0; i < runaway; i++) {
+		lua_pushvalue(L, -1);
+		lua_pushinteger(L, iterations * RUNAWAY_WORK);
+		scheduler_spawn(s, L, 1);
+	}
+	lua_pop(L, 1);
+
+	luaL_loadstring(L, task_script);
+	for (long i = 0; i < (tasks > 0 ? tasks : 1); i++) {
+		lua_pushvalue(L, -1);
+		lua_pushinteger(L, i);
+		lua_pushinteger(L, YIELDS);
+		scheduler_spawn(s, L, 2);
+	}
+	lua_pop(L, 1);
+
+	scheduler_run(s);
+}
+
+static void
+bench_resume(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run_tasks(&c->plain, iterations, 0);
+}
+
+static void
+bench_runaway_trusted(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run_tasks(&c->trusted, iterations, RUNAWAY_TASKS);
+}
+
+static void
+bench_runaway_preempt(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	run_tasks(&c->preempt, iterations, RUNAWAY_TASKS);
+}
+
+static const struct bench_def benches[] = {
+	{ "resume", bench_resume, 1 },
+	{ "runaway_trusted", bench_runaway_trusted, 10 },
+	{ "runaway_preempt", bench_runaway_preempt, 10 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static void
+runner_open(struct runner *r, int quantum)
+{
+	r->L = allocator_newstate(ALLOCATOR_POOL);
+	luaL_openlibs(r->L);
+	r->s = scheduler_create(r->L);
+	scheduler_set_quantum(r->s, quantum);
+}
+
+static void
+runner_close(struct runner *r)
+{
+	scheduler_destroy(r->s);
+	allocator_close(r->L);
+}
+
+static void
+print_slices(const char *name, struct runner *r)
+{
+	struct scheduler_stats stats;
+
+	scheduler_stats(r->s, &stats);
+	if (stats.resumes > 0) {
+		fprintf(stderr, "%-20s longest resume %.3f ms, "
+				"%llu preemptions\n",
+		    name, stats.max_slice_ns / 1e6,
+		    (unsigned long long)stats.preemptions);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	runner_open(&c.plain, 0);
+	runner_open(&c.trusted, 0);
+	runner_open(&c.preempt, PREEMPT_DEFAULT_QUANTUM);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	print_slices("runaway_trusted", &c.trusted);
+	print_slices("runaway_preempt", &c.preempt);
+
+	runner_close(&c.preempt);
+	runner_close(&c.trusted);
+	runner_close(&c.plain);
+
+	return status;
+}
@@ -0,0 +1,219 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Shared store benchmarks, over a 50000 entry configuration table:
+ *
+ *   copy_build     a state building its own copy of the table
+ *   shared_open    a state opening the same data published once in a
+ *                  shared store
+ *   copy_lookup    one lookup in the table
+ *   shared_lookup  one lookup through the store view
+ *
+ * The Lua heap of a state holding each is printed to stderr first. Same
+ * options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "shared_store.h"
+
+static const char *config_script =
+    "local config = {}\n"
+    "for i = 1, 50000 do\n"
+    "    config['key' .. i] = { id = i, name = 'item' .. i,\n"
+    "        weight = i * 0.5, tags = { 'a', 'b' } }\n"
+    "end\n"
+    "return config\n";
+
+/* Returns a function doing `n` lookups of the ids, in key order */
+static const char *lookup_script =
+    "local config = ...\n"
+    "local keys = {}\n"
+    "for i = 1, 50000 do keys[i] = 'key' .. i end\n"
+    "return function(n)\n"
+    "    local s = 0\n"
+    "    for i = 1, n do s = s + config[keys[(i - 1) % #keys + 1]].id end\n"
+    "    return s\n"
+    "end\n";
+
+struct context {
+	struct shared_store *store;
+	lua_State *copy;   /* `config` is its own table */
+	lua_State *shared; /* `config` is the store view */
+};
+
+static void
+check(lua_State *L, int status)
+{
+	if (status != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+}
+
+static lua_State *
+new_state(void)
+{
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	luaL_openlibs(L);
+	luaL_requiref(L, "shared_store", luaopen_shared_store, 1);
+	lua_pop(L, 1);
+
+	return L;
+}
+
+/* State with `config` copied, or opened from the store if not NULL */
+static lua_State *
+config_state(struct shared_store *store)
+{
+	lua_State *L = new_state();
+
+	if (store != NULL) {
+		shared_store_push(L, store);
+	} else {
+		check(L, luaL_dostring(L, config_script));
+	}
+	lua_setglobal(L, "config");
+
+	return L;
+}
+
+/* Heap of the state, in kilobytes, after a full collection */
+static double
+heap_kb(lua_State *L)
+{
+	lua_gc(L, LUA_GCCOLLECT);
+
+	return lua_gc(L, LUA_GCCOUNT) + lua_gc(L, LUA_GCCOUNTB) / 1024.0;
+}
+
+/* Set the `lookup` global of L, see lookup_script */
+static void
+prepare_lookup(lua_State *L)
+{
+	check(L, luaL_loadstring(L, lookup_script));
+	lua_getglobal(L, "config");
+	check(L, lua_pcall(L, 1, 1, 0));
+	lua_setglobal(L, "lookup");
+}
+
+static void
+lookup(lua_State *L, long iterations)
+{
+	lua_getglobal(L, "lookup");
+	lua_pushinteger(L, iterations);
+	check(L, lua_pcall(L, 1, 0, 0));
+}
+
+static void
+bench_copy_build(__UNUSED void *ctx, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		allocator_close(config_state(NULL));
+	}
+}
+
+static void
+bench_shared_open(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	for (long i = 0; i < iterations; i++) {
+		allocator_close(config_state(c->store));
+	}
+}
+
+static void
+bench_copy_lookup(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	lookup(c->copy, iterations);
+}
+
+static void
+bench_shared_lookup(void *ctx, long iterations)
+{
+	struct context *c = ctx;
+
+	lookup(c->shared, iterations);
+}
+
+/* Building the table takes tens of milliseconds, one per run */
+static const struct bench_def benches[] = {
+	{ "copy_build", bench_copy_build, 1000000 },
+	{ "shared_open", bench_shared_open, 100 },
+	{ "copy_lookup", bench_copy_lookup, 1 },
+	{ "shared_lookup", bench_shared_lookup, 1 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct context c;
+
+	/* Built once, the states only open it */
+	c.store = shared_store_create();
+	lua_State *builder = new_state();
+
+	check(builder, luaL_dostring(builder, config_script));
+	if (c.store == NULL ||
+	    shared_store_publish(c.store, builder, -1) != 0) {
+		fprintf(stderr, "can't publish the store\n");
+		return 1;
+	}
+	allocator_close(builder);
+
+	c.copy = config_state(NULL);
+	c.shared = config_state(c.store);
+	fprintf(stderr, "heap per state: copy %.1f KB, shared %.1f KB\n",
+	    heap_kb(c.copy), heap_kb(c.shared));
+	prepare_lookup(c.copy);
+	prepare_lookup(c.shared);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, &c);
+
+	allocator_close(c.shared);
+	allocator_close(c.copy);
+	shared_store_release(c.store);
+
+	return status;
+}
@@ -0,0 +1,199 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Startup benchmark.
+ *
+ * Compares loading the example scripts from source (parse + compile) with
+ * loading the bytecode embedded at build time, one operation is one load:
+ *
+ *   <script>_source    lua2c, c2lua or yield parsed and compiled
+ *   <script>_bytecode  the same script from its embedded bytecode
+ *   startup_source     full example startup (state, libraries and every
+ *   startup_bytecode   script), from source or from bytecode
+ *
+ * The script sizes are printed to stderr first. Same options and JSON
+ * output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "scripts/c2lua.h"
+#include "scripts/lua2c.h"
+#include "scripts/yield.h"
+
+#define SCRIPT(name)                                                        \
+	{                                                                   \
+		#name, name##_source, sizeof(name##_source) - 1,            \
+		    name##_bytecode, sizeof(name##_bytecode)                \
+	}
+
+static const struct script {
+	const char *name;
+	const unsigned char *source;
+	size_t source_len;
+	const unsigned char *bytecode;
+	size_t bytecode_len;
+} scripts[] = {
+	SCRIPT(lua2c),
+	SCRIPT(c2lua),
+	SCRIPT(yield),
+};
+
+#define NUM_SCRIPTS (sizeof(scripts) / sizeof(scripts[0]))
+
+static void
+load(lua_State *L, const struct script *s, int binary)
+{
+	int error;
+
+	if (binary) {
+		error = luaL_loadbufferx(L, (const char *)s->bytecode,
+		    s->bytecode_len, s->name, "b");
+	} else {
+		error = luaL_loadbufferx(L, (const char *)s->source,
+		    s->source_len, s->name, "t");
+	}
+
+	if (error != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+	lua_pop(L, 1);
+}
+
+static void
+load_loop(lua_State *L, size_t script, int binary, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		load(L, &scripts[script], binary);
+	}
+}
+
+/* A full startup: new state, libraries and every script. */
+static void
+startup(int binary, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+		luaL_openlibs(L);
+		for (size_t j = 0; j < NUM_SCRIPTS; j++) {
+			load(L, &scripts[j], binary);
+		}
+		allocator_close(L);
+	}
+}
+
+static void
+bench_lua2c_source(void *ctx, long iterations)
+{
+	load_loop(ctx, 0, 0, iterations);
+}
+
+static void
+bench_lua2c_bytecode(void *ctx, long iterations)
+{
+	load_loop(ctx, 0, 1, iterations);
+}
+
+static void
+bench_c2lua_source(void *ctx, long iterations)
+{
+	load_loop(ctx, 1, 0, iterations);
+}
+
+static void
+bench_c2lua_bytecode(void *ctx, long iterations)
+{
+	load_loop(ctx, 1, 1, iterations);
+}
+
+static void
+bench_yield_source(void *ctx, long iterations)
+{
+	load_loop(ctx, 2, 0, iterations);
+}
+
+static void
+bench_yield_bytecode(void *ctx, long iterations)
+{
+	load_loop(ctx, 2, 1, iterations);
+}
+
+static void
+bench_startup_source(__UNUSED void *ctx, long iterations)
+{
+	startup(0, iterations);
+}
+
+static void
+bench_startup_bytecode(__UNUSED void *ctx, long iterations)
+{
+	startup(1, iterations);
+}
+
+static const struct bench_def benches[] = {
+	{ "lua2c_source", bench_lua2c_source, 10 },
+	{ "lua2c_bytecode", bench_lua2c_bytecode, 10 },
+	{ "c2lua_source", bench_c2lua_source, 10 },
+	{ "c2lua_bytecode", bench_c2lua_bytecode, 10 },
+	{ "yield_source", bench_yield_source, 10 },
+	{ "yield_bytecode", bench_yield_bytecode, 10 },
+	{ "startup_source", bench_startup_source, 100 },
+	{ "startup_bytecode", bench_startup_bytecode, 100 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	for (size_t i = 0; i < NUM_SCRIPTS; i++) {
+		fprintf(stderr, "%-8s %6zu source bytes, %6zu bytecode bytes\n",
+		    scripts[i].name, scripts[i].source_len,
+		    scripts[i].bytecode_len);
+	}
+
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	int status = bench_main(argc, argv, benches, NBENCHES, L);
+
+	allocator_close(L);
+
+	return status;
+}
@@ -0,0 +1,133 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * State pool benchmarks, one operation is one short script run in a
+ * REPL-like state:
+ *
+ *   cold    state built, used and closed every time
+ *   pooled  warm state acquired from the state pool and released
+ *
+ * The pool counters and the mean reset time are printed to stderr after
+ * the timings. Same options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "state_pool.h"
+
+#define POOL_SIZE 8
+
+/* A short script which also leaves some globals behind. */
+static const char *script = "counter = (counter or 0) + 1\n"
+			    "local t = { native, val.key }\n"
+			    "return #t\n";
+
+static void
+run_script(lua_State *L)
+{
+	if (luaL_loadstring(L, script) != LUA_OK ||
+	    lua_pcall(L, 0, 1, 0) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+	lua_pop(L, 1);
+}
+
+static void
+bench_cold(__UNUSED void *ctx, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+		luaL_openlibs(L);
+		setup_interpreter_globals(L);
+		run_script(L);
+		allocator_close(L);
+	}
+}
+
+static void
+bench_pooled(void *ctx, long iterations)
+{
+	struct state_pool *pool = ctx;
+
+	for (long i = 0; i < iterations; i++) {
+		lua_State *L = state_pool_acquire(pool);
+
+		run_script(L);
+		state_pool_release(pool, L);
+	}
+}
+
+/* Building a state is slow, scaled like state_create in bench_boundary */
+static const struct bench_def benches[] = {
+	{ "cold", bench_cold, 100 },
+	{ "pooled", bench_pooled, 10 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char **argv)
+{
+	struct state_pool *pool = state_pool_create(POOL_SIZE, ALLOCATOR_POOL);
+	struct state_pool_stats stats;
+
+	if (pool == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	int status = bench_main(argc, argv, benches, NBENCHES, pool);
+
+	state_pool_stats(pool, &stats);
+	state_pool_destroy(pool);
+
+	if (stats.hits + stats.misses > 0) {
+		fprintf(stderr,
+		    "hits %llu misses %llu resets %llu discarded %llu, "
+		    "%.3f us/reset\n",
+		    (unsigned long long)stats.hits,
+		    (unsigned long long)stats.misses,
+		    (unsigned long long)stats.resets,
+		    (unsigned long long)stats.discarded,
+		    stats.resets ? stats.reset_ns / 1e3 / stats.resets : 0.0);
+	}
+
+	return status;
+}
@@ -0,0 +1,150 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * State setup benchmarks, one operation is a state created with its
+ * libraries and closed:
+ *
+ *   openlibs        luaL_openlibs
+ *   profile_all     stdlibs_open_profile, every library eager
+ *   profile_string  string and table eager, the rest lazy
+ *   profile_base    only base and package eager
+ *   base_touch_io   profile_base, then `io` read once (built lazily)
+ *
+ * The memory held by a fresh state of each setup is printed to stderr
+ * before the timings. Same options and JSON output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "bench/harness.h"
+#include "examples.h"
+#include "stdlibs.h"
+
+#define OPENLIBS (-1)
+
+/**
+ * New state with the libraries of the profile `eager` (OPENLIBS for
+ * luaL_openlibs), then the global `touch` read once if not NULL.
+ */
+static lua_State *
+new_state(int eager, const char *touch)
+{
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	if (eager == OPENLIBS) {
+		luaL_openlibs(L);
+	} else {
+		stdlibs_open_profile(L, eager);
+	}
+
+	if (touch != NULL) {
+		lua_getglobal(L, touch);
+		lua_pop(L, 1);
+	}
+
+	return L;
+}
+
+static void
+setup(int eager, const char *touch, long iterations)
+{
+	for (long i = 0; i < iterations; i++) {
+		allocator_close(new_state(eager, touch));
+	}
+}
+
+static void
+bench_openlibs(__UNUSED void *ctx, long iterations)
+{
+	setup(OPENLIBS, NULL, iterations);
+}
+
+static void
+bench_profile_all(__UNUSED void *ctx, long iterations)
+{
+	setup(STDLIBS_ALL, NULL, iterations);
+}
+
+static void
+bench_profile_string(__UNUSED void *ctx, long iterations)
+{
+	setup(STDLIBS_STRING | STDLIBS_TABLE, NULL, iterations);
+}
+
+static void
+bench_profile_base(__UNUSED void *ctx, long iterations)
+{
+	setup(0, NULL, iterations);
+}
+
+static void
+bench_base_touch_io(__UNUSED void *ctx, long iterations)
+{
+	setup(0, "io", iterations);
+}
+
+/* A state per operation, scaled like state_create in bench_boundary */
+static const struct bench_def benches[] = {
+	{ "openlibs", bench_openlibs, 100 },
+	{ "profile_all", bench_profile_all, 100 },
+	{ "profile_string", bench_profile_string, 100 },
+	{ "profile_base", bench_profile_base, 100 },
+	{ "base_touch_io", bench_base_touch_io, 100 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static void
+print_memory(const char *name, int eager, const char *touch)
+{
+	lua_State *L = new_state(eager, touch);
+
+	fprintf(stderr, "%-16s %8d bytes per state\n", name,
+	    lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0));
+	allocator_close(L);
+}
+
+int
+main(int argc, char **argv)
+{
+	print_memory("openlibs", OPENLIBS, NULL);
+	print_memory("profile_all", STDLIBS_ALL, NULL);
+	print_memory("profile_string", STDLIBS_STRING | STDLIBS_TABLE, NULL);
+	print_memory("profile_base", 0, NULL);
+	print_memory("base_touch_io", 0, "io");
+
+	return bench_main(argc, argv, benches, NBENCHES, NULL);
+}
@@ -0,0 +1,201 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Worker pool benchmarks, one operation is one CPU bound job submitted
+ * and finished:
+ *
+ *   workers_1 ... workers_64  pool of that many workers
+ *   workers_ncpu              one worker per online CPU
+ *
+ * Only the pools up to one worker per CPU run. The speedup over a single
+ * worker is the ratio of their ops_per_sec. Same options and JSON
+ * output as bench_boundary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lua.h>
+
+#include "bench/harness.h"
+#include "worker_pool.h"
+
+/* Pools of 1, 2, 4, ... 64 workers */
+#define NPOOLS 7
+
+static const char *job_script = "local acc = 0\n"
+				"for i = 1, 200000 do\n"
+				"    acc = (acc + i * i) % 1000003\n"
+				"end\n"
+				"return acc\n";
+
+struct context {
+	struct worker_pool *pools[NPOOLS + 1]; /* the last one for ncpu */
+	struct worker_job **jobs;
+	long njobs; /* room in jobs */
+};
+
+/**
+ * Run `iterations` jobs on the pool `pool` created by main, 2^pool workers
+ * or one per CPU for the last one.
+ */
+static void
+run(struct context *c, int pool, long iterations)
+{
+	size_t len = strlen(job_script);
+
+	if (iterations > c->njobs) {
+		free(c->jobs);
+		c->jobs = calloc(iterations, sizeof(*c->jobs));
+		c->njobs = iterations;
+		if (c->jobs == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+
+	for (long i = 0; i < iterations; i++) {
+		c->jobs[i] = worker_pool_submit(c->pools[pool], job_script,
+		    len);
+	}
+	worker_pool_wait_all(c->pools[pool]);
+
+	for (long i = 0; i < iterations; i++) {
+		const char *result;
+
+		if (worker_job_wait(c->jobs[i], &result, NULL) != LUA_OK) {
+			fprintf(stderr, "job %ld: %s\n", i, result);
+			exit(1);
+		}
+		worker_job_free(c->jobs[i]);
+	}
+}
+
+static void
+bench_workers_1(void *ctx, long iterations)
+{
+	run(ctx, 0, iterations);
+}
+
+static void
+bench_workers_2(void *ctx, long iterations)
+{
+	run(ctx, 1, iterations);
+}
+
+static void
+bench_workers_4(void *ctx, long iterations)
+{
+	run(ctx, 2, iterations);
+}
+
+static void
+bench_workers_8(void *ctx, long iterations)
+{
+	run(ctx, 3, iterations);
+}
+
+static void
+bench_workers_16(void *ctx, long iterations)
+{
+	run(ctx, 4, iterations);
+}
+
+static void
+bench_workers_32(void *ctx, long iterations)
+{
+	run(ctx, 5, iterations);
+}
+
+static void
+bench_workers_64(void *ctx, long iterations)
+{
+	run(ctx, 6, iterations);
+}
+
+static void
+bench_workers_ncpu(void *ctx, long iterations)
+{
+	run(ctx, NPOOLS, iterations);
+}
+
+/* A job is a few milliseconds, scaled down to keep runs short */
+static const struct bench_def benches[NPOOLS + 1] = {
+	{ "workers_1", bench_workers_1, 1000 },
+	{ "workers_2", bench_workers_2, 1000 },
+	{ "workers_4", bench_workers_4, 1000 },
+	{ "workers_8", bench_workers_8, 1000 },
+	{ "workers_16", bench_workers_16, 1000 },
+	{ "workers_32", bench_workers_32, 1000 },
+	{ "workers_64", bench_workers_64, 1000 },
+	{ "workers_ncpu", bench_workers_ncpu, 1000 },
+};
+
+int
+main(int argc, char **argv)
+{
+	struct context c = { .jobs = NULL, .njobs = 0 };
+	struct bench_def selected[NPOOLS + 1];
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t n = 0;
+
+	if (ncpu < 1) {
+		ncpu = 1;
+	}
+
+	fprintf(stderr, "%ld CPUs\n", ncpu);
+
+	for (int i = 0; i <= NPOOLS; i++) {
+		long workers = i < NPOOLS ? 1L << i : ncpu;
+
+		c.pools[i] = NULL;
+		if (workers > ncpu) {
+			continue;
+		}
+
+		c.pools[i] = worker_pool_create((int)workers);
+		if (c.pools[i] == NULL) {
+			fprintf(stderr, "can't create %ld workers\n", workers);
+			return 1;
+		}
+		selected[n++] = benches[i];
+	}
+
+	int status = bench_main(argc, argv, selected, n, &c);
+
+	for (int i = 0; i <= NPOOLS; i++) {
+		worker_pool_destroy(c.pools[i]);
+	}
+	free(c.jobs);
+
+	return status;
+}
@@ -0,0 +1,251 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#define DEFAULT_WARMUP	   3
+#define DEFAULT_REPEATS	   30
+#define DEFAULT_ITERATIONS 100000
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Nearest rank percentile of sorted samples.
+ */
+static double
+percentile(const double *sorted, int n, int pct)
+{
+	int rank = (pct * n + 99) / 100;
+
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+int
+bench_parse_options(int argc, char **argv, struct bench_options *opts)
+{
+	int c;
+
+	opts->warmup = DEFAULT_WARMUP;
+	opts->repeats = DEFAULT_REPEATS;
+	opts->iterations = DEFAULT_ITERATIONS;
+	opts->output = NULL;
+
+	while ((c = getopt(argc, argv, "w:r:n:o:")) != -1) {
+		switch (c) {
+		case 'w':
+			opts->warmup = atoi(optarg);
+			break;
+		case 'r':
+			opts->repeats = atoi(optarg);
+			break;
+		case 'n':
+			opts->iterations = strtol(optarg, NULL, 10);
+			break;
+		case 'o':
+			opts->output = optarg;
+			break;
+		default:
+			fprintf(stderr,
+			    "usage: %s [-w warmup] [-r repeats] "
+			    "[-n iterations] [-o file.json] [name...]\n",
+			    argv[0]);
+			exit(2);
+		}
+	}
+
+	if (opts->repeats < 1) {
+		opts->repeats = 1;
+	}
+	if (opts->iterations < 1) {
+		opts->iterations = 1;
+	}
+
+	return optind;
+}
+
+int
+bench_run(const char *name, bench_func fn, void *ctx, long scale,
+    const struct bench_options *opts, struct bench_result *result)
+{
+	long iterations = opts->iterations / (scale > 0 ? scale : 1);
+	double *samples = malloc(opts->repeats * sizeof(*samples));
+
+	if (samples == NULL) {
+		return -1;
+	}
+	if (iterations < 1) {
+		iterations = 1;
+	}
+
+	for (int i = 0; i < opts->warmup; i++) {
+		fn(ctx, iterations);
+	}
+
+	double total = 0;
+
+	for (int i = 0; i < opts->repeats; i++) {
+		double start = now_ns();
+
+		fn(ctx, iterations);
+		samples[i] = (now_ns() - start) / iterations;
+		total += samples[i];
+	}
+
+	qsort(samples, opts->repeats, sizeof(*samples), compare_double);
+
+	result->name = name;
+	result->iterations = iterations;
+	result->repeats = opts->repeats;
+	result->min = samples[0];
+	result->mean = total / opts->repeats;
+	result->p50 = percentile(samples, opts->repeats, 50);
+	result->p90 = percentile(samples, opts->repeats, 90);
+	result->p99 = percentile(samples, opts->repeats, 99);
+	result->max = samples[opts->repeats - 1];
+
+	free(samples);
+
+	return 0;
+}
+
+void
+bench_print(const struct bench_result *r)
+{
+	fprintf(stderr,
+	    "%-20s p50 %10.1f ns/op  p90 %10.1f  p99 %10.1f  (%ld x %d)\n",
+	    r->name, r->p50, r->p90, r->p99, r->iterations, r->repeats);
+}
+
+int
+bench_write_json(FILE *out, const struct bench_result *results, size_t n)
+{
+	fprintf(out, "{\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [");
+
+	for (size_t i = 0; i < n; i++) {
+		const struct bench_result *r = &results[i];
+
+		fprintf(out,
+		    "%s\n    {\"name\": \"%s\", \"iterations\": %ld, "
+		    "\"repeats\": %d, \"min\": %.1f, \"mean\": %.1f, "
+		    "\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+		    "\"max\": %.1f, \"ops_per_sec\": %.0f}",
+		    i ? "," : "", r->name, r->iterations, r->repeats, r->min,
+		    r->mean, r->p50, r->p90, r->p99, r->max,
+		    r->p50 > 0 ? 1e9 / r->p50 : 0.0);
+	}
+
+	fprintf(out, "\n  ]\n}\n");
+
+	return ferror(out) ? -1 : 0;
+}
+
+/* Whether `name` is one of the arguments from `first`, or there's none */
+static int
+selected(const char *name, int argc, char **argv, int first)
+{
+	if (first >= argc) {
+		return 1;
+	}
+
+	for (int i = first; i < argc; i++) {
+		if (strcmp(argv[i], name) == 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int
+bench_main(int argc, char **argv, const struct bench_def *benches,
+    size_t n, void *ctx)
+{
+	struct bench_options opts;
+	struct bench_result *results = calloc(n + 1, sizeof(*results));
+	size_t done = 0;
+	int status = 0;
+
+	int first = bench_parse_options(argc, argv, &opts);
+
+	if (results == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		const struct bench_def *b = &benches[i];
+
+		if (!selected(b->name, argc, argv, first)) {
+			continue;
+		}
+		if (bench_run(b->name, b->fn, ctx, b->scale, &opts,
+			&results[done]) != 0) {
+			fprintf(stderr, "out of memory\n");
+			free(results);
+			return 1;
+		}
+		bench_print(&results[done]);
+		done++;
+	}
+
+	FILE *out = opts.output ? fopen(opts.output, "w") : stdout;
+
+	if (out == NULL || bench_write_json(out, results, done) != 0) {
+		perror(opts.output ? opts.output : "stdout");
+		status = 1;
+	}
+	if (out != NULL && out != stdout) {
+		fclose(out);
+	}
+	free(results);
+
+	return status;
+}
@@ -0,0 +1,114 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Benchmark harness.
+ *
+ * A benchmark is a function running `iterations` operations. The harness
+ * calls it a few times to warm up, then `repeats` times while timing each
+ * run, and reports the nanoseconds per operation percentiles over the
+ * runs.
+ */
+
+typedef void (*bench_func)(void *ctx, long iterations);
+
+struct bench_options {
+	int warmup;	    /* runs thrown away first */
+	int repeats;	    /* measured runs */
+	long iterations;    /* operations per run */
+	const char *output; /* JSON file, NULL for stdout */
+};
+
+struct bench_result {
+	const char *name;
+	long iterations;
+	int repeats;
+
+	/* Nanoseconds per operation over the measured runs */
+	double min;
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+/*
+ * Fill `opts` from the command line:
+ *
+ *   -w warmup  -r repeats  -n iterations  -o output.json
+ *
+ * Returns the index of the first argument left (benchmark names to run).
+ */
+int bench_parse_options(int argc, char **argv, struct bench_options *opts);
+
+/*
+ * Run a benchmark, `scale` divides the iterations for the slow ones.
+ * Returns 0 or -1 if out of memory.
+ */
+int bench_run(const char *name, bench_func fn, void *ctx, long scale,
+    const struct bench_options *opts, struct bench_result *result);
+
+/* Print one line summary of a result to stderr. */
+void bench_print(const struct bench_result *result);
+
+/* Write every result as a JSON document. Returns 0 or -1. */
+int bench_write_json(FILE *out, const struct bench_result *results,
+    size_t n);
+
+/* A benchmark of a table run by bench_main. */
+struct bench_def {
+	const char *name;
+	bench_func fn;
+	long scale; /* see bench_run */
+};
+
+/*
+ * Whole benchmark program: parse the options, run the benchmarks of the
+ * table named on the command line (all by default) with `ctx`, print
+ * them and write the JSON results. Returns the exit status.
+ */
+int bench_main(int argc, char **argv, const struct bench_def *benches,
+    size_t n, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BENCH_HARNESS_H */
@@ -0,0 +1,249 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "binding.h"
+#include "examples.h"
+
+struct binding {
+	const struct binding_field *fields;
+	size_t nfields;
+	int keys_ref; /* registry reference of the interned names */
+};
+
+struct binding *
+binding_create(lua_State *L, const struct binding_field *fields,
+    size_t nfields)
+{
+	/* The names, in field order; first, as they can raise errors */
+	lua_createtable(L, nfields, 0);
+	for (size_t i = 0; i < nfields; i++) {
+		lua_pushstring(L, fields[i].name);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	int keys_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	struct binding *b = malloc(sizeof(*b));
+
+	if (b == NULL) {
+		luaL_unref(L, LUA_REGISTRYINDEX, keys_ref);
+		return NULL;
+	}
+
+	b->fields = fields;
+	b->nfields = nfields;
+	b->keys_ref = keys_ref;
+
+	return b;
+}
+
+void
+binding_destroy(lua_State *L, struct binding *b)
+{
+	if (b == NULL) {
+		return;
+	}
+
+	luaL_unref(L, LUA_REGISTRYINDEX, b->keys_ref);
+	free(b);
+}
+
+static void
+push_member(lua_State *L, const struct binding_field *f, const char *p)
+{
+	switch (f->type) {
+	case BINDING_INT:
+		lua_pushinteger(L, *(const int *)p);
+		break;
+	case BINDING_INTEGER:
+		lua_pushinteger(L, *(const lua_Integer *)p);
+		break;
+	case BINDING_NUMBER:
+		lua_pushnumber(L, *(const double *)p);
+		break;
+	case BINDING_BOOLEAN:
+		lua_pushboolean(L, *(const int *)p);
+		break;
+	case BINDING_CHARS:
+		lua_pushlstring(L, p, strnlen(p, f->size));
+		break;
+	case BINDING_STRING:
+		lua_pushstring(L, *(const char *const *)p);
+		break;
+	}
+}
+
+static int
+type_error(lua_State *L, const struct binding_field *f, const char *what)
+{
+	return luaL_error(L, "field '%s': %s expected, got %s", f->name,
+	    what, luaL_typename(L, -1));
+}
+
+/* Store the value on top of the stack in the member */
+static void
+to_member(lua_State *L, const struct binding_field *f, char *p)
+{
+	int isnum;
+
+	switch (f->type) {
+	case BINDING_INT:
+	case BINDING_INTEGER: {
+		lua_Integer n = lua_tointegerx(L, -1, &isnum);
+
+		if (!isnum) {
+			type_error(L, f, "integer");
+		}
+		if (f->type == BINDING_INT) {
+			if (n < INT_MIN || n > INT_MAX) {
+				type_error(L, f, "integer in int range");
+			}
+			*(int *)p = n;
+		} else {
+			*(lua_Integer *)p = n;
+		}
+		break;
+	}
+	case BINDING_NUMBER: {
+		lua_Number n = lua_tonumberx(L, -1, &isnum);
+
+		if (!isnum) {
+			type_error(L, f, "number");
+		}
+		*(double *)p = n;
+		break;
+	}
+	case BINDING_BOOLEAN:
+		*(int *)p = lua_toboolean(L, -1);
+		break;
+	case BINDING_CHARS:
+	case BINDING_STRING: {
+		size_t len;
+		const char *s = lua_type(L, -1) == LUA_TSTRING
+		    ? lua_tolstring(L, -1, &len)
+		    : NULL;
+
+		if (s == NULL) {
+			type_error(L, f, "string");
+		}
+		if (f->type == BINDING_STRING) {
+			*(const char **)p = s;
+		} else if (f->size > 0) {
+			len = len < f->size ? len : f->size - 1;
+			memcpy(p, s, len);
+			p[len] = '\0';
+		}
+		break;
+	}
+	}
+}
+
+void
+binding_push(lua_State *L, const struct binding *b, const void *record)
+{
+	lua_createtable(L, 0, b->nfields);
+	binding_set(L, b, -1, record);
+}
+
+void
+binding_set(lua_State *L, const struct binding *b, int idx,
+    const void *record)
+{
+	idx = lua_absindex(L, idx);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, b->keys_ref);
+
+	int keys = lua_gettop(L);
+
+	for (size_t i = 0; i < b->nfields; i++) {
+		const struct binding_field *f = &b->fields[i];
+
+		lua_rawgeti(L, keys, i + 1);
+		push_member(L, f, (const char *)record + f->offset);
+		lua_rawset(L, idx);
+	}
+	lua_pop(L, 1);
+}
+
+int
+binding_get(lua_State *L, const struct binding *b, int idx, void *record)
+{
+	int found = 0;
+
+	idx = lua_absindex(L, idx);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, b->keys_ref);
+
+	int keys = lua_gettop(L);
+
+	for (size_t i = 0; i < b->nfields; i++) {
+		const struct binding_field *f = &b->fields[i];
+
+		lua_rawgeti(L, keys, i + 1);
+		if (lua_rawget(L, idx) != LUA_TNIL) {
+			to_member(L, f, (char *)record + f->offset);
+			found++;
+		}
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	return found;
+}
+
+void
+binding_push_key(lua_State *L, const struct binding *b, size_t i)
+{
+	lua_rawgeti(L, LUA_REGISTRYINDEX, b->keys_ref);
+	lua_rawgeti(L, -1, i + 1);
+	lua_remove(L, -2);
+}
+
+int
+binding_getfield(lua_State *L, const struct binding *b, int idx, size_t i)
+{
+	idx = lua_absindex(L, idx);
+	binding_push_key(L, b, i);
+
+	return lua_rawget(L, idx);
+}
+
+void
+binding_setfield(lua_State *L, const struct binding *b, int idx, size_t i)
+{
+	idx = lua_absindex(L, idx);
+	binding_push_key(L, b, i);
+	lua_insert(L, -2);
+	lua_rawset(L, idx);
+}
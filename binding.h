@@ -0,0 +1,119 @@
+#ifndef BINDING_H
+#define BINDING_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+/* Field types, the C member each one maps */
+#define BINDING_INT	0 /* int */
+#define BINDING_INTEGER 1 /* lua_Integer */
+#define BINDING_NUMBER	2 /* double */
+#define BINDING_BOOLEAN 3 /* int, 0 or 1 */
+#define BINDING_CHARS	4 /* char array, NUL terminated */
+#define BINDING_STRING	5 /* const char *, NULL maps to nil */
+
+/* Describe `member` of `type` as a field of the same name. */
+#define BINDING_FIELD(type, member, kind) \
+	{ #member, kind, offsetof(type, member), sizeof(((type *)0)->member) }
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Table bindings of C structs.
+ *
+ * A binding is built once per state from a static descriptor array: the
+ * field names are interned then, in a table held in the registry, and
+ * every access pushes the key from there instead of hashing the C string
+ * again as lua_setfield/lua_getfield do. Records are converted with raw
+ * accesses in one pass, metamethods aren't called.
+ *
+ *   static const struct binding_field point_fields[] = {
+ *       BINDING_FIELD(struct point, x, BINDING_NUMBER),
+ *       BINDING_FIELD(struct point, y, BINDING_NUMBER),
+ *   };
+ */
+
+struct binding_field {
+	const char *name;
+	int type;
+	size_t offset;
+	size_t size; /* of the member, the buffer size of BINDING_CHARS */
+};
+
+struct binding;
+
+/*
+ * Intern the names of `fields` (which must outlive the binding) in L.
+ * Returns NULL if out of memory.
+ */
+struct binding *binding_create(lua_State *L,
+    const struct binding_field *fields, size_t nfields);
+
+/* Release the interned names and free the binding. */
+void binding_destroy(lua_State *L, struct binding *b);
+
+/* Push a new table with the fields of `record`. */
+void binding_push(lua_State *L, const struct binding *b, const void *record);
+
+/* Store the fields of `record` in the table at `idx`. */
+void binding_set(lua_State *L, const struct binding *b, int idx,
+    const void *record);
+
+/*
+ * Read the fields of the table at `idx` into `record`, absent (nil) fields
+ * are left untouched. BINDING_STRING members point into the Lua strings,
+ * valid while the table keeps them. Raises an error on a type mismatch,
+ * otherwise returns the number of fields read.
+ */
+int binding_get(lua_State *L, const struct binding *b, int idx,
+    void *record);
+
+/* Push the interned name of field `i`. */
+void binding_push_key(lua_State *L, const struct binding *b, size_t i);
+
+/*
+ * Single field access with the interned name, like lua_getfield and
+ * lua_setfield (pops the value) but raw.
+ */
+int binding_getfield(lua_State *L, const struct binding *b, int idx,
+    size_t i);
+void binding_setfield(lua_State *L, const struct binding *b, int idx,
+    size_t i);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BINDING_H */
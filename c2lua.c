@@ -33,7 +33,11 @@
 #include <lua.h>
 #include <lualib.h>
 
+#include "allocator.h"
+#include "coro_pool.h"
 #include "examples.h"
+#include "profiler.h"
+#include "scripts/c2lua.h"
 
 /**
  * C yielable function
@@ -66,7 +70,7 @@ kfunction(lua_State *L, __UNUSED int status, lua_KContext ctx)
  *
  * It receive the Lua state and push a new string and yield to Lua.
  */
-static int
+int
 coroutine_entrypoint(lua_State *L)
 {
 	/* Send first value */
@@ -87,18 +91,26 @@ coroutine_entrypoint(lua_State *L)
  * Create a new Lua state with a custom function `coroutine_function`
  * as a
  */
-static int
-luaopen_module(lua_State *L)
+static lua_State *
+luaopen_module(lua_State *L, struct coro_pool *coros, int *ref)
 {
-	/* Create a new Lua thread (as a state) and set it as global in the
-	 * orignal state */
-	lua_State *n = lua_newthread(L);
+	/* Take a Lua thread (as a state) from the pool and set it as global
+	 * in the orignal state */
+	lua_State *n = coro_pool_acquire(coros, ref);
+
+	if (n == NULL) {
+		return NULL;
+	}
+
+	lua_pushthread(n);
+	lua_xmove(n, L, 1);
 	lua_setglobal(L, "coroutine_function");
 
 	/* Set the entry function to the new thread as entry point. */
 	lua_pushcfunction(n, coroutine_entrypoint);
+	profiler_name_cfunction(coroutine_entrypoint, "coroutine_entrypoint");
 
-	return 0;
+	return n;
 }
 
 /**
@@ -108,26 +120,26 @@ void
 create_coroutine_in_c_and_call_it_from_lua()
 {
 	/* Create a new Lua state */
-	lua_State *L = luaL_newstate();
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
 
 	/* Load all standard libraries */
 	luaL_openlibs(L);
 
 	/* Prepare C coroutine (yields) */
-	luaopen_module(L);
-
-	/* Load Lua code */
-	int error = luaL_loadstring(L,
-	    /* Prints value from entrypoint */
-	    "print(coroutine.resume(coroutine_function))\n"
-	    /* Print the 3 expected values */
-	    "print(coroutine.resume(coroutine_function))\n"
-	    "print(coroutine.resume(coroutine_function))\n"
-	    "print(coroutine.resume(coroutine_function))\n"
-	    /* Prints the last value (c function didn't yield after it) */
-	    "print(coroutine.resume(coroutine_function))\n"
-	    /* Shows error becauses coroutine didn't yield again. */
-	    "print(coroutine.resume(coroutine_function))");
+	struct coro_pool *coros = coro_pool_create(L, 1, 0);
+	int ref;
+	lua_State *co = coros ? luaopen_module(L, coros, &ref) : NULL;
+
+	if (co == NULL) {
+		fprintf(stderr, "can't create a coroutine\n");
+		coro_pool_destroy(coros);
+		allocator_close(L);
+		return;
+	}
+
+	/* Load the precompiled scripts/c2lua.lua */
+	int error = luaL_loadbufferx(L, (const char *)c2lua_bytecode,
+	    sizeof(c2lua_bytecode), "=c2lua", "b");
 
 	if (error) {
 		fprintf(stderr, "%s", lua_tostring(L, -1));
@@ -142,5 +154,10 @@ create_coroutine_in_c_and_call_it_from_lua()
 		lua_pop(L, 1); /* pop error message from the stack */
 	}
 
-	lua_close(L);
+	/* Give the thread back, it's reset and dropped with the pool */
+	lua_pushnil(L);
+	lua_setglobal(L, "coroutine_function");
+	coro_pool_release(coros, co, ref);
+	coro_pool_destroy(coros);
+	allocator_close(L);
 }
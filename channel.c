@@ -0,0 +1,1094 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "channel.h"
+#include "examples.h"
+
+#define CHANNEL_METATABLE "channel"
+#define WAITER_METATABLE  "channel.waiter"
+
+#define DEFAULT_CAPACITY 64
+
+/* Who waits on a channel, index of its waiting lists */
+#define SENDERS	  0
+#define RECEIVERS 1
+
+/* Where a waiter is listed */
+#define WAITER_IDLE   0
+#define WAITER_LISTED 1 /* on its channel, see park */
+#define WAITER_WOKEN  2 /* on its waker, until taken */
+
+/* Serialized value tags */
+#define TAG_NIL	      0
+#define TAG_FALSE     1
+#define TAG_TRUE      2
+#define TAG_INTEGER   3 /* zigzag varint */
+#define TAG_NUMBER    4 /* raw lua_Number */
+#define TAG_STRING    5 /* varint length + bytes */
+#define TAG_TABLE     6 /* key/value pairs until TAG_TABLE_END */
+#define TAG_TABLE_END 7
+
+struct message {
+	size_t len;
+	unsigned char data[];
+};
+
+struct cell {
+	atomic_size_t seq;
+	struct message *msg;
+};
+
+struct channel {
+	atomic_int refs;
+	int flags;
+	size_t mask;
+	struct cell *cells;
+
+	/* Producers and consumers positions, on their own cache lines */
+	_Alignas(64) atomic_size_t enqueue_pos;
+	_Alignas(64) atomic_size_t dequeue_pos;
+
+	/* Coroutines parked waiting for room and for a message */
+	_Alignas(64) pthread_mutex_t lock;
+	struct waiter *waiting[2];
+	atomic_int parked[2];
+
+	/* State of the first handle, other states make it shared */
+	_Atomic(lua_State *) home;
+	atomic_int shared;
+
+	/* Named channels list */
+	char *name;
+	struct channel *next;
+};
+
+/*
+ * A coroutine parked on a channel, in a userdata on its own stack. It is
+ * listed on the channel, then on its waker once woken (prev and next, under
+ * the lock of the list).
+ */
+struct waiter {
+	struct channel *ch; /* NULL once done */
+	struct channel_waker *waker;
+	int dir;
+	int where;
+	int remote; /* counted in waker->remote */
+	struct waiter *prev;
+	struct waiter *next;
+};
+
+struct channel_waker {
+	pthread_mutex_t lock;
+	atomic_int refs;       /* the owner and every waiter */
+	atomic_size_t remote;  /* waiters on shared channels */
+	channel_notify notify; /* NULL once closed */
+	void *ud;
+	struct waiter *woken;
+};
+
+/* Registry key of the waker of a state */
+static const char waker_key;
+
+static pthread_mutex_t named_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct channel *named_channels;
+
+/*
+ * Queues.
+ *
+ * MPMC is Dmitry Vyukov's bounded queue: every cell carries a sequence
+ * number telling producers and consumers whose turn it is. SPSC only needs
+ * the two positions.
+ */
+
+static int
+mpmc_enqueue(struct channel *ch, struct message *msg)
+{
+	size_t pos = atomic_load_explicit(&ch->enqueue_pos,
+	    memory_order_relaxed);
+	struct cell *cell;
+
+	for (;;) {
+		cell = &ch->cells[pos & ch->mask];
+		size_t seq = atomic_load_explicit(&cell->seq,
+		    memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+		if (dif == 0) {
+			if (atomic_compare_exchange_weak_explicit(
+				&ch->enqueue_pos, &pos, pos + 1,
+				memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (dif < 0) {
+			return -1; /* full */
+		} else {
+			pos = atomic_load_explicit(&ch->enqueue_pos,
+			    memory_order_relaxed);
+		}
+	}
+
+	cell->msg = msg;
+	atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+	return 0;
+}
+
+static struct message *
+mpmc_dequeue(struct channel *ch)
+{
+	size_t pos = atomic_load_explicit(&ch->dequeue_pos,
+	    memory_order_relaxed);
+	struct cell *cell;
+
+	for (;;) {
+		cell = &ch->cells[pos & ch->mask];
+		size_t seq = atomic_load_explicit(&cell->seq,
+		    memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (dif == 0) {
+			if (atomic_compare_exchange_weak_explicit(
+				&ch->dequeue_pos, &pos, pos + 1,
+				memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (dif < 0) {
+			return NULL; /* empty */
+		} else {
+			pos = atomic_load_explicit(&ch->dequeue_pos,
+			    memory_order_relaxed);
+		}
+	}
+
+	struct message *msg = cell->msg;
+	atomic_store_explicit(&cell->seq, pos + ch->mask + 1,
+	    memory_order_release);
+
+	return msg;
+}
+
+static int
+spsc_enqueue(struct channel *ch, struct message *msg)
+{
+	size_t tail = atomic_load_explicit(&ch->enqueue_pos,
+	    memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ch->dequeue_pos,
+	    memory_order_acquire);
+
+	if (tail - head > ch->mask) {
+		return -1; /* full */
+	}
+
+	ch->cells[tail & ch->mask].msg = msg;
+	atomic_store_explicit(&ch->enqueue_pos, tail + 1,
+	    memory_order_release);
+
+	return 0;
+}
+
+static struct message *
+spsc_dequeue(struct channel *ch)
+{
+	size_t head = atomic_load_explicit(&ch->dequeue_pos,
+	    memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ch->enqueue_pos,
+	    memory_order_acquire);
+
+	if (head == tail) {
+		return NULL; /* empty */
+	}
+
+	struct message *msg = ch->cells[head & ch->mask].msg;
+	atomic_store_explicit(&ch->dequeue_pos, head + 1,
+	    memory_order_release);
+
+	return msg;
+}
+
+static inline int
+enqueue(struct channel *ch, struct message *msg)
+{
+	if (ch->flags & CHANNEL_SPSC) {
+		return spsc_enqueue(ch, msg);
+	}
+	return mpmc_enqueue(ch, msg);
+}
+
+static inline struct message *
+dequeue(struct channel *ch)
+{
+	if (ch->flags & CHANNEL_SPSC) {
+		return spsc_dequeue(ch);
+	}
+	return mpmc_dequeue(ch);
+}
+
+/**
+ * Whether a send (SENDERS) or a receive (RECEIVERS) would go through now,
+ * without taking the turn.
+ */
+static int
+ready(struct channel *ch, int dir)
+{
+	size_t tail = atomic_load_explicit(&ch->enqueue_pos,
+	    memory_order_acquire);
+	size_t head = atomic_load_explicit(&ch->dequeue_pos,
+	    memory_order_acquire);
+
+	if (ch->flags & CHANNEL_SPSC) {
+		return dir == RECEIVERS ? head != tail
+					: tail - head <= ch->mask;
+	}
+
+	/* The cell decides, a position may be claimed but not written yet */
+	size_t pos = dir == RECEIVERS ? head : tail;
+	size_t seq = atomic_load_explicit(&ch->cells[pos & ch->mask].seq,
+	    memory_order_acquire);
+
+	return (intptr_t)seq - (intptr_t)(pos + (dir == RECEIVERS)) >= 0;
+}
+
+struct channel *
+channel_create(size_t capacity, int flags)
+{
+	struct channel *ch = calloc(1, sizeof(*ch));
+	size_t size = 2;
+
+	if (ch == NULL) {
+		return NULL;
+	}
+
+	while (size < capacity) {
+		size *= 2;
+	}
+
+	ch->cells = calloc(size, sizeof(*ch->cells));
+	if (ch->cells == NULL) {
+		free(ch);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		atomic_init(&ch->cells[i].seq, i);
+	}
+
+	atomic_init(&ch->refs, 1);
+	atomic_init(&ch->enqueue_pos, 0);
+	atomic_init(&ch->dequeue_pos, 0);
+	atomic_init(&ch->parked[SENDERS], 0);
+	atomic_init(&ch->parked[RECEIVERS], 0);
+	atomic_init(&ch->home, NULL);
+	atomic_init(&ch->shared, 0);
+	pthread_mutex_init(&ch->lock, NULL);
+	ch->flags = flags;
+	ch->mask = size - 1;
+
+	return ch;
+}
+
+void
+channel_retain(struct channel *ch)
+{
+	atomic_fetch_add_explicit(&ch->refs, 1, memory_order_relaxed);
+}
+
+void
+channel_release(struct channel *ch)
+{
+	if (atomic_fetch_sub_explicit(&ch->refs, 1, memory_order_acq_rel) !=
+	    1) {
+		return;
+	}
+
+	/* Last reference, drop the messages nobody received */
+	struct message *msg;
+	while ((msg = dequeue(ch)) != NULL) {
+		free(msg);
+	}
+
+	pthread_mutex_destroy(&ch->lock);
+	free(ch->name);
+	free(ch->cells);
+	free(ch);
+}
+
+/*
+ * Wakers.
+ *
+ * Every waiter holds a reference on its channel and on its waker, so
+ * neither goes away while another thread may reach the waiter. Locks are
+ * taken channel first, then waker; `notify` runs under both.
+ */
+
+static void
+waiter_insert(struct waiter **head, struct waiter *wt)
+{
+	wt->prev = NULL;
+	wt->next = *head;
+	if (*head != NULL) {
+		(*head)->prev = wt;
+	}
+	*head = wt;
+}
+
+static void
+waiter_remove(struct waiter **head, struct waiter *wt)
+{
+	if (wt->prev != NULL) {
+		wt->prev->next = wt->next;
+	} else {
+		*head = wt->next;
+	}
+	if (wt->next != NULL) {
+		wt->next->prev = wt->prev;
+	}
+}
+
+static void
+waker_release(struct channel_waker *w)
+{
+	if (atomic_fetch_sub_explicit(&w->refs, 1, memory_order_acq_rel) ==
+	    1) {
+		pthread_mutex_destroy(&w->lock);
+		free(w);
+	}
+}
+
+struct channel_waker *
+channel_waker_create(channel_notify notify, void *ud)
+{
+	struct channel_waker *w = calloc(1, sizeof(*w));
+
+	if (w == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	atomic_init(&w->refs, 1);
+	atomic_init(&w->remote, 0);
+	w->notify = notify;
+	w->ud = ud;
+
+	return w;
+}
+
+void
+channel_waker_close(struct channel_waker *w)
+{
+	if (w == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	w->notify = NULL;
+	pthread_mutex_unlock(&w->lock);
+	waker_release(w);
+}
+
+size_t
+channel_waker_take(struct channel_waker *w, void **keys, size_t max)
+{
+	size_t n = 0;
+
+	pthread_mutex_lock(&w->lock);
+	while (n < max && w->woken != NULL) {
+		struct waiter *wt = w->woken;
+
+		waiter_remove(&w->woken, wt);
+		wt->where = WAITER_IDLE;
+		keys[n++] = wt;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return n;
+}
+
+size_t
+channel_waker_remote(struct channel_waker *w)
+{
+	return atomic_load_explicit(&w->remote, memory_order_relaxed);
+}
+
+/**
+ * Wake every coroutine parked on `dir` of ch: its key goes to its waker,
+ * which notifies the thread driving it.
+ */
+static void
+wake(struct channel *ch, int dir)
+{
+	/* Pairs with the fence in park, see there */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&ch->parked[dir], memory_order_relaxed) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&ch->lock);
+	while (ch->waiting[dir] != NULL) {
+		struct waiter *wt = ch->waiting[dir];
+		struct channel_waker *w = wt->waker;
+
+		waiter_remove(&ch->waiting[dir], wt);
+		pthread_mutex_lock(&w->lock);
+		waiter_insert(&w->woken, wt);
+		wt->where = WAITER_WOKEN;
+		if (w->notify != NULL) {
+			w->notify(w->ud);
+		}
+		pthread_mutex_unlock(&w->lock);
+	}
+	atomic_store_explicit(&ch->parked[dir], 0, memory_order_relaxed);
+	pthread_mutex_unlock(&ch->lock);
+}
+
+/**
+ * Unlist a waiter from wherever it is and drop its references. Called by
+ * its own coroutine when resumed, or by __gc when it was abandoned.
+ */
+static void
+waiter_done(struct waiter *wt)
+{
+	if (wt == NULL || wt->ch == NULL) {
+		return;
+	}
+
+	struct channel *ch = wt->ch;
+	struct channel_waker *w = wt->waker;
+
+	pthread_mutex_lock(&ch->lock);
+	if (wt->where == WAITER_LISTED) {
+		waiter_remove(&ch->waiting[wt->dir], wt);
+		wt->where = WAITER_IDLE;
+		atomic_fetch_sub_explicit(&ch->parked[wt->dir], 1,
+		    memory_order_relaxed);
+	}
+	if (wt->remote) {
+		atomic_fetch_sub_explicit(&w->remote, 1, memory_order_relaxed);
+	}
+	int woken = wt->where == WAITER_WOKEN;
+	pthread_mutex_unlock(&ch->lock);
+
+	/* Only our own thread takes it off the waker, it stays there */
+	if (woken) {
+		pthread_mutex_lock(&w->lock);
+		waiter_remove(&w->woken, wt);
+		wt->where = WAITER_IDLE;
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	wt->ch = NULL;
+	wt->waker = NULL;
+	waker_release(w);
+	channel_release(ch);
+}
+
+/**
+ * Mark ch as shared once a handle lives in a second state: other threads
+ * may wake its waiters from then on, see channel_waker_remote.
+ */
+static void
+share(struct channel *ch)
+{
+	if (atomic_load_explicit(&ch->shared, memory_order_relaxed)) {
+		return;
+	}
+
+	pthread_mutex_lock(&ch->lock);
+	if (!atomic_load_explicit(&ch->shared, memory_order_relaxed)) {
+		atomic_store_explicit(&ch->shared, 1, memory_order_relaxed);
+		for (int dir = SENDERS; dir <= RECEIVERS; dir++) {
+			for (struct waiter *wt = ch->waiting[dir]; wt != NULL;
+			    wt = wt->next) {
+				wt->remote = 1;
+				atomic_fetch_add_explicit(&wt->waker->remote,
+				    1, memory_order_relaxed);
+			}
+		}
+	}
+	pthread_mutex_unlock(&ch->lock);
+}
+
+/*
+ * Serialization.
+ *
+ * Values are measured first (that's also where unsupported values raise
+ * errors), then written into a message of the exact size, so strings are
+ * copied only once.
+ */
+
+static inline uint64_t
+zigzag(lua_Integer n)
+{
+	return ((uint64_t)n << 1) ^ (uint64_t)(n >> 63);
+}
+
+static inline size_t
+varint_size(uint64_t v)
+{
+	size_t n = 1;
+
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+
+	return n;
+}
+
+static inline unsigned char *
+put_varint(unsigned char *p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+
+	return p;
+}
+
+static inline uint64_t
+get_varint(const unsigned char **p)
+{
+	uint64_t v = 0;
+	int shift = 0;
+
+	while (**p & 0x80) {
+		v |= (uint64_t)(*(*p)++ & 0x7f) << shift;
+		shift += 7;
+	}
+	v |= (uint64_t)(*(*p)++) << shift;
+
+	return v;
+}
+
+static size_t
+measure(lua_State *L, int idx, int depth)
+{
+	size_t len;
+
+	idx = lua_absindex(L, idx);
+
+	switch (lua_type(L, idx)) {
+	case LUA_TNIL:
+	case LUA_TBOOLEAN:
+		return 1;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, idx)) {
+			return 1 + varint_size(zigzag(lua_tointeger(L, idx)));
+		}
+		return 1 + sizeof(lua_Number);
+	case LUA_TSTRING:
+		lua_tolstring(L, idx, &len);
+		return 1 + varint_size(len) + len;
+	case LUA_TTABLE:
+		if (depth >= CHANNEL_MAX_DEPTH) {
+			luaL_error(L, "table nested too deep to send");
+		}
+		luaL_checkstack(L, 3, "table nested too deep to send");
+
+		len = 2; /* TAG_TABLE and TAG_TABLE_END */
+		lua_pushnil(L);
+		while (lua_next(L, idx) != 0) {
+			len += measure(L, -2, depth + 1);
+			len += measure(L, -1, depth + 1);
+			lua_pop(L, 1);
+		}
+		return len;
+	default:
+		return luaL_error(L, "can't send a %s value",
+		    luaL_typename(L, idx));
+	}
+}
+
+static unsigned char *
+write_value(lua_State *L, int idx, unsigned char *p)
+{
+	const char *s;
+	size_t len;
+
+	idx = lua_absindex(L, idx);
+
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+		*p++ = lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE;
+		break;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, idx)) {
+			*p++ = TAG_INTEGER;
+			p = put_varint(p, zigzag(lua_tointeger(L, idx)));
+		} else {
+			lua_Number n = lua_tonumber(L, idx);
+			*p++ = TAG_NUMBER;
+			memcpy(p, &n, sizeof(n));
+			p += sizeof(n);
+		}
+		break;
+	case LUA_TSTRING:
+		s = lua_tolstring(L, idx, &len);
+		*p++ = TAG_STRING;
+		p = put_varint(p, len);
+		memcpy(p, s, len);
+		p += len;
+		break;
+	case LUA_TTABLE:
+		luaL_checkstack(L, 3, "table nested too deep to send");
+		*p++ = TAG_TABLE;
+		lua_pushnil(L);
+		while (lua_next(L, idx) != 0) {
+			p = write_value(L, -2, p);
+			p = write_value(L, -1, p);
+			lua_pop(L, 1);
+		}
+		*p++ = TAG_TABLE_END;
+		break;
+	default:
+		*p++ = TAG_NIL;
+		break;
+	}
+
+	return p;
+}
+
+static void
+read_value(lua_State *L, const unsigned char **p)
+{
+	uint64_t u;
+	lua_Number n;
+
+	switch (*(*p)++) {
+	case TAG_FALSE:
+		lua_pushboolean(L, 0);
+		break;
+	case TAG_TRUE:
+		lua_pushboolean(L, 1);
+		break;
+	case TAG_INTEGER:
+		u = get_varint(p);
+		lua_pushinteger(L, (lua_Integer)((u >> 1) ^ -(u & 1)));
+		break;
+	case TAG_NUMBER:
+		memcpy(&n, *p, sizeof(n));
+		*p += sizeof(n);
+		lua_pushnumber(L, n);
+		break;
+	case TAG_STRING:
+		u = get_varint(p);
+		lua_pushlstring(L, (const char *)*p, u);
+		*p += u;
+		break;
+	case TAG_TABLE:
+		luaL_checkstack(L, 3, "table nested too deep to receive");
+		lua_newtable(L);
+		while (**p != TAG_TABLE_END) {
+			read_value(L, p);
+			read_value(L, p);
+			lua_rawset(L, -3);
+		}
+		(*p)++;
+		break;
+	default:
+		lua_pushnil(L);
+		break;
+	}
+}
+
+static struct message *
+encode(lua_State *L, int idx)
+{
+	size_t len = measure(L, idx, 0);
+	struct message *msg = malloc(sizeof(*msg) + len);
+
+	if (msg == NULL) {
+		luaL_error(L, "not enough memory");
+		return NULL;
+	}
+
+	msg->len = len;
+	write_value(L, idx, msg->data);
+
+	return msg;
+}
+
+/*
+ * Lua library
+ */
+
+void
+channel_push(lua_State *L, struct channel *ch)
+{
+	struct channel **ud = lua_newuserdatauv(L, sizeof(*ud), 0);
+
+	channel_retain(ch);
+	*ud = ch;
+	luaL_setmetatable(L, CHANNEL_METATABLE);
+
+	/* States are told apart by their main thread */
+	lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+	lua_State *state = lua_tothread(L, -1);
+	lua_State *home = NULL;
+	lua_pop(L, 1);
+
+	if (!atomic_compare_exchange_strong(&ch->home, &home, state) &&
+	    home != state) {
+		share(ch);
+	}
+}
+
+void
+channel_set_waker(lua_State *L, struct channel_waker *w)
+{
+	if (w != NULL) {
+		lua_pushlightuserdata(L, w);
+	} else {
+		lua_pushnil(L);
+	}
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &waker_key);
+}
+
+struct channel *
+channel_check(lua_State *L, int idx)
+{
+	return *(struct channel **)luaL_checkudata(L, idx, CHANNEL_METATABLE);
+}
+
+static int
+try_send(lua_State *L, struct channel *ch)
+{
+	struct message *msg = encode(L, 2);
+
+	if (enqueue(ch, msg) != 0) {
+		free(msg);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+try_receive(lua_State *L, struct channel *ch)
+{
+	struct message *msg = dequeue(ch);
+
+	if (msg == NULL) {
+		return 0;
+	}
+
+	const unsigned char *p = msg->data;
+	read_value(L, &p);
+	free(msg);
+
+	return 1;
+}
+
+/**
+ * List the calling coroutine as waiting on `dir` of ch and push its waiter,
+ * followed by the ("wait", key) to yield. Returns 0 instead, with nothing
+ * pushed, if ch became ready while it was being listed.
+ */
+static int
+park(lua_State *L, struct channel *ch, int dir)
+{
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &waker_key);
+	struct channel_waker *w = lua_touserdata(L, -1);
+	lua_pop(L, 1);
+
+	if (w == NULL) {
+		/* Nothing will wake us, the resumer decides when to retry */
+		lua_pushnil(L);
+		lua_pushliteral(L, "wait");
+		lua_pushlightuserdata(L, &ch->waiting[dir]);
+		return 1;
+	}
+
+	struct waiter *wt = lua_newuserdatauv(L, sizeof(*wt), 0);
+	memset(wt, 0, sizeof(*wt));
+	luaL_setmetatable(L, WAITER_METATABLE);
+
+	channel_retain(ch);
+	atomic_fetch_add_explicit(&w->refs, 1, memory_order_relaxed);
+	wt->ch = ch;
+	wt->waker = w;
+	wt->dir = dir;
+
+	pthread_mutex_lock(&ch->lock);
+	waiter_insert(&ch->waiting[dir], wt);
+	wt->where = WAITER_LISTED;
+	wt->remote = atomic_load_explicit(&ch->shared, memory_order_relaxed);
+	if (wt->remote) {
+		atomic_fetch_add_explicit(&w->remote, 1, memory_order_relaxed);
+	}
+	atomic_fetch_add_explicit(&ch->parked[dir], 1, memory_order_relaxed);
+	pthread_mutex_unlock(&ch->lock);
+
+	/*
+	 * Either the peer that made ch ready sees us listed in wake, or we see
+	 * what it did here: both sides fence between their store and load.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (ready(ch, dir)) {
+		waiter_done(wt);
+		lua_pop(L, 1);
+		return 0;
+	}
+
+	lua_pushliteral(L, "wait");
+	lua_pushlightuserdata(L, wt);
+
+	return 1;
+}
+
+static int
+ch_send_k(lua_State *L, __UNUSED int status, lua_KContext ctx)
+{
+	struct channel *ch = channel_check(L, 1);
+
+	if (ctx) {
+		waiter_done(lua_touserdata(L, 3));
+	}
+	lua_settop(L, 2); /* drop the waiter and whatever the resume passed */
+
+	while (!try_send(L, ch)) {
+		if (!lua_isyieldable(L)) {
+			return luaL_error(L, "channel is full");
+		}
+
+		/* Like kfunction in c2lua.c: try again when resumed */
+		if (park(L, ch, SENDERS)) {
+			return lua_yieldk(L, 2, 1, ch_send_k);
+		}
+	}
+
+	wake(ch, RECEIVERS);
+	lua_pushboolean(L, 1);
+
+	return 1;
+}
+
+static int
+ch_send(lua_State *L)
+{
+	luaL_checkany(L, 2);
+	return ch_send_k(L, LUA_OK, 0);
+}
+
+static int
+ch_receive_k(lua_State *L, __UNUSED int status, lua_KContext ctx)
+{
+	struct channel *ch = channel_check(L, 1);
+
+	if (ctx) {
+		waiter_done(lua_touserdata(L, 2));
+	}
+	lua_settop(L, 1);
+
+	while (!try_receive(L, ch)) {
+		if (!lua_isyieldable(L)) {
+			return luaL_error(L, "channel is empty");
+		}
+		if (park(L, ch, RECEIVERS)) {
+			return lua_yieldk(L, 2, 1, ch_receive_k);
+		}
+	}
+
+	wake(ch, SENDERS);
+
+	return 1;
+}
+
+static int
+ch_receive(lua_State *L)
+{
+	return ch_receive_k(L, LUA_OK, 0);
+}
+
+static int
+ch_try_send(lua_State *L)
+{
+	struct channel *ch = channel_check(L, 1);
+
+	luaL_checkany(L, 2);
+	lua_settop(L, 2);
+	if (!try_send(L, ch)) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+
+	wake(ch, RECEIVERS);
+	lua_pushboolean(L, 1);
+
+	return 1;
+}
+
+static int
+ch_try_receive(lua_State *L)
+{
+	struct channel *ch = channel_check(L, 1);
+
+	lua_pushboolean(L, 1);
+	if (!try_receive(L, ch)) {
+		lua_pushboolean(L, 0);
+		return 1;
+	}
+
+	wake(ch, SENDERS);
+
+	return 2;
+}
+
+static int
+ch_gc(lua_State *L)
+{
+	struct channel **ud = luaL_checkudata(L, 1, CHANNEL_METATABLE);
+
+	if (*ud != NULL) {
+		channel_release(*ud);
+		*ud = NULL;
+	}
+
+	return 0;
+}
+
+static int
+waiter_gc(lua_State *L)
+{
+	waiter_done(luaL_checkudata(L, 1, WAITER_METATABLE));
+
+	return 0;
+}
+
+static int
+channel_new(lua_State *L)
+{
+	lua_Integer capacity = luaL_optinteger(L, 1, DEFAULT_CAPACITY);
+	const char *kind = luaL_optstring(L, 2, "mpmc");
+	int flags = strcmp(kind, "spsc") == 0 ? CHANNEL_SPSC : CHANNEL_MPMC;
+
+	luaL_argcheck(L, capacity > 0, 1, "capacity must be positive");
+
+	struct channel *ch = channel_create(capacity, flags);
+	if (ch == NULL) {
+		return luaL_error(L, "not enough memory");
+	}
+
+	channel_push(L, ch);
+	channel_release(ch);
+
+	return 1;
+}
+
+static int
+channel_open(lua_State *L)
+{
+	const char *name = luaL_checkstring(L, 1);
+	lua_Integer capacity = luaL_optinteger(L, 2, DEFAULT_CAPACITY);
+	struct channel *ch;
+
+	luaL_argcheck(L, capacity > 0, 2, "capacity must be positive");
+
+	pthread_mutex_lock(&named_lock);
+	for (ch = named_channels; ch != NULL; ch = ch->next) {
+		if (strcmp(ch->name, name) == 0) {
+			break;
+		}
+	}
+
+	/* The list keeps its own reference, named channels live forever */
+	if (ch == NULL && (ch = channel_create(capacity, 0)) != NULL) {
+		if ((ch->name = strdup(name)) == NULL) {
+			channel_release(ch);
+			ch = NULL;
+		} else {
+			atomic_store_explicit(&ch->shared, 1,
+			    memory_order_relaxed);
+			ch->next = named_channels;
+			named_channels = ch;
+		}
+	}
+	if (ch != NULL) {
+		channel_retain(ch);
+	}
+	pthread_mutex_unlock(&named_lock);
+
+	if (ch == NULL) {
+		return luaL_error(L, "not enough memory");
+	}
+
+	channel_push(L, ch);
+	channel_release(ch);
+
+	return 1;
+}
+
+static const luaL_Reg channel_methods[] = {
+	{ "send", ch_send },
+	{ "receive", ch_receive },
+	{ "try_send", ch_try_send },
+	{ "try_receive", ch_try_receive },
+	{ NULL, NULL },
+};
+
+static const luaL_Reg channel_funcs[] = {
+	{ "new", channel_new },
+	{ "open", channel_open },
+	{ NULL, NULL },
+};
+
+int
+luaopen_channel(lua_State *L)
+{
+	if (luaL_newmetatable(L, CHANNEL_METATABLE)) {
+		luaL_newlib(L, channel_methods);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, ch_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_pop(L, 1);
+
+	/* Abandoned coroutines let go of their channel when collected */
+	if (luaL_newmetatable(L, WAITER_METATABLE)) {
+		lua_pushcfunction(L, waiter_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_pop(L, 1);
+
+	luaL_newlib(L, channel_funcs);
+
+	return 1;
+}
@@ -0,0 +1,124 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+/* Channel flavours: any number of senders and receivers, or exactly one. */
+#define CHANNEL_MPMC 0x0
+#define CHANNEL_SPSC 0x1
+
+/* Deepest table nesting a message can carry. */
+#define CHANNEL_MAX_DEPTH 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Bounded lock-free channel between Lua states, possibly running on
+ * different threads. Values (nil, booleans, numbers, strings and nested
+ * tables of them) are serialized into one compact binary message; strings
+ * are copied once into the message and pushed from it on receive.
+ */
+struct channel;
+
+/* Create a channel holding up to `capacity` messages (rounded up to 2^n). */
+struct channel *channel_create(size_t capacity, int flags);
+
+/* Reference counting, the channel is freed with its last reference. */
+void channel_retain(struct channel *ch);
+void channel_release(struct channel *ch);
+
+/* Push a Lua handle of the channel (takes its own reference). */
+void channel_push(lua_State *L, struct channel *ch);
+
+/* Return the channel handle at `idx` or raise an error. */
+struct channel *channel_check(lua_State *L, int idx);
+
+/*
+ * Open the `channel` library:
+ *
+ *   channel.new([capacity [, "spsc"]])   anonymous channel
+ *   channel.open(name [, capacity])      process wide named channel
+ *   ch:send(v)       blocks (yields) while full
+ *   ch:receive()     blocks (yields) while empty
+ *   ch:try_send(v)   returns false if full
+ *   ch:try_receive() returns false if empty, true and the value otherwise
+ *
+ * Blocking calls list the coroutine on the channel and yield ("wait", key)
+ * to the scheduler or worker driving it: the next send or receive, from
+ * any thread, hands the key back through the waker of that state (see
+ * below). Without a waker the resumer just decides when to try again.
+ * Outside of a coroutine blocking calls raise an error instead.
+ */
+int luaopen_channel(lua_State *L);
+
+/*
+ * Wakes the coroutines of a state blocked on channels. The thread driving
+ * them (a scheduler, a pool worker) creates one and installs it with
+ * channel_set_waker. Waking a coroutine queues its key on the waker and
+ * calls `notify(ud)`, from any thread and with channel locks held: it must
+ * only signal the owner (an eventfd, a condition variable), which then
+ * takes the keys and resumes the coroutines that yielded them.
+ */
+struct channel_waker;
+
+typedef void (*channel_notify)(void *ud);
+
+/* Create a waker calling `notify(ud)` whenever a key is queued. */
+struct channel_waker *channel_waker_create(channel_notify notify, void *ud);
+
+/*
+ * Stop calling `notify`, it isn't running anymore once this returns. The
+ * waker itself is freed when the last coroutine parked on it lets go.
+ */
+void channel_waker_close(struct channel_waker *w);
+
+/* Park the blocked coroutines of L on w, NULL removes it. */
+void channel_set_waker(lua_State *L, struct channel_waker *w);
+
+/* Move up to `max` queued keys to `keys`, returns how many. */
+size_t channel_waker_take(struct channel_waker *w, void **keys, size_t max);
+
+/*
+ * Coroutines parked through w on channels other states can reach (named,
+ * or pushed to a second state): another thread may still wake them.
+ */
+size_t channel_waker_remote(struct channel_waker *w);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CHANNEL_H */
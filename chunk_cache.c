@@ -0,0 +1,368 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "chunk_cache.h"
+#include "examples.h"
+
+/* Capacity of the cache returned by chunk_cache_shared. */
+#define SHARED_CAPACITY 128
+
+struct chunk {
+	uint64_t hash;
+	char *src; /* source and chunk name are the key */
+	size_t len;
+	char *name;
+	char *code; /* lua_dump output */
+	size_t code_len;
+
+	struct chunk *hnext; /* hash bucket chain */
+	struct chunk *prev;  /* LRU list, most recent first */
+	struct chunk *next;
+};
+
+struct chunk_cache {
+	pthread_mutex_t lock;
+	size_t capacity;
+	size_t mask; /* buckets - 1 */
+	struct chunk **buckets;
+	struct chunk *head; /* most recently used */
+	struct chunk *tail; /* least recently used */
+	struct chunk_cache_stats stats;
+};
+
+/* Output of lua_dump, grown as needed. */
+struct dump_buffer {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+/**
+ * Hash the source a word at a time, it's only used to pick the bucket and
+ * to skip full comparisons.
+ */
+static uint64_t
+hash_source(const char *src, size_t len)
+{
+	const uint64_t mul = 0x9e3779b97f4a7c15ull;
+	uint64_t h = len * mul;
+	uint64_t w;
+
+	while (len >= sizeof(w)) {
+		memcpy(&w, src, sizeof(w));
+		h = (h ^ w) * mul;
+		h ^= h >> 32;
+		src += sizeof(w);
+		len -= sizeof(w);
+	}
+
+	w = 0;
+	memcpy(&w, src, len);
+	h = (h ^ w) * mul;
+	h ^= h >> 29;
+
+	return h;
+}
+
+static void
+chunk_free(struct chunk *c)
+{
+	free(c->src);
+	free(c->name);
+	free(c->code);
+	free(c);
+}
+
+static void
+lru_unlink(struct chunk_cache *cache, struct chunk *c)
+{
+	if (c->prev != NULL) {
+		c->prev->next = c->next;
+	} else {
+		cache->head = c->next;
+	}
+
+	if (c->next != NULL) {
+		c->next->prev = c->prev;
+	} else {
+		cache->tail = c->prev;
+	}
+}
+
+static void
+lru_push_front(struct chunk_cache *cache, struct chunk *c)
+{
+	c->prev = NULL;
+	c->next = cache->head;
+	if (cache->head != NULL) {
+		cache->head->prev = c;
+	} else {
+		cache->tail = c;
+	}
+	cache->head = c;
+}
+
+static struct chunk *
+lookup(struct chunk_cache *cache, uint64_t hash, const char *src, size_t len,
+    const char *name)
+{
+	struct chunk *c = cache->buckets[hash & cache->mask];
+
+	for (; c != NULL; c = c->hnext) {
+		if (c->hash == hash && c->len == len &&
+		    memcmp(c->src, src, len) == 0 &&
+		    strcmp(c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+evict(struct chunk_cache *cache, struct chunk *c)
+{
+	struct chunk **link = &cache->buckets[c->hash & cache->mask];
+
+	while (*link != c) {
+		link = &(*link)->hnext;
+	}
+	*link = c->hnext;
+
+	lru_unlink(cache, c);
+	chunk_free(c);
+
+	cache->stats.entries--;
+}
+
+static int
+dump_writer(__UNUSED lua_State *L, const void *p, size_t sz, void *ud)
+{
+	struct dump_buffer *b = ud;
+
+	if (b->len + sz > b->size) {
+		size_t size = b->size ? b->size * 2 : 1024;
+
+		while (size < b->len + sz) {
+			size *= 2;
+		}
+
+		char *data = realloc(b->data, size);
+		if (data == NULL) {
+			return 1; /* stops lua_dump */
+		}
+		b->data = data;
+		b->size = size;
+	}
+
+	memcpy(b->data + b->len, p, sz);
+	b->len += sz;
+
+	return 0;
+}
+
+/**
+ * Build a cache entry from the function on top of the stack.
+ */
+static struct chunk *
+chunk_new(lua_State *L, uint64_t hash, const char *src, size_t len,
+    const char *name)
+{
+	struct dump_buffer b = { 0 };
+	struct chunk *c = calloc(1, sizeof(*c));
+
+	if (c == NULL) {
+		return NULL;
+	}
+
+	c->hash = hash;
+	c->len = len;
+	c->src = malloc(len > 0 ? len : 1);
+	c->name = strdup(name);
+
+	if (c->src == NULL || c->name == NULL ||
+	    lua_dump(L, dump_writer, &b, 0) != 0) {
+		free(b.data);
+		chunk_free(c);
+		return NULL;
+	}
+
+	memcpy(c->src, src, len);
+	c->code = b.data;
+	c->code_len = b.len;
+
+	return c;
+}
+
+struct chunk_cache *
+chunk_cache_create(size_t capacity)
+{
+	struct chunk_cache *cache = calloc(1, sizeof(*cache));
+	size_t buckets = 16;
+
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	/* Keep the load factor under 0.5 */
+	while (buckets < capacity * 2) {
+		buckets *= 2;
+	}
+
+	cache->buckets = calloc(buckets, sizeof(*cache->buckets));
+	if (cache->buckets == NULL) {
+		free(cache);
+		return NULL;
+	}
+
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->capacity = capacity > 0 ? capacity : 1;
+	cache->mask = buckets - 1;
+
+	return cache;
+}
+
+void
+chunk_cache_destroy(struct chunk_cache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	struct chunk *c = cache->head;
+	while (c != NULL) {
+		struct chunk *next = c->next;
+		chunk_free(c);
+		c = next;
+	}
+
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
+
+static struct chunk_cache *shared_cache;
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+static void
+shared_init(void)
+{
+	shared_cache = chunk_cache_create(SHARED_CAPACITY);
+}
+
+struct chunk_cache *
+chunk_cache_shared(void)
+{
+	pthread_once(&shared_once, shared_init);
+	return shared_cache;
+}
+
+int
+chunk_cache_load(struct chunk_cache *cache, lua_State *L, const char *src,
+    size_t len, const char *name)
+{
+	uint64_t hash = hash_source(src, len);
+	int status;
+
+	if (name == NULL) {
+		name = "?";
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	struct chunk *c = lookup(cache, hash, src, len, name);
+	if (c != NULL) {
+		cache->stats.hits++;
+		lru_unlink(cache, c);
+		lru_push_front(cache, c);
+
+		/* Loading bytecode is cheap, do it while the entry is pinned */
+		status = luaL_loadbufferx(L, c->code, c->code_len, name, "b");
+		pthread_mutex_unlock(&cache->lock);
+		return status;
+	}
+	cache->stats.misses++;
+	pthread_mutex_unlock(&cache->lock);
+
+	/* Compile outside of the lock */
+	status = luaL_loadbufferx(L, src, len, name, NULL);
+	if (status != LUA_OK) {
+		return status;
+	}
+
+	c = chunk_new(L, hash, src, len, name);
+	if (c == NULL) {
+		return LUA_OK; /* the chunk is loaded, it just isn't cached */
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	if (lookup(cache, hash, src, len, name) != NULL) {
+		/* Another thread got here first */
+		pthread_mutex_unlock(&cache->lock);
+		chunk_free(c);
+		return LUA_OK;
+	}
+
+	if (cache->stats.entries >= cache->capacity) {
+		evict(cache, cache->tail);
+		cache->stats.evictions++;
+	}
+
+	struct chunk **bucket = &cache->buckets[hash & cache->mask];
+	c->hnext = *bucket;
+	*bucket = c;
+	lru_push_front(cache, c);
+	cache->stats.entries++;
+	pthread_mutex_unlock(&cache->lock);
+
+	return LUA_OK;
+}
+
+int
+chunk_cache_loadstring(struct chunk_cache *cache, lua_State *L,
+    const char *src)
+{
+	return chunk_cache_load(cache, L, src, strlen(src), src);
+}
+
+void
+chunk_cache_stats(struct chunk_cache *cache, struct chunk_cache_stats *stats)
+{
+	pthread_mutex_lock(&cache->lock);
+	*stats = cache->stats;
+	pthread_mutex_unlock(&cache->lock);
+}
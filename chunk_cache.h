@@ -0,0 +1,90 @@
+#ifndef CHUNK_CACHE_H
+#define CHUNK_CACHE_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+struct chunk_cache;
+
+/* Cache counters, see chunk_cache_stats. */
+struct chunk_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t entries;
+};
+
+/*
+ * Create a cache of compiled chunks holding at most `capacity` entries,
+ * the least recently used one is evicted when it's full.
+ */
+struct chunk_cache *chunk_cache_create(size_t capacity);
+
+/* Free the cache and every stored chunk. */
+void chunk_cache_destroy(struct chunk_cache *cache);
+
+/*
+ * Process wide cache shared by the examples, created on first use. NULL
+ * if it couldn't be allocated, callers load without caching then.
+ */
+struct chunk_cache *chunk_cache_shared(void);
+
+/*
+ * Drop-in replacement of luaL_loadbuffer: push the compiled chunk for
+ * `src` on the stack of L. The chunk is compiled only the first time, later
+ * calls with the same source and name load the cached bytecode instead.
+ * Returns the lua_load status, errors are never cached.
+ *
+ * The cache is safe to use from several threads and states at once.
+ */
+int chunk_cache_load(struct chunk_cache *cache, lua_State *L, const char *src,
+    size_t len, const char *name);
+
+/* Same as chunk_cache_load with a NUL terminated source. */
+int chunk_cache_loadstring(struct chunk_cache *cache, lua_State *L,
+    const char *src);
+
+/* Copy the cache counters. */
+void chunk_cache_stats(struct chunk_cache *cache,
+    struct chunk_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CHUNK_CACHE_H */
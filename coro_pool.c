@@ -0,0 +1,164 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+
+#include "coro_pool.h"
+
+/* lua_resetthread was replaced by lua_closethread in Lua 5.4.6 */
+#if LUA_VERSION_RELEASE_NUM >= 50406
+#define reset_thread(co, from) lua_closethread(co, from)
+#else
+#define reset_thread(co, from) lua_resetthread(co)
+#endif
+
+struct coro {
+	lua_State *co;
+	int ref;
+};
+
+struct coro_pool {
+	lua_State *L;
+	int stack_slots;
+
+	/* Idle threads, used as a stack to reuse the warmest one */
+	struct coro *idle;
+	size_t nidle;
+	size_t max_idle;
+
+	struct coro_pool_stats stats;
+};
+
+struct coro_pool *
+coro_pool_create(lua_State *L, size_t max_idle, int stack_slots)
+{
+	struct coro_pool *pool = calloc(1, sizeof(*pool));
+
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	if (max_idle > 0) {
+		pool->idle = malloc(max_idle * sizeof(*pool->idle));
+		if (pool->idle == NULL) {
+			free(pool);
+			return NULL;
+		}
+	}
+
+	pool->L = L;
+	pool->max_idle = max_idle;
+	pool->stack_slots = stack_slots;
+
+	return pool;
+}
+
+void
+coro_pool_destroy(struct coro_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < pool->nidle; i++) {
+		luaL_unref(pool->L, LUA_REGISTRYINDEX, pool->idle[i].ref);
+	}
+
+	free(pool->idle);
+	free(pool);
+}
+
+lua_State *
+coro_pool_acquire(struct coro_pool *pool, int *ref)
+{
+	if (pool->nidle > 0) {
+		struct coro *c = &pool->idle[--pool->nidle];
+
+		pool->stats.reused++;
+		*ref = c->ref;
+		return c->co;
+	}
+
+	if (!lua_checkstack(pool->L, 1)) {
+		return NULL;
+	}
+
+	lua_State *co = lua_newthread(pool->L);
+
+	if (pool->stack_slots > 0 && !lua_checkstack(co, pool->stack_slots)) {
+		lua_pop(pool->L, 1);
+		return NULL;
+	}
+
+	*ref = luaL_ref(pool->L, LUA_REGISTRYINDEX);
+	pool->stats.created++;
+
+	return co;
+}
+
+void
+coro_pool_release(struct coro_pool *pool, lua_State *co, int ref)
+{
+	if (pool->nidle == pool->max_idle) {
+		/* Let the collector have it */
+		luaL_unref(pool->L, LUA_REGISTRYINDEX, ref);
+		pool->stats.discarded++;
+		return;
+	}
+
+	/*
+	 * Unwind whatever is left (a suspended call, an error) and close its
+	 * to-be-closed variables, an error raised while closing is dropped
+	 * with the rest of the stack.
+	 */
+	reset_thread(co, pool->L);
+	lua_settop(co, 0);
+
+	/* The reset may shrink the stack, grow it back */
+	if (pool->stack_slots > 0 && !lua_checkstack(co, pool->stack_slots)) {
+		luaL_unref(pool->L, LUA_REGISTRYINDEX, ref);
+		pool->stats.discarded++;
+		return;
+	}
+
+	pool->idle[pool->nidle].co = co;
+	pool->idle[pool->nidle].ref = ref;
+	pool->nidle++;
+	pool->stats.resets++;
+}
+
+void
+coro_pool_stats(struct coro_pool *pool, struct coro_pool_stats *stats)
+{
+	*stats = pool->stats;
+	stats->idle = pool->nidle;
+}
@@ -0,0 +1,94 @@
+#ifndef CORO_POOL_H
+#define CORO_POOL_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Coroutine pool.
+ *
+ * Keeps finished Lua threads of one state around instead of leaving them to
+ * the garbage collector. Every thread handed out is pinned with a registry
+ * reference; on release it is reset (closing its pending to-be-closed
+ * variables) and kept for the next acquire, so steady workloads stop
+ * creating and collecting threads.
+ */
+
+struct coro_pool;
+
+/* Pool counters, see coro_pool_stats. */
+struct coro_pool_stats {
+	uint64_t created;   /* threads built with lua_newthread */
+	uint64_t reused;    /* acquires served by an idle thread */
+	uint64_t resets;    /* threads reset and kept in the pool */
+	uint64_t discarded; /* threads unpinned on release (pool full) */
+	size_t idle;	    /* threads waiting in the pool */
+};
+
+/*
+ * Create a pool for the state L keeping up to `max_idle` threads. Stacks
+ * are grown to at least `stack_slots` free slots (0 for Lua's default)
+ * when a thread is created and after every reset. The pool must be
+ * destroyed before L is closed.
+ */
+struct coro_pool *coro_pool_create(lua_State *L, size_t max_idle,
+    int stack_slots);
+
+/* Unpin every idle thread and free the pool. */
+void coro_pool_destroy(struct coro_pool *pool);
+
+/*
+ * Take an empty thread, pinned by the registry reference stored in `ref`.
+ * Returns NULL if it can't be created.
+ */
+lua_State *coro_pool_acquire(struct coro_pool *pool, int *ref);
+
+/*
+ * Give back a thread returned by coro_pool_acquire, whatever its status:
+ * dead, errored or still suspended.
+ */
+void coro_pool_release(struct coro_pool *pool, lua_State *co, int ref);
+
+/* Copy the pool counters. */
+void coro_pool_stats(struct coro_pool *pool, struct coro_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CORO_POOL_H */
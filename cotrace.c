@@ -0,0 +1,955 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "cotrace.h"
+#include "examples.h"
+
+/*
+ * Log-linear buckets: values below 16 have their own, then every power of
+ * two is split in 16. Bucket i >= 32 starts at (i - 16 * s) << s with
+ * s = i / 16 - 1.
+ */
+#define SUB_BITS     4
+#define SUB_COUNT    (1 << SUB_BITS)
+#define HIST_BUCKETS ((64 - SUB_BITS + 1) * SUB_COUNT)
+
+typedef atomic_uint_least64_t counter;
+
+struct histogram {
+	counter counts[HIST_BUCKETS];
+	counter total; /* sum of the values */
+	counter max;
+};
+
+/* Key of a slot freed when its coroutine ended, no lua_State is there */
+#define TOMBSTONE ((uintptr_t)1)
+
+/* One coroutine seen by one OS thread */
+struct coro_trace {
+	atomic_uintptr_t co; /* 0 for a never used slot, or TOMBSTONE */
+	counter resumes;
+	counter yields;
+	counter run_ns;
+	counter suspended_ns;
+	counter yielded_at; /* ns, 0 unless suspended in a yield */
+};
+
+/*
+ * Buffers of one OS thread, only written by it. They're linked for good
+ * in `threads` and handed over to a new thread once the owner exits.
+ */
+struct thread_trace {
+	struct thread_trace *next;
+	atomic_int in_use;
+	atomic_uint epoch; /* reset the counters belong to */
+	counter resumes;
+	counter yields;
+	counter errors;
+	counter dropped;
+	size_t ncoros; /* used slots, tombstones included */
+	size_t ndead;  /* tombstones */
+	unsigned compactions;
+	struct histogram run;
+	struct histogram suspended;
+	struct coro_trace coros[COTRACE_MAX_COROUTINES];
+};
+
+static atomic_int enabled;
+static atomic_uint epoch = 1; /* bumped by cotrace_reset */
+static _Atomic(struct thread_trace *) threads;
+
+static _Thread_local struct thread_trace *self;
+static pthread_key_t self_key;
+static pthread_once_t self_once = PTHREAD_ONCE_INIT;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Single writer, a plain load and store is enough */
+static void
+add(counter *c, uint64_t n)
+{
+	atomic_store_explicit(c,
+	    atomic_load_explicit(c, memory_order_relaxed) + n,
+	    memory_order_relaxed);
+}
+
+static void
+set(counter *c, uint64_t v)
+{
+	atomic_store_explicit(c, v, memory_order_relaxed);
+}
+
+static uint64_t
+get(counter *c)
+{
+	return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+static int
+bucket_of(uint64_t v)
+{
+	if (v < SUB_COUNT) {
+		return (int)v;
+	}
+
+	int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+
+	return (shift << SUB_BITS) + (int)(v >> shift);
+}
+
+static uint64_t
+bucket_lower(int i)
+{
+	if (i < 2 * SUB_COUNT) {
+		return i;
+	}
+
+	int shift = (i >> SUB_BITS) - 1;
+
+	return (uint64_t)(i - (shift << SUB_BITS)) << shift;
+}
+
+/* Highest value of bucket i */
+static uint64_t
+bucket_upper(int i)
+{
+	return i + 1 < HIST_BUCKETS ? bucket_lower(i + 1) - 1 : UINT64_MAX;
+}
+
+static void
+record(struct histogram *h, uint64_t v)
+{
+	add(&h->counts[bucket_of(v)], 1);
+	add(&h->total, v);
+	if (v > get(&h->max)) {
+		set(&h->max, v);
+	}
+}
+
+/*
+ * Per thread buffers
+ */
+
+static void
+release_self(void *t)
+{
+	atomic_store_explicit(&((struct thread_trace *)t)->in_use, 0,
+	    memory_order_release);
+}
+
+static void
+create_key(void)
+{
+	pthread_key_create(&self_key, release_self);
+}
+
+static void
+clear_histogram(struct histogram *h)
+{
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		set(&h->counts[i], 0);
+	}
+	set(&h->total, 0);
+	set(&h->max, 0);
+}
+
+static void
+clear_thread(struct thread_trace *t, unsigned e)
+{
+	set(&t->resumes, 0);
+	set(&t->yields, 0);
+	set(&t->errors, 0);
+	set(&t->dropped, 0);
+	clear_histogram(&t->run);
+	clear_histogram(&t->suspended);
+	for (size_t i = 0; i < COTRACE_MAX_COROUTINES; i++) {
+		atomic_store_explicit(&t->coros[i].co, 0,
+		    memory_order_relaxed);
+	}
+	t->ncoros = 0;
+	t->ndead = 0;
+	atomic_store_explicit(&t->epoch, e, memory_order_release);
+}
+
+/* Buffers of an exited thread, or new ones */
+static struct thread_trace *
+claim(void)
+{
+	struct thread_trace *t;
+
+	for (t = atomic_load_explicit(&threads, memory_order_acquire);
+	     t != NULL; t = t->next) {
+		int idle = 0;
+
+		if (atomic_compare_exchange_strong(&t->in_use, &idle, 1)) {
+			break;
+		}
+	}
+
+	if (t == NULL) {
+		if ((t = calloc(1, sizeof(*t))) == NULL) {
+			return NULL;
+		}
+		atomic_init(&t->in_use, 1);
+
+		struct thread_trace *head = atomic_load_explicit(&threads,
+		    memory_order_relaxed);
+
+		do {
+			t->next = head;
+		} while (!atomic_compare_exchange_weak_explicit(&threads,
+		    &head, t, memory_order_release, memory_order_relaxed));
+	}
+
+	pthread_once(&self_once, create_key);
+	pthread_setspecific(self_key, t);
+
+	return t;
+}
+
+/* Buffers of the calling thread, cleared if a reset happened */
+static struct thread_trace *
+current_thread(void)
+{
+	if (self == NULL && (self = claim()) == NULL) {
+		return NULL;
+	}
+
+	unsigned e = atomic_load_explicit(&epoch, memory_order_acquire);
+
+	if (atomic_load_explicit(&self->epoch, memory_order_relaxed) != e) {
+		clear_thread(self, e);
+	}
+
+	return self;
+}
+
+static void
+clear_coro(struct coro_trace *c)
+{
+	set(&c->resumes, 0);
+	set(&c->yields, 0);
+	set(&c->run_ns, 0);
+	set(&c->suspended_ns, 0);
+	set(&c->yielded_at, 0);
+}
+
+static size_t
+slot_of(uintptr_t key)
+{
+	size_t mask = COTRACE_MAX_COROUTINES - 1;
+
+	return (size_t)((key >> 4) * 0x9e3779b97f4a7c15ull >> 32) & mask;
+}
+
+/* Plain copy of an entry, see compact */
+struct coro_copy {
+	uintptr_t co;
+	uint64_t resumes;
+	uint64_t yields;
+	uint64_t run_ns;
+	uint64_t suspended_ns;
+	uint64_t yielded_at;
+};
+
+/*
+ * Insert the live entries again into an emptied table, so the slots of
+ * the tombstones can take new keys. Returns 0 or -1 if out of memory.
+ */
+static int
+compact(struct thread_trace *t)
+{
+	struct coro_copy *live = malloc(t->ncoros * sizeof(*live));
+	size_t n = 0;
+
+	if (live == NULL) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < COTRACE_MAX_COROUTINES; i++) {
+		struct coro_trace *c = &t->coros[i];
+		uintptr_t k = atomic_load_explicit(&c->co,
+		    memory_order_relaxed);
+
+		if (k != 0 && k != TOMBSTONE) {
+			live[n++] = (struct coro_copy) { k, get(&c->resumes),
+				get(&c->yields), get(&c->run_ns),
+				get(&c->suspended_ns), get(&c->yielded_at) };
+		}
+		atomic_store_explicit(&c->co, 0, memory_order_relaxed);
+	}
+
+	for (size_t j = 0; j < n; j++) {
+		size_t i = slot_of(live[j].co);
+
+		while (atomic_load_explicit(&t->coros[i].co,
+		    memory_order_relaxed) != 0) {
+			i = (i + 1) & (COTRACE_MAX_COROUTINES - 1);
+		}
+
+		struct coro_trace *c = &t->coros[i];
+
+		set(&c->resumes, live[j].resumes);
+		set(&c->yields, live[j].yields);
+		set(&c->run_ns, live[j].run_ns);
+		set(&c->suspended_ns, live[j].suspended_ns);
+		set(&c->yielded_at, live[j].yielded_at);
+		atomic_store_explicit(&c->co, live[j].co,
+		    memory_order_release);
+	}
+
+	t->ncoros = n;
+	t->ndead = 0;
+	t->compactions++;
+	free(live);
+
+	return 0;
+}
+
+/*
+ * Entry of `co`, added if there's room; NULL if not tracked. A `fresh`
+ * coroutine (not suspended in a yield) starts over: its address may be
+ * the one of a coroutine collected, or recycled, without a final resume.
+ */
+static struct coro_trace *
+find_coro(struct thread_trace *t, lua_State *co, int fresh)
+{
+	uintptr_t key = (uintptr_t)co;
+	size_t mask = COTRACE_MAX_COROUTINES - 1;
+	size_t i = slot_of(key);
+	struct coro_trace *reuse = NULL;
+
+	for (;; i = (i + 1) & mask) {
+		struct coro_trace *c = &t->coros[i];
+		uintptr_t k = atomic_load_explicit(&c->co,
+		    memory_order_relaxed);
+
+		if (k == key) {
+			if (fresh) {
+				clear_coro(c);
+			}
+			return c;
+		}
+		if (k == TOMBSTONE && reuse == NULL) {
+			reuse = c;
+		}
+		if (k != 0) {
+			continue;
+		}
+
+		/* Kept 3/4 full at most (tombstones too), probes stay short */
+		if (reuse != NULL) {
+			t->ndead--;
+		} else if (t->ncoros < COTRACE_MAX_COROUTINES / 4 * 3) {
+			t->ncoros++;
+			reuse = c;
+		} else if (t->ndead > 0 && compact(t) == 0) {
+			return find_coro(t, co, fresh);
+		} else {
+			return NULL;
+		}
+		clear_coro(reuse);
+		atomic_store_explicit(&reuse->co, key, memory_order_release);
+		return reuse;
+	}
+}
+
+/* Forget an ended coroutine, its totals stay in the thread's */
+static void
+free_coro(struct thread_trace *t, struct coro_trace *c)
+{
+	atomic_store_explicit(&c->co, TOMBSTONE, memory_order_release);
+	t->ndead++;
+}
+
+void
+cotrace_enable(int on)
+{
+	atomic_store_explicit(&enabled, on != 0, memory_order_relaxed);
+}
+
+int
+cotrace_resume(lua_State *co, lua_State *from, int nargs, int *nres)
+{
+	struct thread_trace *t;
+
+	if (!atomic_load_explicit(&enabled, memory_order_relaxed) ||
+	    (t = current_thread()) == NULL) {
+		return lua_resume(co, from, nargs, nres);
+	}
+
+	int fresh = lua_status(co) != LUA_YIELD;
+	struct coro_trace *c = find_coro(t, co, fresh);
+	uint64_t start = now_ns();
+
+	if (c != NULL && get(&c->yielded_at) != 0) {
+		uint64_t waited = start - get(&c->yielded_at);
+
+		add(&c->suspended_ns, waited);
+		record(&t->suspended, waited);
+		set(&c->yielded_at, 0);
+	}
+
+	unsigned e = atomic_load_explicit(&t->epoch, memory_order_relaxed);
+	unsigned moved = t->compactions;
+	int status = lua_resume(co, from, nargs, nres);
+	uint64_t end = now_ns();
+
+	/* Reset or compact from inside the coroutine, the entry is gone */
+	if (atomic_load_explicit(&t->epoch, memory_order_relaxed) != e ||
+	    t->compactions != moved) {
+		c = find_coro(t, co, 0);
+	}
+
+	add(&t->resumes, 1);
+	record(&t->run, end - start);
+	if (c != NULL) {
+		add(&c->resumes, 1);
+		add(&c->run_ns, end - start);
+	} else {
+		add(&t->dropped, 1);
+	}
+
+	if (status == LUA_YIELD) {
+		add(&t->yields, 1);
+		if (c != NULL) {
+			add(&c->yields, 1);
+			set(&c->yielded_at, end);
+		}
+	} else {
+		if (status != LUA_OK) {
+			add(&t->errors, 1);
+		}
+		/* Dead now, the address can come back for another one */
+		if (c != NULL) {
+			free_coro(t, c);
+		}
+	}
+
+	return status;
+}
+
+void
+cotrace_reset(void)
+{
+	/* Every thread clears its own buffers at its next resume */
+	atomic_fetch_add_explicit(&epoch, 1, memory_order_acq_rel);
+}
+
+/*
+ * Snapshots
+ */
+
+struct hist_copy {
+	uint64_t counts[HIST_BUCKETS];
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+};
+
+struct coro_row {
+	uintptr_t co;
+	uint64_t resumes;
+	uint64_t yields;
+	uint64_t run_ns;
+	uint64_t suspended_ns;
+	int suspended;
+};
+
+struct snapshot {
+	int threads;
+	struct cotrace_stats stats;
+	struct hist_copy run;
+	struct hist_copy suspended;
+	struct coro_row *rows;
+	size_t nrows;
+};
+
+static void
+merge_histogram(struct hist_copy *dst, struct histogram *h)
+{
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		uint64_t n = get(&h->counts[i]);
+
+		dst->counts[i] += n;
+		dst->count += n;
+	}
+	dst->total += get(&h->total);
+	if (get(&h->max) > dst->max) {
+		dst->max = get(&h->max);
+	}
+}
+
+static int
+compare_rows(const void *a, const void *b)
+{
+	uintptr_t x = ((const struct coro_row *)a)->co;
+	uintptr_t y = ((const struct coro_row *)b)->co;
+
+	return (x > y) - (x < y);
+}
+
+/* Rows of the same coroutine resumed from several threads are merged */
+static void
+merge_rows(struct snapshot *s)
+{
+	size_t n = 0;
+
+	qsort(s->rows, s->nrows, sizeof(*s->rows), compare_rows);
+
+	for (size_t i = 0; i < s->nrows; i++) {
+		struct coro_row *r = &s->rows[i];
+
+		if (n > 0 && s->rows[n - 1].co == r->co) {
+			struct coro_row *m = &s->rows[n - 1];
+
+			m->resumes += r->resumes;
+			m->yields += r->yields;
+			m->run_ns += r->run_ns;
+			m->suspended_ns += r->suspended_ns;
+			m->suspended |= r->suspended;
+		} else {
+			s->rows[n++] = *r;
+		}
+	}
+	s->nrows = n;
+}
+
+/* Returns NULL if out of memory */
+static struct snapshot *
+take_snapshot(void)
+{
+	struct snapshot *s = calloc(1, sizeof(*s));
+	size_t cap = 0;
+
+	if (s == NULL) {
+		return NULL;
+	}
+
+	unsigned e = atomic_load_explicit(&epoch, memory_order_acquire);
+
+	for (struct thread_trace *t = atomic_load_explicit(&threads,
+		 memory_order_acquire);
+	     t != NULL; t = t->next) {
+		/* Not cleared since the last reset: nothing to count */
+		if (atomic_load_explicit(&t->epoch, memory_order_acquire) !=
+		    e) {
+			continue;
+		}
+
+		s->threads++;
+		s->stats.resumes += get(&t->resumes);
+		s->stats.yields += get(&t->yields);
+		s->stats.errors += get(&t->errors);
+		s->stats.dropped += get(&t->dropped);
+		merge_histogram(&s->run, &t->run);
+		merge_histogram(&s->suspended, &t->suspended);
+
+		for (size_t i = 0; i < COTRACE_MAX_COROUTINES; i++) {
+			struct coro_trace *c = &t->coros[i];
+			uintptr_t co = atomic_load_explicit(&c->co,
+			    memory_order_acquire);
+
+			if (co == 0 || co == TOMBSTONE) {
+				continue;
+			}
+			if (s->nrows == cap) {
+				size_t ncap = cap ? cap * 2 : 64;
+				struct coro_row *rows = realloc(s->rows,
+				    ncap * sizeof(*rows));
+
+				if (rows == NULL) {
+					free(s->rows);
+					free(s);
+					return NULL;
+				}
+				s->rows = rows;
+				cap = ncap;
+			}
+			s->rows[s->nrows++] = (struct coro_row) { co,
+				get(&c->resumes), get(&c->yields),
+				get(&c->run_ns),
+				get(&c->suspended_ns),
+				get(&c->yielded_at) != 0 };
+		}
+	}
+
+	merge_rows(s);
+
+	return s;
+}
+
+static void
+free_snapshot(struct snapshot *s)
+{
+	free(s->rows);
+	free(s);
+}
+
+void
+cotrace_stats(struct cotrace_stats *stats)
+{
+	unsigned e = atomic_load_explicit(&epoch, memory_order_acquire);
+
+	memset(stats, 0, sizeof(*stats));
+	for (struct thread_trace *t = atomic_load_explicit(&threads,
+		 memory_order_acquire);
+	     t != NULL; t = t->next) {
+		if (atomic_load_explicit(&t->epoch, memory_order_acquire) ==
+		    e) {
+			stats->resumes += get(&t->resumes);
+			stats->yields += get(&t->yields);
+			stats->errors += get(&t->errors);
+			stats->dropped += get(&t->dropped);
+		}
+	}
+}
+
+/* Value at quantile q, the highest of its bucket */
+static uint64_t
+percentile(const struct hist_copy *h, double q)
+{
+	uint64_t rank = (uint64_t)(q * h->count + 0.5);
+	uint64_t seen = 0;
+
+	if (rank == 0) {
+		rank = 1;
+	}
+
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->counts[i];
+		if (seen >= rank) {
+			uint64_t v = bucket_upper(i);
+			return v < h->max ? v : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+static void
+write_json_histogram(FILE *out, const char *name, const struct hist_copy *h)
+{
+	fprintf(out,
+	    "  \"%s\": {\"count\": %llu, \"sum\": %llu, \"p50\": %llu, "
+	    "\"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu},\n",
+	    name, (unsigned long long)h->count, (unsigned long long)h->total,
+	    (unsigned long long)percentile(h, 0.5),
+	    (unsigned long long)percentile(h, 0.9),
+	    (unsigned long long)percentile(h, 0.99),
+	    (unsigned long long)percentile(h, 0.999),
+	    (unsigned long long)h->max);
+}
+
+static void
+write_json(FILE *out, const struct snapshot *s)
+{
+	fprintf(out,
+	    "{\n  \"threads\": %d,\n  \"resumes\": %llu,\n"
+	    "  \"yields\": %llu,\n  \"errors\": %llu,\n"
+	    "  \"dropped\": %llu,\n",
+	    s->threads, (unsigned long long)s->stats.resumes,
+	    (unsigned long long)s->stats.yields,
+	    (unsigned long long)s->stats.errors,
+	    (unsigned long long)s->stats.dropped);
+	write_json_histogram(out, "run_ns", &s->run);
+	write_json_histogram(out, "suspended_ns", &s->suspended);
+
+	fprintf(out, "  \"coroutines\": [");
+	for (size_t i = 0; i < s->nrows; i++) {
+		const struct coro_row *r = &s->rows[i];
+
+		fprintf(out,
+		    "%s\n    {\"id\": \"%#lx\", \"resumes\": %llu, "
+		    "\"yields\": %llu, \"run_ns\": %llu, "
+		    "\"suspended_ns\": %llu, \"suspended\": %s}",
+		    i ? "," : "", (unsigned long)r->co,
+		    (unsigned long long)r->resumes,
+		    (unsigned long long)r->yields,
+		    (unsigned long long)r->run_ns,
+		    (unsigned long long)r->suspended_ns,
+		    r->suspended ? "true" : "false");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+/* Per coroutine counter, the row field at `offset` times `scale` */
+static void
+write_prometheus_counter(FILE *out, const struct snapshot *s,
+    const char *name, const char *help, size_t offset, double scale)
+{
+	fprintf(out, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+
+	for (size_t i = 0; i < s->nrows; i++) {
+		uint64_t v = *(const uint64_t *)((const char *)&s->rows[i] +
+		    offset);
+
+		fprintf(out, "%s{coroutine=\"%#lx\"} %.9g\n", name,
+		    (unsigned long)s->rows[i].co, v * scale);
+	}
+}
+
+/*
+ * Fixed decade buckets, in nanoseconds. A log-linear bucket counts under
+ * the first one it fits in entirely, so bounds are off by at most one
+ * bucket width (6%).
+ */
+static const uint64_t prometheus_bounds[] = { 1000, 10000, 100000,
+	1000000, 10000000, 100000000, 1000000000, 10000000000 };
+
+static void
+write_prometheus_histogram(FILE *out, const char *name, const char *help,
+    const struct hist_copy *h)
+{
+	size_t nbounds = sizeof(prometheus_bounds) /
+	    sizeof(prometheus_bounds[0]);
+	uint64_t seen = 0;
+	int i = 0;
+
+	fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help,
+	    name);
+
+	for (size_t b = 0; b < nbounds; b++) {
+		uint64_t le = prometheus_bounds[b];
+
+		for (; i < HIST_BUCKETS && bucket_upper(i) <= le; i++) {
+			seen += h->counts[i];
+		}
+		fprintf(out, "%s_bucket{le=\"%g\"} %llu\n", name, le / 1e9,
+		    (unsigned long long)seen);
+	}
+	fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name,
+	    (unsigned long long)h->count);
+	fprintf(out, "%s_sum %.9g\n%s_count %llu\n", name, h->total / 1e9,
+	    name, (unsigned long long)h->count);
+}
+
+static void
+write_prometheus(FILE *out, const struct snapshot *s)
+{
+	write_prometheus_counter(out, s, "lua_coroutine_resumes_total",
+	    "Coroutine resumes.", offsetof(struct coro_row, resumes), 1);
+	write_prometheus_counter(out, s, "lua_coroutine_yields_total",
+	    "Coroutine yields.", offsetof(struct coro_row, yields), 1);
+	write_prometheus_counter(out, s, "lua_coroutine_run_seconds_total",
+	    "Time spent running.", offsetof(struct coro_row, run_ns), 1e-9);
+	write_prometheus_counter(out, s,
+	    "lua_coroutine_suspended_seconds_total",
+	    "Time spent suspended in a yield.",
+	    offsetof(struct coro_row, suspended_ns), 1e-9);
+
+	fprintf(out,
+	    "# HELP lua_coroutine_untracked_resumes_total Resumes of "
+	    "coroutines beyond the tracked ones.\n"
+	    "# TYPE lua_coroutine_untracked_resumes_total counter\n"
+	    "lua_coroutine_untracked_resumes_total %llu\n",
+	    (unsigned long long)s->stats.dropped);
+	fprintf(out,
+	    "# HELP lua_coroutine_errors_total Coroutines ended by an "
+	    "error.\n"
+	    "# TYPE lua_coroutine_errors_total counter\n"
+	    "lua_coroutine_errors_total %llu\n",
+	    (unsigned long long)s->stats.errors);
+
+	write_prometheus_histogram(out, "lua_coroutine_run_seconds",
+	    "Time from a resume to the next yield or the end.", &s->run);
+	write_prometheus_histogram(out, "lua_coroutine_suspended_seconds",
+	    "Time from a yield to the next resume.", &s->suspended);
+}
+
+int
+cotrace_write(FILE *out, int format)
+{
+	struct snapshot *s = take_snapshot();
+
+	if (s == NULL) {
+		return -1;
+	}
+
+	if (format == COTRACE_PROMETHEUS) {
+		write_prometheus(out, s);
+	} else {
+		write_json(out, s);
+	}
+	free_snapshot(s);
+
+	return fflush(out) != 0 || ferror(out) ? -1 : 0;
+}
+
+int
+cotrace_dump(const char *path, int format)
+{
+	/* Replaced at once, for collectors reading the file meanwhile */
+	size_t len = strlen(path);
+	char *tmp = malloc(len + sizeof(".tmp"));
+	FILE *out;
+	int ok = 0;
+
+	if (tmp == NULL) {
+		return -1;
+	}
+	memcpy(tmp, path, len);
+	memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+	if ((out = fopen(tmp, "w")) != NULL) {
+		ok = cotrace_write(out, format) == 0;
+		ok = fclose(out) == 0 && ok;
+		ok = ok && rename(tmp, path) == 0;
+		if (!ok) {
+			unlink(tmp);
+		}
+	}
+	free(tmp);
+
+	return ok ? 0 : -1;
+}
+
+/*
+ * The library
+ */
+
+static int
+trace_enable(lua_State *L)
+{
+	cotrace_enable(lua_isnone(L, 1) || lua_toboolean(L, 1));
+
+	return 0;
+}
+
+static int
+trace_reset(__UNUSED lua_State *L)
+{
+	cotrace_reset();
+
+	return 0;
+}
+
+/* coroutine.resume, through cotrace_resume */
+static int
+trace_resume(lua_State *L)
+{
+	lua_State *co = lua_tothread(L, 1);
+	int nargs = lua_gettop(L) - 1;
+	int nres;
+
+	luaL_argexpected(L, co != NULL, 1, "coroutine");
+
+	if (!lua_checkstack(co, nargs)) {
+		lua_pushboolean(L, 0);
+		lua_pushliteral(L, "too many arguments to resume");
+		return 2;
+	}
+	lua_xmove(L, co, nargs);
+
+	int status = cotrace_resume(co, L, nargs, &nres);
+
+	if (status != LUA_OK && status != LUA_YIELD) {
+		/* As luaB_coresume, co may be L itself if it resumed itself */
+		lua_xmove(co, L, 1); /* error object */
+		lua_pushboolean(L, 0);
+		lua_insert(L, -2);
+		return 2;
+	}
+
+	if (!lua_checkstack(L, nres + 1)) {
+		lua_pop(co, nres);
+		lua_pushboolean(L, 0);
+		lua_pushliteral(L, "too many results to resume");
+		return 2;
+	}
+	lua_pushboolean(L, 1);
+	lua_xmove(co, L, nres);
+
+	return nres + 1;
+}
+
+static int
+trace_install(lua_State *L)
+{
+	lua_getglobal(L, "coroutine");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	lua_pushcfunction(L, trace_resume);
+	lua_setfield(L, -2, "resume");
+
+	return 0;
+}
+
+static int
+trace_dump(lua_State *L)
+{
+	static const char *const formats[] = { "json", "prometheus", NULL };
+	const char *path = luaL_optstring(L, 1, NULL);
+	int format = luaL_checkoption(L, 2, "json", formats) == 1 ?
+	    COTRACE_PROMETHEUS :
+	    COTRACE_JSON;
+
+	if (path == NULL) {
+		return luaL_fileresult(L, cotrace_write(stdout, format) == 0,
+		    "stdout");
+	}
+
+	return luaL_fileresult(L, cotrace_dump(path, format) == 0, path);
+}
+
+static const luaL_Reg cotrace_funcs[] = {
+	{ "enable", trace_enable },
+	{ "reset", trace_reset },
+	{ "resume", trace_resume },
+	{ "install", trace_install },
+	{ "dump", trace_dump },
+	{ NULL, NULL },
+};
+
+int
+luaopen_cotrace(lua_State *L)
+{
+	luaL_newlib(L, cotrace_funcs);
+
+	return 1;
+}
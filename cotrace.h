@@ -0,0 +1,112 @@
+#ifndef COTRACE_H
+#define COTRACE_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <lua.h>
+
+/* Live coroutines tracked one by one per OS thread, others only counted. */
+#define COTRACE_MAX_COROUTINES 1024
+
+/* Output formats */
+#define COTRACE_JSON	   0
+#define COTRACE_PROMETHEUS 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Coroutine lifecycle tracing.
+ *
+ * cotrace_resume wraps lua_resume and records, per coroutine, how many
+ * times it was resumed and yielded, the time it ran and the time it sat
+ * suspended between a yield and the next resume. Durations also go to
+ * log-linear histograms (HDR style, 16 sub-buckets per power of two,
+ * about 6% precision) of run and suspended times.
+ *
+ * A coroutine is tracked from a resume that isn't the continuation of a
+ * yield until it ends (returns or fails); then its entry is freed, as its
+ * address may be reused, and only the totals keep it. Coroutines dropped
+ * while suspended are forgotten when their address comes back.
+ *
+ * Yields are seen from the resuming side, when lua_resume returns
+ * LUA_YIELD, so C functions keep calling lua_yieldk directly.
+ *
+ * Each OS thread records in its own buffers, written only by itself with
+ * relaxed atomics: no lock and no shared cache line on the resume path.
+ * Snapshots merge the buffers of every thread. Tracing is off by default,
+ * cotrace_resume is then just lua_resume.
+ */
+
+struct cotrace_stats {
+	uint64_t resumes;
+	uint64_t yields;
+	uint64_t errors;
+	uint64_t dropped; /* resumes of coroutines not tracked one by one */
+};
+
+/* Turn recording on or off for every thread. */
+void cotrace_enable(int on);
+
+/* lua_resume, recorded when tracing is on. */
+int cotrace_resume(lua_State *co, lua_State *from, int nargs, int *nres);
+
+/* Forget everything recorded so far, in every thread. */
+void cotrace_reset(void);
+
+/* Copy the counters summed over every thread. */
+void cotrace_stats(struct cotrace_stats *stats);
+
+/* Write a snapshot to `out`. Returns 0 or -1 on errors. */
+int cotrace_write(FILE *out, int format);
+
+/* Write a snapshot to the file `path`, replaced. Returns 0 or -1. */
+int cotrace_dump(const char *path, int format);
+
+/*
+ * Open the `cotrace` library:
+ *   cotrace.enable([on])                  on by default
+ *   cotrace.reset()
+ *   cotrace.resume(co, ...)               traced coroutine.resume
+ *   cotrace.install()                     coroutine.resume = cotrace.resume
+ *   cotrace.dump([filename [, format]])   "json" (default) or
+ *                                         "prometheus", stdout by default
+ */
+int luaopen_cotrace(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* COTRACE_H */
@@ -51,6 +51,27 @@ extern "C" {
 /* Run basic REPL */
 void run_lua_interpreter(void);
 
+/* Install the REPL globals (`val`, `native` and `quit`) in a state. */
+void setup_interpreter_globals(lua_State *L);
+
+/* Whether `quit` was called in the state. */
+int repl_quit_requested(lua_State *L);
+
+/*
+ * Compile one REPL line through the shared chunk cache: pushes the chunk
+ * (or the error message) and returns the Lua status.
+ */
+int repl_load(lua_State *L, const char *line, size_t len);
+
+/*
+ * Evaluate one REPL line: leaves its first result (or the error message)
+ * on the stack and returns the Lua status.
+ */
+int repl_eval(lua_State *L, const char *line, size_t len);
+
+/* C coroutine body of the c2lua example, yields four values. */
+int coroutine_entrypoint(lua_State *L);
+
 /* Create a coroutine in C and resume it from Lua. */
 void create_coroutine_in_c_and_call_it_from_lua(void);
 
@@ -0,0 +1,349 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "examples.h"
+#include "forkserver.h"
+
+#define LISTEN_BACKLOG 128
+
+/* Pending job read from a connection */
+struct job {
+	char *src;
+	size_t len;
+	size_t cap;
+};
+
+lua_State *
+forkserver_prepare(const char *preload)
+{
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	if (L == NULL) {
+		fprintf(stderr, "can't create the master state\n");
+		return NULL;
+	}
+
+	luaL_openlibs(L);
+	setup_interpreter_globals(L);
+
+	if (preload != NULL && luaL_dofile(L, preload) != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		allocator_close(L);
+		return NULL;
+	}
+	lua_settop(L, 0);
+
+	/*
+	 * Leave no garbage nor a cycle in progress: children would copy
+	 * every page the collector touches. Switching to generational mode
+	 * runs a full collection and makes every survivor old, so the
+	 * minor collections of a job only walk what the job allocates.
+	 */
+	lua_gc(L, LUA_GCGEN, 0, 0);
+
+	return L;
+}
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * Read the whole script, until the client shuts down its side.
+ */
+static int
+read_job(int fd, struct job *job)
+{
+	job->len = 0;
+
+	for (;;) {
+		if (job->len == job->cap) {
+			size_t cap = job->cap ? job->cap * 2 : 4096;
+			char *src;
+
+			if (cap > FORKSERVER_MAX_JOB ||
+			    (src = realloc(job->src, cap)) == NULL) {
+				return -1;
+			}
+			job->src = src;
+			job->cap = cap;
+		}
+
+		ssize_t n = read(fd, job->src + job->len, job->cap - job->len);
+
+		if (n == 0) {
+			return 0;
+		}
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		job->len += n;
+	}
+}
+
+/* Protected part of the answer, a __tostring can fail */
+static int
+answer_string(lua_State *L)
+{
+	luaL_tolstring(L, 1, NULL);
+
+	return 1;
+}
+
+int
+forkserver_job(lua_State *L, int fd)
+{
+	struct job job = { NULL, 0, 0 };
+	int status;
+
+	if (read_job(fd, &job) != 0) {
+		free(job.src);
+		write_all(fd, "error: can't read the job\n", 26);
+		return LUA_ERRRUN;
+	}
+
+	status = luaL_loadbufferx(L, job.src, job.len, "=job", "t");
+	free(job.src);
+
+	if (status == LUA_OK) {
+		status = lua_pcall(L, 0, 1, 0);
+	}
+
+	/* Answer with the result, or the error message */
+	lua_pushcfunction(L, answer_string);
+	lua_insert(L, -2);
+
+	int converted = lua_pcall(L, 1, 1, 0);
+
+	if (converted != LUA_OK) {
+		status = converted;
+	}
+
+	size_t len;
+	const char *answer = lua_tolstring(L, -1, &len);
+
+	if (answer == NULL) {
+		answer = "(error object is not a string)";
+		len = strlen(answer);
+	}
+
+	if ((status != LUA_OK && write_all(fd, "error: ", 7) != 0) ||
+	    write_all(fd, answer, len) != 0 || write_all(fd, "\n", 1) != 0) {
+		status = LUA_ERRRUN;
+	}
+	lua_settop(L, 0);
+
+	return status;
+}
+
+static int
+listen_unix(const char *path)
+{
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(fd, LISTEN_BACKLOG) != 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+accept_job(int server)
+{
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+
+		if (fd >= 0 || (errno != EINTR && errno != ECONNABORTED)) {
+			return fd;
+		}
+	}
+}
+
+/**
+ * One child per job, it runs the job and exits.
+ */
+static int
+serve_per_job(lua_State *L, int server)
+{
+	/* Children are reaped by the kernel */
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sa.sa_flags = SA_NOCLDWAIT;
+	sigaction(SIGCHLD, &sa, NULL);
+
+	for (;;) {
+		int fd = accept_job(server);
+
+		if (fd < 0) {
+			perror("accept");
+			return -1;
+		}
+
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			close(server);
+
+			int status = forkserver_job(L, fd);
+			_exit(status == LUA_OK ? 0 : 1);
+		}
+		if (pid < 0) {
+			perror("fork");
+			write_all(fd, "error: server busy\n", 19);
+		}
+		close(fd);
+	}
+}
+
+/**
+ * Worker loop, runs jobs in its own copy of the state until killed.
+ */
+static void
+worker_loop(lua_State *L, int server)
+{
+	for (;;) {
+		int fd = accept_job(server);
+
+		if (fd < 0) {
+			perror("accept");
+			_exit(1);
+		}
+		forkserver_job(L, fd);
+		close(fd);
+	}
+}
+
+static int
+serve_workers(lua_State *L, int server, int workers)
+{
+	int running = 0;
+
+	for (;;) {
+		/* Start (or replace) the workers */
+		while (running < workers) {
+			pid_t pid = fork();
+
+			if (pid == 0) {
+				worker_loop(L, server);
+			}
+			if (pid < 0) {
+				perror("fork");
+				if (running == 0) {
+					return -1;
+				}
+				break;
+			}
+			running++;
+		}
+
+		if (wait(NULL) > 0) {
+			running--;
+		} else if (errno != EINTR) {
+			perror("wait");
+			return -1;
+		}
+	}
+}
+
+int
+forkserver_run(lua_State *L, const char *path, int workers)
+{
+	int server = listen_unix(path);
+
+	if (server < 0) {
+		return -1;
+	}
+
+	/* Clients hanging up must not kill anybody */
+	signal(SIGPIPE, SIG_IGN);
+
+	fprintf(stderr, "fork server listening on %s\n", path);
+
+	int error = workers > 0 ? serve_workers(L, server, workers)
+				: serve_per_job(L, server);
+
+	close(server);
+
+	return error;
+}
@@ -0,0 +1,84 @@
+#ifndef FORKSERVER_H
+#define FORKSERVER_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <lua.h>
+
+/* Largest script a job may send. */
+#define FORKSERVER_MAX_JOB (1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Fork server.
+ *
+ * One master state is built and warmed once (standard libraries, REPL
+ * globals, an optional preload script for modules and configuration,
+ * then the switch to generational collection, which leaves it all old).
+ * Jobs run in forked children that inherit the initialized heap
+ * copy-on-write instead of building their own state; their collections
+ * mostly stay within what the job allocates.
+ *
+ * Jobs arrive on a Unix stream socket: the client sends a Lua script and
+ * shuts down its writing side, the server answers with the first value
+ * returned by the script (as tostring would print it) or "error: " and
+ * the message, followed by a newline, and closes the connection:
+ *
+ *   printf 'return 6 * 7' | nc -NU /tmp/lua.sock
+ */
+
+/*
+ * Build the master state, running the script file `preload` if not NULL.
+ * Returns NULL (after printing why) on failure.
+ */
+lua_State *forkserver_prepare(const char *preload);
+
+/*
+ * Serve jobs from L on the socket `path`. With `workers` 0 a child is
+ * forked per job and exits after it, otherwise `workers` children are
+ * forked upfront and each one runs jobs in its own copy of the state,
+ * dead workers are replaced. Only returns on errors, with -1.
+ */
+int forkserver_run(lua_State *L, const char *path, int workers);
+
+/*
+ * Run one job read from `fd` in L and write the answer back. Returns the
+ * Lua status of the job.
+ */
+int forkserver_job(lua_State *L, int fd);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FORKSERVER_H */
@@ -0,0 +1,277 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "cotrace.h"
+#include "examples.h"
+#include "generator.h"
+
+/* First argument of the generator coroutine */
+struct generator {
+	generator_producer produce;
+	int batch_size;
+	max_align_t state[]; /* of the producer */
+};
+
+/* Iterator position in the current batch */
+struct cursor {
+	lua_Integer pos;
+	lua_Integer count;
+	int done;
+};
+
+/**
+ * Generator coroutine: 1 is the generator, 2 the batch table. Refill the
+ * batch and yield it until the producer has nothing more.
+ */
+static int
+generator_k(lua_State *L, __UNUSED int status, __UNUSED lua_KContext ctx)
+{
+	struct generator *g = lua_touserdata(L, 1);
+
+	lua_settop(L, 2); /* values passed to resume, if any */
+
+	int n = g->produce(L, g->state, 2, g->batch_size);
+
+	if (n <= 0) {
+		return 0;
+	}
+
+	lua_pushvalue(L, 2);
+	lua_pushinteger(L, n);
+
+	return lua_yieldk(L, 2, 0, generator_k);
+}
+
+static int
+generator_body(lua_State *L)
+{
+	return generator_k(L, LUA_OK, 0);
+}
+
+void *
+generator_new(lua_State *L, generator_producer produce, size_t state_size,
+    int batch_size)
+{
+	lua_State *co = lua_newthread(L);
+
+	/* Staged as the first resume: body(generator, batch) */
+	lua_pushcfunction(co, generator_body);
+
+	struct generator *g = lua_newuserdatauv(co, sizeof(*g) + state_size,
+	    0);
+
+	g->produce = produce;
+	g->batch_size = batch_size > 0 ? batch_size : GENERATOR_BATCH;
+	memset(g->state, 0, state_size);
+	lua_createtable(co, g->batch_size, 0);
+
+	return g->state;
+}
+
+/**
+ * Resume the coroutine for its next batch, stored as upvalue 3. Returns
+ * 0 once it's over.
+ */
+static int
+refill(lua_State *L, struct cursor *c)
+{
+	lua_State *co = lua_tothread(L, lua_upvalueindex(1));
+
+	while (!c->done) {
+		int nargs = 0;
+		int nres;
+
+		/* Not started yet, the function and its arguments are there */
+		if (lua_status(co) == LUA_OK && lua_gettop(co) > 0) {
+			nargs = lua_gettop(co) - 1;
+		}
+
+		int status = cotrace_resume(co, L, nargs, &nres);
+
+		if (status == LUA_YIELD && nres >= 2 &&
+		    lua_type(co, -nres) == LUA_TTABLE) {
+			c->count = lua_tointeger(co, -nres + 1);
+			c->pos = 0;
+			lua_pushvalue(co, -nres);
+			lua_xmove(co, L, 1);
+			lua_replace(L, lua_upvalueindex(3));
+			lua_pop(co, nres);
+			if (c->count > 0) {
+				return 1;
+			}
+			continue;
+		}
+
+		c->done = 1;
+		if (status == LUA_OK) {
+			lua_pop(co, nres);
+			return 0;
+		}
+		if (status == LUA_YIELD) {
+			lua_pop(co, nres);
+			return luaL_error(L, "generator yielded no batch");
+		}
+		lua_xmove(co, L, 1); /* error object */
+		return lua_error(L);
+	}
+
+	return 0;
+}
+
+static int
+each_next(lua_State *L)
+{
+	struct cursor *c = lua_touserdata(L, lua_upvalueindex(2));
+
+	if (c->pos >= c->count && !refill(L, c)) {
+		return 0;
+	}
+
+	lua_rawgeti(L, lua_upvalueindex(3), ++c->pos);
+
+	return 1;
+}
+
+void
+generator_each(lua_State *L, int idx)
+{
+	idx = lua_absindex(L, idx);
+
+	struct cursor *c;
+
+	lua_pushvalue(L, idx);
+	c = lua_newuserdatauv(L, sizeof(*c), 0);
+	c->pos = 0;
+	c->count = 0;
+	c->done = 0;
+	lua_pushnil(L); /* batch */
+	lua_pushcclosure(L, each_next, 3);
+}
+
+void *
+generator_push(lua_State *L, generator_producer produce, size_t state_size,
+    int batch_size)
+{
+	void *state = generator_new(L, produce, state_size, batch_size);
+
+	generator_each(L, -1);
+	lua_remove(L, -2);
+
+	return state;
+}
+
+/*
+ * generator.range
+ */
+
+struct range {
+	lua_Integer next;
+	lua_Integer step;
+	lua_Unsigned left; /* items after `next` */
+	int more;
+};
+
+static int
+range_produce(lua_State *L, void *state, int batch, int max)
+{
+	struct range *r = state;
+	int n = 0;
+
+	while (n < max && r->more) {
+		lua_pushinteger(L, r->next);
+		lua_rawseti(L, batch, ++n);
+		if (r->left == 0) {
+			r->more = 0;
+		} else {
+			r->left--;
+			r->next += r->step;
+		}
+	}
+
+	return n;
+}
+
+static int
+generator_range(lua_State *L)
+{
+	lua_Integer first = luaL_checkinteger(L, 1);
+	lua_Integer last = luaL_checkinteger(L, 2);
+	lua_Integer step = luaL_optinteger(L, 3, 1);
+	lua_Integer batch = luaL_optinteger(L, 4, GENERATOR_BATCH);
+
+	luaL_argcheck(L, step != 0, 3, "step is zero");
+	luaL_argcheck(L, batch > 0 && batch <= 1 << 20, 4,
+	    "batch size out of range");
+
+	struct range *r = generator_push(L, range_produce, sizeof(*r),
+	    (int)batch);
+
+	/* Same count as a numeric for */
+	r->next = first;
+	r->step = step;
+	if (step > 0 ? first <= last : first >= last) {
+		r->more = 1;
+		r->left = step > 0 ?
+		    ((lua_Unsigned)last - (lua_Unsigned)first) / step :
+		    ((lua_Unsigned)first - (lua_Unsigned)last) /
+			(-(lua_Unsigned)step);
+	}
+
+	return 1;
+}
+
+static int
+generator_each_lua(lua_State *L)
+{
+	luaL_checktype(L, 1, LUA_TTHREAD);
+	generator_each(L, 1);
+
+	return 1;
+}
+
+static const luaL_Reg generator_funcs[] = {
+	{ "each", generator_each_lua },
+	{ "range", generator_range },
+	{ NULL, NULL },
+};
+
+int
+luaopen_generator(lua_State *L)
+{
+	luaL_newlib(L, generator_funcs);
+
+	return 1;
+}
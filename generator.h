@@ -0,0 +1,111 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+/* Items per batch when none is given. */
+#define GENERATOR_BATCH 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Batched C generators.
+ *
+ * A coroutine yielding one value per resume (like kfunction in c2lua.c)
+ * pays a resume round trip per item. Here the C producer fills a batch
+ * table with up to N items and yields it with its count, `batch, n`; the
+ * same table is refilled on every resume, so steady generators allocate
+ * nothing but their items. The consumer side iterator unpacks the batches
+ * one item at a time:
+ *
+ *   for v in gen do ... end
+ *
+ * Producers keep their progress in a state block allocated with the
+ * generator, zero filled:
+ *
+ *   static int
+ *   count(lua_State *L, void *state, int batch, int max)
+ *   {
+ *       lua_Integer *next = state;
+ *       int n = 0;
+ *
+ *       while (n < max && *next < 1000) {
+ *           lua_pushinteger(L, (*next)++);
+ *           lua_rawseti(L, batch, ++n);
+ *       }
+ *       return n;
+ *   }
+ */
+
+/*
+ * Store up to `max` items in the table at `batch` (indices 1 to n) and
+ * return n, 0 to end the generator. L is the generator coroutine. Items
+ * are plain table values, a nil item ends the iteration.
+ */
+typedef int (*generator_producer)(lua_State *L, void *state, int batch,
+    int max);
+
+/*
+ * Push a new generator coroutine yielding batches of up to `batch_size`
+ * items. Returns its state block of `state_size` bytes.
+ */
+void *generator_new(lua_State *L, generator_producer produce,
+    size_t state_size, int batch_size);
+
+/*
+ * Push an iterator over the items of the coroutine at `idx`, which yields
+ * `batch, n` pairs: a generator, or any Lua coroutine doing the same.
+ * Errors of the coroutine are raised by the iterator.
+ */
+void generator_each(lua_State *L, int idx);
+
+/* generator_new then generator_each, leaving only the iterator. */
+void *generator_push(lua_State *L, generator_producer produce,
+    size_t state_size, int batch_size);
+
+/*
+ * Open the `generator` library:
+ *   generator.each(co)                       items of a batch coroutine
+ *   generator.range(first, last [, step [, batch]])
+ *                                            batched integer range
+ */
+int luaopen_generator(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* GENERATOR_H */
@@ -33,7 +33,10 @@
 #include <lua.h>
 #include <lualib.h>
 
+#include "allocator.h"
 #include "examples.h"
+#include "preempt.h"
+#include "scripts/lua2c.h"
 
 /**
  * Create a new coroutine in Lua and resumes it in C (Lua yields -> C resumes).
@@ -42,24 +45,14 @@ void
 create_lua_coroutine_and_manage_in_c()
 {
 	/* Create a new Lua state */
-	lua_State *L = luaL_newstate();
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
 
 	/* Load all standard libraries */
 	luaL_openlibs(L);
 
-	/* Load Lua code */
-	int error = luaL_loadstring(L,
-	    "local co = coroutine.create(function()\n" /* Creates a coroutine */
-	    "    print(\"Hello from Lua\")\n" /* Prints 'Hello from Lua' from
-						 coroutine thread */
-	    "    d = coroutine.yield(\"Send from Lua\")\n" /* Yields value 'Send
-							      from Lua' and when
-							      it resumes returns
-							      'Send from C' */
-	    "    print(d)\n" /* Prints resumed value */
-	    "end)\n"
-	    "return co" /* Return the created routine with the inner function */
-	);
+	/* Load the precompiled scripts/lua2c.lua */
+	int error = luaL_loadbufferx(L, (const char *)lua2c_bytecode,
+	    sizeof(lua2c_bytecode), "=lua2c", "b");
 
 	if (error) {
 		fprintf(stderr, "%s", lua_tostring(L, -1));
@@ -72,24 +65,34 @@ create_lua_coroutine_and_manage_in_c()
 	if (error != LUA_OK && error != LUA_YIELD) {
 		fprintf(stderr, "%s", lua_tostring(L, -1));
 		lua_pop(L, 1); /* pop error message from the stack */
-		lua_close(L);
+		allocator_close(L);
 		return;
 	}
 
 	/* Get the coroutine as state */
 	lua_State *state = lua_tothread(L, -1);
 	int res = -1;
+	int preempted;
 
 	do {
-		/* Send the value and resume the coroutine */
+		/*
+		 * Send the value and resume the coroutine, a script that
+		 * doesn't yield on its own is preempted after its quantum.
+		 */
 		lua_pushstring(state, "Send from C");
-		error = lua_resume(state, L, 1, &res);
+		error = preempt_resume(state, L, 1, &res,
+		    PREEMPT_DEFAULT_QUANTUM, &preempted);
 
 		if (error != LUA_OK && error != LUA_YIELD) {
 			fprintf(stderr, "%s", lua_tostring(L, -1));
 			lua_pop(L, 1); /* pop error message from the stack */
 		}
 
+		/* Preempted: nothing was yielded, just resume it again */
+		if (preempted) {
+			continue;
+		}
+
 		/* Print received (yield) value */
 		fprintf(stderr, "Received results: %d\n", res);
 		for (; res > 0; res--) {
@@ -101,5 +104,5 @@ create_lua_coroutine_and_manage_in_c()
 	} while (error ==
 	    LUA_YIELD); /* If lua_resume returns LUA_YILED, call it again. */
 
-	lua_close(L);
+	allocator_close(L);
 }
@@ -27,10 +27,106 @@
  * SUCH DAMAGE.
  */
 
+/*
+ * Example driver.
+ *
+ * Usage: lua_example [-n N] [-j M] [-P] [-t FILE] [-l LIBS]
+ *                    [EXAMPLE [ARGS...]]
+ *
+ *   -n N     run the example N times in a row
+ *   -j M     run M copies of those runs in parallel
+ *   -P       copies are processes instead of threads
+ *   -t FILE  trace coroutines, snapshot written to FILE at the end (JSON,
+ *            Prometheus text if FILE ends in .prom)
+ *   -l LIBS  standard libraries opened eagerly by the REPL, script and
+ *            pool states, comma separated ("string,table"); the others
+ *            are built on first use. All of them by default
+ *
+ * Without an example the four classic ones run in sequence, as `all`.
+ * Every run reports its wall time, CPU time and the peak RSS on stderr
+ * (the peak of the whole process for thread copies), then the batch
+ * totals are printed.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aio.h"
+#include "allocator.h"
+#include "cotrace.h"
 #include "examples.h"
+#include "forkserver.h"
+#include "outbuf.h"
+#include "stdlibs.h"
+#include "repl_server.h"
+#include "scheduler.h"
+#include "script_loader.h"
 
-int
-main(__UNUSED int argc, __UNUSED char **argv)
+/* States kept warm for new REPL server sessions */
+#define DEFAULT_WARM_SESSIONS 64
+
+/* Example flags */
+#define EXAMPLE_SERVER 0x1 /* runs until killed, no repeats nor copies */
+
+struct example {
+	const char *name;
+	const char *args;
+	int min_args;
+	int flags;
+	int (*run)(int argc, char **argv); /* argv[0] is the example name */
+	const char *help;
+};
+
+/* Runs of one copy */
+struct copy {
+	const struct example *ex;
+	int argc;
+	char **argv;
+	long runs;
+	int id;
+	int failed;
+};
+
+static int
+run_repl(__UNUSED int argc, __UNUSED char **argv)
+{
+	run_lua_interpreter();
+
+	return 0;
+}
+
+static int
+run_c2lua(__UNUSED int argc, __UNUSED char **argv)
+{
+	create_coroutine_in_c_and_call_it_from_lua();
+
+	return 0;
+}
+
+static int
+run_lua2c(__UNUSED int argc, __UNUSED char **argv)
+{
+	create_lua_coroutine_and_manage_in_c();
+
+	return 0;
+}
+
+static int
+run_direct(__UNUSED int argc, __UNUSED char **argv)
+{
+	direct_call_to_coroutine();
+
+	return 0;
+}
+
+static int
+run_all(__UNUSED int argc, __UNUSED char **argv)
 {
 	/* Run basic REPL */
 	run_lua_interpreter();
@@ -46,3 +142,381 @@ main(__UNUSED int argc, __UNUSED char **argv)
 
 	return 0;
 }
+
+/**
+ * run FILE...: run scripts one after the other in the same state, "-"
+ * streams one from stdin. The tasks a script spawns with `sched` (using
+ * `aio` for I/O) run once it returns. Stops at the first error.
+ */
+static int
+run_scripts(int argc, char **argv)
+{
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+	int status = 0;
+
+	stdlibs_open(L);
+	setup_interpreter_globals(L);
+
+	/* Buffered print and io.write for output heavy scripts */
+	struct outbuf *out = outbuf_open(L, STDOUT_FILENO);
+
+	outbuf_install(L);
+
+	struct scheduler *s = scheduler_create(L);
+	struct aio *aio = s != NULL ? aio_create(s, L) : NULL;
+
+	if (aio == NULL) {
+		fprintf(stderr, "can't create the event loop\n");
+		scheduler_destroy(s);
+		allocator_close(L);
+		return 1;
+	}
+
+	for (int i = 1; i < argc && status == 0; i++) {
+		struct scheduler_stats stats;
+
+		if (script_run(L, argv[i]) != LUA_OK) {
+			status = 1;
+		}
+
+		size_t stuck = scheduler_run(s);
+
+		scheduler_stats(s, &stats);
+		if (stats.errors > 0) {
+			status = 1;
+		}
+		if (stuck > 0) {
+			fprintf(stderr, "%s: %zu tasks left waiting\n",
+			    argv[i], stuck);
+		}
+		outbuf_flush(out);
+	}
+
+	aio_destroy(aio);
+	scheduler_destroy(s);
+	allocator_close(L);
+
+	return status;
+}
+
+/**
+ * fork-server PATH [PRELOAD [WORKERS]]: serve jobs from a warm state.
+ */
+static int
+run_fork_server(int argc, char **argv)
+{
+	const char *preload = argc > 2 && *argv[2] ? argv[2] : NULL;
+	int workers = argc > 3 ? atoi(argv[3]) : 0;
+	lua_State *L = forkserver_prepare(preload);
+
+	if (L == NULL || forkserver_run(L, argv[1], workers) != 0) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * repl-server PATH [WARM]: serve REPL sessions on a Unix socket.
+ */
+static int
+run_repl_server(int argc, char **argv)
+{
+	long warm = argc > 2 ? atol(argv[2]) : DEFAULT_WARM_SESSIONS;
+
+	return repl_server_run(argv[1], warm > 0 ? warm : 1) != 0;
+}
+
+static const struct example examples[] = {
+	{ "all", "", 0, 0, run_all, "the four examples below in sequence" },
+	{ "repl", "", 0, 0, run_repl, "interactive REPL on stdin" },
+	{ "c2lua", "", 0, 0, run_c2lua, "C coroutine resumed from Lua" },
+	{ "lua2c", "", 0, 0, run_lua2c, "Lua coroutine resumed from C" },
+	{ "direct", "", 0, 0, run_direct, "coroutine started from C" },
+	{ "run", "FILE...", 1, 0, run_scripts, "run scripts (- for stdin)" },
+	{ "fork-server", "PATH [PRELOAD [WORKERS]]", 1, EXAMPLE_SERVER,
+	    run_fork_server, "serve jobs from forks of a warm state" },
+	{ "repl-server", "PATH [WARM]", 1, EXAMPLE_SERVER, run_repl_server,
+	    "serve REPL sessions on a Unix socket" },
+	{ NULL, NULL, 0, 0, NULL, NULL },
+};
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+	    "usage: %s [-n N] [-j M] [-P] [-t FILE] [-l LIBS] "
+	    "[EXAMPLE [ARGS...]]\n"
+	    "  -n N     repeat the example N times\n"
+	    "  -j M     run M copies in parallel\n"
+	    "  -P       copies are processes instead of threads\n"
+	    "  -t FILE  write a coroutine trace to FILE (.prom: Prometheus)\n"
+	    "  -l LIBS  libraries opened eagerly, the rest lazily\n"
+	    "examples:\n",
+	    prog);
+
+	for (const struct example *ex = examples; ex->name != NULL; ex++) {
+		fprintf(stderr, "  %-12s %-26s %s\n", ex->name, ex->args,
+		    ex->help);
+	}
+}
+
+static double
+elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e3 +
+	    (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static double
+rusage_cpu_ms(const struct rusage *ru)
+{
+	return (ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) * 1e3 +
+	    (ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) / 1e3;
+}
+
+/**
+ * Run the example once and report its wall time, the CPU time of the
+ * calling thread and the peak RSS so far.
+ */
+static int
+timed_run(struct copy *c, long n)
+{
+	struct timespec wall0, wall1, cpu0, cpu1;
+	struct rusage ru;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall0);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+
+	int status = c->ex->run(c->argc, c->argv);
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+	clock_gettime(CLOCK_MONOTONIC, &wall1);
+	getrusage(RUSAGE_SELF, &ru);
+
+	fprintf(stderr,
+	    "%s copy %d run %ld: status %d, wall %.3f ms, cpu %.3f ms, "
+	    "max rss %ld KB\n",
+	    c->ex->name, c->id, n, status, elapsed_ms(&wall0, &wall1),
+	    elapsed_ms(&cpu0, &cpu1), ru.ru_maxrss);
+
+	return status;
+}
+
+static void *
+copy_main(void *arg)
+{
+	struct copy *c = arg;
+
+	for (long n = 1; n <= c->runs; n++) {
+		if (timed_run(c, n) != 0) {
+			c->failed++;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Run the copies on threads, returns the number of failed runs.
+ */
+static long
+run_threads(struct copy *copies, int ncopies)
+{
+	pthread_t *threads = calloc(ncopies, sizeof(*threads));
+	long failed = 0;
+	int started = 0;
+
+	if (threads == NULL) {
+		perror("calloc");
+		return ncopies * copies[0].runs;
+	}
+
+	for (; started < ncopies; started++) {
+		if (pthread_create(&threads[started], NULL, copy_main,
+			&copies[started]) != 0) {
+			fprintf(stderr, "can't start copy %d\n", started);
+			break;
+		}
+	}
+
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+		failed += copies[i].failed;
+	}
+	failed += (ncopies - started) * copies[0].runs;
+
+	free(threads);
+
+	return failed;
+}
+
+/**
+ * Run the copies in child processes, returns the number of failed runs
+ * (their exit status, a killed copy failed all of its runs).
+ */
+static long
+run_processes(struct copy *copies, int ncopies)
+{
+	long failed = 0;
+	int started = 0;
+
+	/* Children must not flush what the parent buffered */
+	fflush(NULL);
+
+	for (; started < ncopies; started++) {
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			copy_main(&copies[started]);
+			fflush(NULL);
+			_exit(copies[started].failed < 255
+				? copies[started].failed
+				: 255);
+		}
+		if (pid < 0) {
+			perror("fork");
+			break;
+		}
+	}
+
+	for (int i = 0; i < started; i++) {
+		int status;
+
+		if (wait(&status) < 0) {
+			break;
+		}
+		failed += WIFEXITED(status) ? WEXITSTATUS(status)
+					    : copies[0].runs;
+	}
+	failed += (ncopies - started) * copies[0].runs;
+
+	return failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	long runs = 1;
+	int ncopies = 1;
+	int processes = 0;
+	const char *trace = NULL;
+	unsigned libs = STDLIBS_ALL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "+n:j:Pt:l:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			runs = atol(optarg);
+			break;
+		case 'j':
+			ncopies = atoi(optarg);
+			break;
+		case 'P':
+			processes = 1;
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		case 'l':
+			if (stdlibs_parse(optarg, &libs) != 0) {
+				fprintf(stderr, "unknown library in %s\n",
+				    optarg);
+				return 2;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	/* Look up the example, `all` by default */
+	const char *name = optind < argc ? argv[optind] : "all";
+	const struct example *ex = examples;
+
+	while (ex->name != NULL && strcmp(ex->name, name) != 0) {
+		ex++;
+	}
+
+	int ex_argc = optind < argc ? argc - optind : 1;
+	char *all_argv[] = { "all", NULL };
+	char **ex_argv = optind < argc ? argv + optind : all_argv;
+
+	if (ex->name == NULL || ex_argc - 1 < ex->min_args || runs < 1 ||
+	    ncopies < 1) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	stdlibs_set_profile(libs);
+
+	/* Servers don't come back */
+	if (ex->flags & EXAMPLE_SERVER) {
+		if (runs > 1 || ncopies > 1 || trace != NULL) {
+			fprintf(stderr, "%s can't be repeated nor traced\n",
+			    ex->name);
+			return 2;
+		}
+		return ex->run(ex_argc, ex_argv);
+	}
+
+	/* The trace lives in this process, forked copies would lose it */
+	if (trace != NULL && processes && ncopies > 1) {
+		fprintf(stderr, "-t can't trace process copies\n");
+		return 2;
+	}
+	cotrace_enable(trace != NULL);
+
+	struct copy *copies = calloc(ncopies, sizeof(*copies));
+
+	if (copies == NULL) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (int i = 0; i < ncopies; i++) {
+		copies[i] = (struct copy) { ex, ex_argc, ex_argv, runs, i, 0 };
+	}
+
+	struct timespec wall0, wall1;
+	struct rusage ru;
+	long failed;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall0);
+	if (ncopies == 1) {
+		copy_main(&copies[0]);
+		failed = copies[0].failed;
+	} else if (processes) {
+		failed = run_processes(copies, ncopies);
+	} else {
+		failed = run_threads(copies, ncopies);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &wall1);
+	/* A single copy ran here even with -P */
+	getrusage(processes && ncopies > 1 ? RUSAGE_CHILDREN : RUSAGE_SELF,
+	    &ru);
+
+	double wall = elapsed_ms(&wall0, &wall1);
+
+	fprintf(stderr,
+	    "%s: %ld runs in %.3f ms (%.1f runs/s), %ld failed, "
+	    "cpu %.3f ms, max rss %ld KB\n",
+	    ex->name, runs * ncopies, wall, runs * ncopies / (wall / 1e3),
+	    failed, rusage_cpu_ms(&ru), ru.ru_maxrss);
+
+	free(copies);
+
+	if (trace != NULL) {
+		size_t len = strlen(trace);
+		int prom = len > 5 && strcmp(trace + len - 5, ".prom") == 0;
+
+		if (cotrace_dump(trace,
+			prom ? COTRACE_PROMETHEUS : COTRACE_JSON) != 0) {
+			perror(trace);
+			return 1;
+		}
+	}
+
+	return failed > 0;
+}
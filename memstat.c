@@ -0,0 +1,290 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+
+#include "memstat.h"
+
+/* Wrapper state, the `ud` of memstat_alloc */
+struct counter {
+	lua_Alloc f;
+	void *ud;
+	struct memstat stats;
+};
+
+static int
+size_class(size_t size)
+{
+	int i = 0;
+
+	while (i < MEMSTAT_CLASSES - 1 && size > (size_t)16 << i) {
+		i++;
+	}
+
+	return i;
+}
+
+static void *
+memstat_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	struct counter *c = ud;
+	struct memstat *s = &c->stats;
+
+	/* Without a block, osize encodes the object type */
+	size_t old = ptr ? osize : 0;
+	void *block = c->f(c->ud, ptr, osize, nsize);
+
+	if (nsize == 0) {
+		if (ptr != NULL) {
+			s->current -= old;
+			s->frees++;
+		}
+		return block;
+	}
+
+	if (block == NULL) {
+		s->failures++;
+		return NULL;
+	}
+
+	if (ptr == NULL) {
+		s->allocs++;
+	} else {
+		s->reallocs++;
+	}
+	if (nsize > old) {
+		s->classes[size_class(nsize)]++;
+	}
+
+	s->current += nsize - old;
+	if (s->current > s->peak) {
+		s->peak = s->current;
+	}
+
+	return block;
+}
+
+static struct counter *
+get_counter(lua_State *L)
+{
+	void *ud;
+
+	if (lua_getallocf(L, &ud) != memstat_alloc) {
+		return NULL;
+	}
+
+	return ud;
+}
+
+int
+memstat_attach(lua_State *L)
+{
+	if (get_counter(L) != NULL) {
+		return 0;
+	}
+
+	struct counter *c = calloc(1, sizeof(*c));
+
+	if (c == NULL) {
+		return -1;
+	}
+
+	c->f = lua_getallocf(L, &c->ud);
+
+	/* What the state holds so far */
+	c->stats.current = (size_t)lua_gc(L, LUA_GCCOUNT) * 1024 +
+	    lua_gc(L, LUA_GCCOUNTB);
+	c->stats.peak = c->stats.current;
+
+	lua_setallocf(L, memstat_alloc, c);
+
+	return 0;
+}
+
+void
+memstat_detach(lua_State *L)
+{
+	struct counter *c = get_counter(L);
+
+	if (c != NULL) {
+		lua_setallocf(L, c->f, c->ud);
+		free(c);
+	}
+}
+
+int
+memstat_get(lua_State *L, struct memstat *stats)
+{
+	struct counter *c = get_counter(L);
+
+	if (c == NULL) {
+		return -1;
+	}
+
+	*stats = c->stats;
+
+	return 0;
+}
+
+void
+memstat_reset_peak(lua_State *L)
+{
+	struct counter *c = get_counter(L);
+
+	if (c != NULL) {
+		c->stats.peak = c->stats.current;
+	}
+}
+
+size_t
+memstat_class_size(int i)
+{
+	return i < MEMSTAT_CLASSES - 1 ? (size_t)16 << i : 0;
+}
+
+int
+memstat_gc_generational(lua_State *L, int minormul, int majormul)
+{
+	return lua_gc(L, LUA_GCGEN, minormul, majormul);
+}
+
+int
+memstat_gc_incremental(lua_State *L, int pause, int stepmul, int stepsize)
+{
+	return lua_gc(L, LUA_GCINC, pause, stepmul, stepsize);
+}
+
+/*
+ * Lua library.
+ */
+
+static void
+set_counter(lua_State *L, const char *name, uint64_t value)
+{
+	lua_pushinteger(L, (lua_Integer)value);
+	lua_setfield(L, -2, name);
+}
+
+static int
+mem_stats(lua_State *L)
+{
+	struct memstat s;
+
+	if (memstat_get(L, &s) != 0) {
+		return luaL_error(L, "memory counters are not attached");
+	}
+
+	lua_createtable(L, 0, 7);
+	set_counter(L, "current", s.current);
+	set_counter(L, "peak", s.peak);
+	set_counter(L, "allocs", s.allocs);
+	set_counter(L, "frees", s.frees);
+	set_counter(L, "reallocs", s.reallocs);
+	set_counter(L, "failures", s.failures);
+
+	lua_createtable(L, MEMSTAT_CLASSES - 1, 1);
+	for (int i = 0; i < MEMSTAT_CLASSES; i++) {
+		size_t size = memstat_class_size(i);
+
+		if (size > 0) {
+			lua_pushinteger(L, (lua_Integer)size);
+		} else {
+			lua_pushliteral(L, "large");
+		}
+		lua_pushinteger(L, (lua_Integer)s.classes[i]);
+		lua_rawset(L, -3);
+	}
+	lua_setfield(L, -2, "classes");
+
+	return 1;
+}
+
+static int
+mem_reset_peak(lua_State *L)
+{
+	memstat_reset_peak(L);
+
+	return 0;
+}
+
+static int
+mem_gc(lua_State *L)
+{
+	static const char *const modes[] = { "generational", "incremental",
+		NULL };
+	int mode = luaL_checkoption(L, 1, NULL, modes);
+	int a = (int)luaL_optinteger(L, 2, 0);
+	int b = (int)luaL_optinteger(L, 3, 0);
+	int previous;
+
+	if (mode == 0) {
+		previous = memstat_gc_generational(L, a, b);
+	} else {
+		previous = memstat_gc_incremental(L, a, b,
+		    (int)luaL_optinteger(L, 4, 0));
+	}
+
+	lua_pushstring(L, modes[previous == LUA_GCGEN ? 0 : 1]);
+
+	return 1;
+}
+
+static int
+mem_step(lua_State *L)
+{
+	int kbytes = (int)luaL_optinteger(L, 1, 0);
+
+	lua_pushboolean(L, lua_gc(L, LUA_GCSTEP, kbytes));
+
+	return 1;
+}
+
+static const luaL_Reg memstat_funcs[] = {
+	{ "stats", mem_stats },
+	{ "reset_peak", mem_reset_peak },
+	{ "gc", mem_gc },
+	{ "step", mem_step },
+	{ NULL, NULL },
+};
+
+int
+luaopen_memstat(lua_State *L)
+{
+	if (memstat_attach(L) != 0) {
+		return luaL_error(L, "can't attach the memory counters");
+	}
+
+	luaL_newlib(L, memstat_funcs);
+
+	return 1;
+}
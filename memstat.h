@@ -0,0 +1,110 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lua.h>
+
+/*
+ * Size classes of the allocation counters: class i counts the blocks of
+ * up to 16 << i bytes, the last one every bigger block.
+ */
+#define MEMSTAT_CLASSES 12
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Per-state memory accounting.
+ *
+ * memstat_attach wraps the allocation function of a state with one that
+ * counts what goes through it and forwards to the original. The counters
+ * start from the memory the state already uses.
+ */
+
+struct memstat {
+	size_t current;	   /* bytes in use */
+	size_t peak;	   /* highest `current` seen */
+	uint64_t allocs;   /* new blocks */
+	uint64_t frees;	   /* released blocks */
+	uint64_t reallocs; /* resized blocks */
+	uint64_t failures; /* requests the allocator refused */
+
+	/* New and grown blocks by size class */
+	uint64_t classes[MEMSTAT_CLASSES];
+};
+
+/* Start counting in L. Returns 0 (also if already counting) or -1. */
+int memstat_attach(lua_State *L);
+
+/* Give L its original allocation function back, before lua_close. */
+void memstat_detach(lua_State *L);
+
+/* Copy the counters of L. Returns -1 if L isn't being counted. */
+int memstat_get(lua_State *L, struct memstat *stats);
+
+/* Restart the peak from the current usage. */
+void memstat_reset_peak(lua_State *L);
+
+/* Upper bound of size class `i`, 0 for the last one. */
+size_t memstat_class_size(int i);
+
+/*
+ * Switch the collector to generational or incremental mode, a parameter
+ * of 0 keeps its current value. Both return the previous mode, LUA_GCGEN
+ * or LUA_GCINC.
+ */
+int memstat_gc_generational(lua_State *L, int minormul, int majormul);
+int memstat_gc_incremental(lua_State *L, int pause, int stepmul,
+    int stepsize);
+
+/*
+ * Open the `memstat` library, counting starts with it:
+ *
+ *   memstat.stats()        table with the counters, `classes` maps the
+ *                          class upper bound (or "large") to its count
+ *   memstat.reset_peak()
+ *   memstat.gc("generational" [, minormul [, majormul]])
+ *   memstat.gc("incremental" [, pause [, stepmul [, stepsize]]])
+ *                          both return the previous mode
+ *   memstat.step([kbytes]) one bounded collection step, true if a
+ *                          cycle ended
+ */
+int luaopen_memstat(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MEMSTAT_H */
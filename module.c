@@ -0,0 +1,83 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "examples.h"
+#include "module.h"
+
+/* The registry keys are the module descriptors themselves */
+
+void *
+module_open(lua_State *L, const struct module *m)
+{
+	void *ctx;
+
+	if (lua_rawgetp(L, LUA_REGISTRYINDEX, m) == LUA_TUSERDATA) {
+		ctx = lua_touserdata(L, -1);
+	} else {
+		lua_pop(L, 1);
+		ctx = lua_newuserdatauv(L, m->context_size, 0);
+		memset(ctx, 0, m->context_size);
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, m);
+	}
+
+	/* The context is on top, shared by every function */
+	if (m->name != NULL) {
+		lua_newtable(L);
+		lua_insert(L, -2);
+		luaL_setfuncs(L, m->funcs, 1);
+		lua_setglobal(L, m->name);
+	} else {
+		lua_pushglobaltable(L);
+		lua_insert(L, -2);
+		luaL_setfuncs(L, m->funcs, 1);
+		lua_pop(L, 1);
+	}
+
+	return ctx;
+}
+
+void *
+module_context(lua_State *L, const struct module *m)
+{
+	void *ctx = NULL;
+
+	if (lua_rawgetp(L, LUA_REGISTRYINDEX, m) == LUA_TUSERDATA) {
+		ctx = lua_touserdata(L, -1);
+	}
+	lua_pop(L, 1);
+
+	return ctx;
+}
@@ -0,0 +1,87 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * C modules with per-state context.
+ *
+ * A module is a static description: its functions and the size of the
+ * context every state opening it gets. The context is a userdata owned by
+ * the state (anchored in the registry, collected with it) and it's the
+ * first upvalue of every function, so they never touch process globals
+ * and any number of states can use the module from different threads.
+ *
+ *   struct counter { int n; };
+ *
+ *   static int
+ *   count(lua_State *L)
+ *   {
+ *       struct counter *c = module_upvalue(L);
+ *       ...
+ *   }
+ *
+ *   static const luaL_Reg counter_funcs[] = { { "count", count }, ... };
+ *   static const struct module counter_module = {
+ *       "counter", counter_funcs, sizeof(struct counter)
+ *   };
+ */
+struct module {
+	const char *name;      /* global table, NULL to set globals */
+	const luaL_Reg *funcs; /* context as upvalue 1 */
+	size_t context_size;   /* zero filled on open */
+};
+
+/*
+ * Open `m` in L: create its context (kept if already open) and install
+ * its functions. Returns the context.
+ */
+void *module_open(lua_State *L, const struct module *m);
+
+/* Context of `m` in L (or any of its threads), NULL if not open. */
+void *module_context(lua_State *L, const struct module *m);
+
+/* Context of the running module function. */
+#define module_upvalue(L) lua_touserdata(L, lua_upvalueindex(1))
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MODULE_H */
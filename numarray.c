@@ -0,0 +1,774 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "examples.h"
+#include "numarray.h"
+
+#define NUMARRAY_METATABLE "numarray"
+
+#define NTYPES 3
+
+/*
+ * Kernels are written once with GCC vector extensions, 32 bytes wide,
+ * and compiled for every instruction set: AVX2 runs them in one register,
+ * the x86-64 baseline (SSE2) in two halves. Integer sums and products wrap
+ * around as in Lua, so they are done on unsigned lanes.
+ */
+
+#define VEC_BYTES 32
+
+typedef double f64_vec __attribute__((vector_size(VEC_BYTES)));
+typedef float f32_vec __attribute__((vector_size(VEC_BYTES)));
+typedef int64_t i64_vec __attribute__((vector_size(VEC_BYTES)));
+typedef uint64_t u64_vec __attribute__((vector_size(VEC_BYTES)));
+typedef int32_t i32_vec __attribute__((vector_size(VEC_BYTES)));
+
+/* Same signatures for every element type, selected by array type */
+struct kernels {
+	void (*sum)(const void *x, size_t n, void *out);
+	void (*minmax)(const void *x, size_t n, void *min, void *max);
+	void (*dot)(const void *x, const void *y, size_t n, void *out);
+	void (*scale)(void *x, size_t n, const void *k);
+	void (*add)(void *x, const void *y, size_t n);
+};
+
+struct kernel_set {
+	const char *isa;
+	struct kernels k[NTYPES];
+};
+
+/*
+ * T element, VT its vector, U/UT the type computations are done in (T,
+ * or unsigned for integers) and MT the comparison mask vector.
+ */
+#define KERNELS(NAME, T, VT, U, UT, MT, ISA, ATTR)                             \
+	static ATTR void sum_##NAME##_##ISA(const void *px, size_t n,         \
+	    void *out)                                                         \
+	{                                                                      \
+		const T *x = px;                                               \
+		const size_t l = sizeof(VT) / sizeof(T);                       \
+		UT a0 = { 0 }, a1 = { 0 };                                     \
+		size_t i = 0;                                                  \
+		U s = 0;                                                       \
+                                                                               \
+		for (; i + 2 * l <= n; i += 2 * l) {                           \
+			VT v0, v1;                                             \
+			memcpy(&v0, x + i, sizeof(v0));                        \
+			memcpy(&v1, x + i + l, sizeof(v1));                    \
+			a0 += (UT)v0;                                          \
+			a1 += (UT)v1;                                          \
+		}                                                              \
+		a0 += a1;                                                      \
+		for (size_t k = 0; k < l; k++) {                               \
+			s += a0[k];                                            \
+		}                                                              \
+		for (; i < n; i++) {                                           \
+			s += (U)x[i];                                          \
+		}                                                              \
+		*(T *)out = (T)s;                                              \
+	}                                                                      \
+                                                                               \
+	static ATTR void minmax_##NAME##_##ISA(const void *px, size_t n,      \
+	    void *min, void *max)                                              \
+	{                                                                      \
+		const T *x = px;                                               \
+		const size_t l = sizeof(VT) / sizeof(T);                       \
+		T mn = x[0], mx = x[0];                                        \
+		size_t i = 0;                                                  \
+                                                                               \
+		if (n >= l) {                                                  \
+			VT lo, hi;                                             \
+			memcpy(&lo, x, sizeof(lo));                            \
+			hi = lo;                                               \
+			for (i = l; i + l <= n; i += l) {                      \
+				VT v;                                          \
+				MT m;                                          \
+				memcpy(&v, x + i, sizeof(v));                  \
+				m = v < lo;                                    \
+				lo = (VT)(((MT)v & m) | ((MT)lo & ~m));        \
+				m = v > hi;                                    \
+				hi = (VT)(((MT)v & m) | ((MT)hi & ~m));        \
+			}                                                      \
+			for (size_t k = 0; k < l; k++) {                       \
+				mn = lo[k] < mn ? lo[k] : mn;                  \
+				mx = hi[k] > mx ? hi[k] : mx;                  \
+			}                                                      \
+		}                                                              \
+		for (; i < n; i++) {                                           \
+			mn = x[i] < mn ? x[i] : mn;                            \
+			mx = x[i] > mx ? x[i] : mx;                            \
+		}                                                              \
+		*(T *)min = mn;                                                \
+		*(T *)max = mx;                                                \
+	}                                                                      \
+                                                                               \
+	static ATTR void dot_##NAME##_##ISA(const void *px, const void *py,   \
+	    size_t n, void *out)                                               \
+	{                                                                      \
+		const T *x = px, *y = py;                                      \
+		const size_t l = sizeof(VT) / sizeof(T);                       \
+		UT a0 = { 0 }, a1 = { 0 };                                     \
+		size_t i = 0;                                                  \
+		U s = 0;                                                       \
+                                                                               \
+		for (; i + 2 * l <= n; i += 2 * l) {                           \
+			VT x0, x1, y0, y1;                                     \
+			memcpy(&x0, x + i, sizeof(x0));                        \
+			memcpy(&x1, x + i + l, sizeof(x1));                    \
+			memcpy(&y0, y + i, sizeof(y0));                        \
+			memcpy(&y1, y + i + l, sizeof(y1));                    \
+			a0 += (UT)x0 * (UT)y0;                                 \
+			a1 += (UT)x1 * (UT)y1;                                 \
+		}                                                              \
+		a0 += a1;                                                      \
+		for (size_t k = 0; k < l; k++) {                               \
+			s += a0[k];                                            \
+		}                                                              \
+		for (; i < n; i++) {                                           \
+			s += (U)x[i] * (U)y[i];                                \
+		}                                                              \
+		*(T *)out = (T)s;                                              \
+	}                                                                      \
+                                                                               \
+	static ATTR void scale_##NAME##_##ISA(void *px, size_t n,             \
+	    const void *pk)                                                    \
+	{                                                                      \
+		T *x = px;                                                     \
+		const size_t l = sizeof(VT) / sizeof(T);                       \
+		const U k = (U)*(const T *)pk;                                 \
+		size_t i = 0;                                                  \
+                                                                               \
+		for (; i + l <= n; i += l) {                                   \
+			VT v;                                                  \
+			memcpy(&v, x + i, sizeof(v));                          \
+			v = (VT)((UT)v * k);                                   \
+			memcpy(x + i, &v, sizeof(v));                          \
+		}                                                              \
+		for (; i < n; i++) {                                           \
+			x[i] = (T)((U)x[i] * k);                               \
+		}                                                              \
+	}                                                                      \
+                                                                               \
+	static ATTR void add_##NAME##_##ISA(void *px, const void *py,         \
+	    size_t n)                                                          \
+	{                                                                      \
+		T *x = px;                                                     \
+		const T *y = py;                                               \
+		const size_t l = sizeof(VT) / sizeof(T);                       \
+		size_t i = 0;                                                  \
+                                                                               \
+		for (; i + l <= n; i += l) {                                   \
+			VT a, b;                                               \
+			memcpy(&a, x + i, sizeof(a));                          \
+			memcpy(&b, y + i, sizeof(b));                          \
+			a = (VT)((UT)a + (UT)b);                               \
+			memcpy(x + i, &a, sizeof(a));                          \
+		}                                                              \
+		for (; i < n; i++) {                                           \
+			x[i] = (T)((U)x[i] + (U)y[i]);                         \
+		}                                                              \
+	}
+
+#define KERNEL_ENTRY(NAME, ISA)                                                \
+	{                                                                      \
+		sum_##NAME##_##ISA, minmax_##NAME##_##ISA, dot_##NAME##_##ISA, \
+		    scale_##NAME##_##ISA, add_##NAME##_##ISA                   \
+	}
+
+/* Every element type for one instruction set, in NUMARRAY_* order */
+#define KERNEL_SET(ISA, ATTR)                                                  \
+	KERNELS(f64, double, f64_vec, double, f64_vec, i64_vec, ISA, ATTR)     \
+	KERNELS(i64, int64_t, i64_vec, uint64_t, u64_vec, i64_vec, ISA, ATTR)  \
+	KERNELS(f32, float, f32_vec, float, f32_vec, i32_vec, ISA, ATTR)       \
+                                                                               \
+	static const struct kernel_set kernels_##ISA = { #ISA,                 \
+		{ KERNEL_ENTRY(f64, ISA), KERNEL_ENTRY(i64, ISA),              \
+		    KERNEL_ENTRY(f32, ISA) } };
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_X86_KERNELS
+KERNEL_SET(avx2, __attribute__((target("avx2"))))
+KERNEL_SET(sse2, )
+#else
+KERNEL_SET(generic, )
+#endif
+
+static const struct kernel_set *active;
+static pthread_once_t active_once = PTHREAD_ONCE_INIT;
+
+/* Set the kernels for `isa`, the best supported one if NULL */
+static int
+use_isa(const char *isa)
+{
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+
+	int avx2 = __builtin_cpu_supports("avx2");
+
+	if (isa == NULL) {
+		active = avx2 ? &kernels_avx2 : &kernels_sse2;
+	} else if (strcmp(isa, "avx2") == 0 && avx2) {
+		active = &kernels_avx2;
+	} else if (strcmp(isa, "sse2") == 0) {
+		active = &kernels_sse2;
+	} else {
+		return -1;
+	}
+#else
+	if (isa != NULL && strcmp(isa, "generic") != 0) {
+		return -1;
+	}
+	active = &kernels_generic;
+#endif
+
+	return 0;
+}
+
+static void
+select_kernels(void)
+{
+	use_isa(NULL);
+}
+
+static const struct kernels *
+kernels_of(int type)
+{
+	pthread_once(&active_once, select_kernels);
+
+	return &active->k[type];
+}
+
+int
+numarray_use_isa(const char *isa)
+{
+	/* The default choice must not come later and override this one */
+	pthread_once(&active_once, select_kernels);
+
+	return use_isa(isa);
+}
+
+const char *
+numarray_isa(void)
+{
+	pthread_once(&active_once, select_kernels);
+
+	return active->isa;
+}
+
+/*
+ * Arrays
+ */
+
+/* One element of any type */
+union value {
+	double f64;
+	int64_t i64;
+	float f32;
+};
+
+static const char *const type_names[] = { "f64", "i64", "f32", NULL };
+static const size_t type_sizes[] = { sizeof(double), sizeof(int64_t),
+	sizeof(float) };
+
+/* Longest array of `type` whose userdata size doesn't overflow */
+static size_t
+max_len(int type)
+{
+	return (SIZE_MAX - sizeof(struct numarray) - NUMARRAY_ALIGN) /
+	    type_sizes[type];
+}
+
+struct numarray *
+numarray_new(lua_State *L, int type, size_t len)
+{
+	size_t bytes = len * type_sizes[type];
+
+	if (len > max_len(type)) {
+		luaL_error(L, "array too large");
+	}
+
+	/* Room to align the storage right after the header */
+	struct numarray *a = lua_newuserdatauv(L,
+	    sizeof(*a) + bytes + NUMARRAY_ALIGN, 1);
+	uintptr_t p = (uintptr_t)(a + 1);
+
+	p = (p + NUMARRAY_ALIGN - 1) & ~(uintptr_t)(NUMARRAY_ALIGN - 1);
+	a->type = type;
+	a->len = len;
+	a->data = (void *)p;
+	memset(a->data, 0, bytes);
+	luaL_setmetatable(L, NUMARRAY_METATABLE);
+
+	return a;
+}
+
+struct numarray *
+numarray_check(lua_State *L, int idx)
+{
+	return luaL_checkudata(L, idx, NUMARRAY_METATABLE);
+}
+
+static void *
+element(struct numarray *a, size_t i)
+{
+	return (char *)a->data + i * type_sizes[a->type];
+}
+
+static void
+push_value(lua_State *L, int type, const void *p)
+{
+	switch (type) {
+	case NUMARRAY_F64:
+		lua_pushnumber(L, *(const double *)p);
+		break;
+	case NUMARRAY_I64:
+		lua_pushinteger(L, *(const int64_t *)p);
+		break;
+	default:
+		lua_pushnumber(L, *(const float *)p);
+		break;
+	}
+}
+
+/* Convert the argument `arg` to an element (any of the types) */
+static void
+check_value(lua_State *L, int arg, int type, void *p)
+{
+	switch (type) {
+	case NUMARRAY_F64:
+		*(double *)p = luaL_checknumber(L, arg);
+		break;
+	case NUMARRAY_I64:
+		*(int64_t *)p = luaL_checkinteger(L, arg);
+		break;
+	default:
+		*(float *)p = luaL_checknumber(L, arg);
+		break;
+	}
+}
+
+static int
+check_type(lua_State *L, int arg)
+{
+	return luaL_checkoption(L, arg, "f64", type_names);
+}
+
+/* Second operand, same type and length */
+static struct numarray *
+check_operand(lua_State *L, struct numarray *a, int arg)
+{
+	struct numarray *b = numarray_check(L, arg);
+
+	luaL_argcheck(L, b->type == a->type, arg, "element types differ");
+	luaL_argcheck(L, b->len == a->len, arg, "lengths differ");
+
+	return b;
+}
+
+static int
+na_new(lua_State *L)
+{
+	lua_Integer n = luaL_checkinteger(L, 1);
+	int type = check_type(L, 2);
+
+	luaL_argcheck(L, n >= 0, 1, "negative length");
+	luaL_argcheck(L, (lua_Unsigned)n <= max_len(type), 1,
+	    "array too large");
+	numarray_new(L, type, n);
+
+	return 1;
+}
+
+static int
+na_from(lua_State *L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	int type = check_type(L, 2);
+	lua_Integer n = luaL_len(L, 1);
+
+	luaL_argcheck(L, n >= 0 && (lua_Unsigned)n <= max_len(type), 1,
+	    "bad length");
+
+	struct numarray *a = numarray_new(L, type, n);
+
+	for (lua_Integer i = 0; i < n; i++) {
+		lua_geti(L, 1, i + 1);
+		check_value(L, -1, type, element(a, i));
+		lua_pop(L, 1);
+	}
+
+	return 1;
+}
+
+static int
+na_isa(lua_State *L)
+{
+	lua_pushstring(L, numarray_isa());
+
+	return 1;
+}
+
+/* 1-based index, or 0 if out of range */
+static size_t
+check_index(lua_State *L, struct numarray *a, int arg)
+{
+	lua_Integer i = luaL_checkinteger(L, arg);
+
+	return i >= 1 && (lua_Unsigned)i <= a->len ? (size_t)i : 0;
+}
+
+static int
+na_index(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+
+	if (lua_type(L, 2) != LUA_TNUMBER) {
+		/* Methods */
+		lua_getmetatable(L, 1);
+		lua_pushvalue(L, 2);
+		lua_rawget(L, -2);
+		return 1;
+	}
+
+	size_t i = check_index(L, a, 2);
+
+	if (i == 0) {
+		lua_pushnil(L);
+	} else {
+		push_value(L, a->type, element(a, i - 1));
+	}
+
+	return 1;
+}
+
+static int
+na_newindex(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	size_t i = check_index(L, a, 2);
+
+	luaL_argcheck(L, i != 0, 2, "index out of range");
+	check_value(L, 3, a->type, element(a, i - 1));
+
+	return 0;
+}
+
+static int
+na_len(lua_State *L)
+{
+	lua_pushinteger(L, numarray_check(L, 1)->len);
+
+	return 1;
+}
+
+static int
+na_tostring(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+
+	lua_pushfstring(L, "numarray(%s, %I)", type_names[a->type],
+	    (lua_Integer)a->len);
+
+	return 1;
+}
+
+static int
+na_sum(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	union value out;
+
+	kernels_of(a->type)->sum(a->data, a->len, &out);
+	push_value(L, a->type, &out);
+
+	return 1;
+}
+
+static int
+minmax(lua_State *L, int max)
+{
+	struct numarray *a = numarray_check(L, 1);
+	union value lo, hi;
+
+	if (a->len == 0) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	kernels_of(a->type)->minmax(a->data, a->len, &lo, &hi);
+	push_value(L, a->type, max ? &hi : &lo);
+
+	return 1;
+}
+
+static int
+na_min(lua_State *L)
+{
+	return minmax(L, 0);
+}
+
+static int
+na_max(lua_State *L)
+{
+	return minmax(L, 1);
+}
+
+static int
+na_dot(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	struct numarray *b = check_operand(L, a, 2);
+	union value out;
+
+	kernels_of(a->type)->dot(a->data, b->data, a->len, &out);
+	push_value(L, a->type, &out);
+
+	return 1;
+}
+
+static int
+na_scale(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	union value k;
+
+	check_value(L, 2, a->type, &k);
+	kernels_of(a->type)->scale(a->data, a->len, &k);
+	lua_settop(L, 1);
+
+	return 1;
+}
+
+static int
+na_add(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	struct numarray *b = check_operand(L, a, 2);
+
+	/* With overlapping views of one array the result depends on the ISA */
+	kernels_of(a->type)->add(a->data, b->data, a->len);
+	lua_settop(L, 1);
+
+	return 1;
+}
+
+/*
+ * Running sums and filters carry a dependency from one element to the
+ * next, they're plain loops.
+ */
+
+#define PREFIX_SUM(T, U, x, n)                                                 \
+	do {                                                                   \
+		T *p = (x);                                                    \
+		U s = 0;                                                       \
+		for (size_t i = 0; i < (n); i++) {                             \
+			s += (U)p[i];                                          \
+			p[i] = (T)s;                                           \
+		}                                                              \
+	} while (0)
+
+/* Branchless compaction: always store, advance only on a match */
+#define FILTER(T, x, n, lo, hi, out, count)                                    \
+	do {                                                                   \
+		const T *p = (x);                                              \
+		T *q = (out);                                                  \
+		T l, h;                                                        \
+		size_t j = 0;                                                  \
+		memcpy(&l, (lo), sizeof(l));                                   \
+		memcpy(&h, (hi), sizeof(h));                                   \
+		for (size_t i = 0; i < (n); i++) {                             \
+			q[j] = p[i];                                           \
+			j += (p[i] >= l) & (p[i] <= h);                        \
+		}                                                              \
+		(count) = j;                                                   \
+	} while (0)
+
+static int
+na_prefix_sum(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+
+	switch (a->type) {
+	case NUMARRAY_F64:
+		PREFIX_SUM(double, double, a->data, a->len);
+		break;
+	case NUMARRAY_I64:
+		PREFIX_SUM(int64_t, uint64_t, a->data, a->len);
+		break;
+	default:
+		PREFIX_SUM(float, float, a->data, a->len);
+		break;
+	}
+	lua_settop(L, 1);
+
+	return 1;
+}
+
+static int
+na_filter(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	union value lo, hi;
+	size_t count;
+
+	check_value(L, 2, a->type, &lo);
+	check_value(L, 3, a->type, &hi);
+
+	/* Compact into a worst case scratch, then copy out the matches */
+	struct numarray *out = numarray_new(L, a->type, a->len);
+
+	switch (a->type) {
+	case NUMARRAY_F64:
+		FILTER(double, a->data, a->len, &lo, &hi, out->data, count);
+		break;
+	case NUMARRAY_I64:
+		FILTER(int64_t, a->data, a->len, &lo, &hi, out->data, count);
+		break;
+	default:
+		FILTER(float, a->data, a->len, &lo, &hi, out->data, count);
+		break;
+	}
+
+	/* Right sized, so a sparse result doesn't pin the scratch */
+	struct numarray *res = numarray_new(L, a->type, count);
+
+	memcpy(res->data, out->data, count * type_sizes[a->type]);
+	lua_remove(L, -2);
+
+	return 1;
+}
+
+static int
+na_slice(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+	lua_Integer len = a->len;
+	lua_Integer i = luaL_checkinteger(L, 2);
+	lua_Integer j = luaL_optinteger(L, 3, -1);
+
+	/* Same rules as string.sub */
+	if (i < 0) {
+		i = len + i + 1 > 0 ? len + i + 1 : 1;
+	} else if (i == 0) {
+		i = 1;
+	}
+	if (j < 0) {
+		j = len + j + 1;
+	} else if (j > len) {
+		j = len;
+	}
+
+	struct numarray *v = lua_newuserdatauv(L, sizeof(*v), 1);
+
+	v->type = a->type;
+	v->len = i <= j ? j - i + 1 : 0;
+	v->data = element(a, i <= j ? i - 1 : 0);
+	luaL_setmetatable(L, NUMARRAY_METATABLE);
+
+	/* Keep the storage alive: the array itself, or the one it views */
+	lua_getiuservalue(L, 1, 1);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		lua_pushvalue(L, 1);
+	}
+	lua_setiuservalue(L, -2, 1);
+
+	return 1;
+}
+
+static int
+na_totable(lua_State *L)
+{
+	struct numarray *a = numarray_check(L, 1);
+
+	lua_createtable(L, a->len, 0);
+	for (size_t i = 0; i < a->len; i++) {
+		push_value(L, a->type, element(a, i));
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
+}
+
+static int
+na_type(lua_State *L)
+{
+	lua_pushstring(L, type_names[numarray_check(L, 1)->type]);
+
+	return 1;
+}
+
+static const luaL_Reg numarray_funcs[] = {
+	{ "new", na_new },
+	{ "from", na_from },
+	{ "isa", na_isa },
+	{ NULL, NULL },
+};
+
+static const luaL_Reg numarray_meta[] = {
+	{ "__index", na_index },
+	{ "__newindex", na_newindex },
+	{ "__len", na_len },
+	{ "__tostring", na_tostring },
+	{ "sum", na_sum },
+	{ "min", na_min },
+	{ "max", na_max },
+	{ "dot", na_dot },
+	{ "scale", na_scale },
+	{ "add", na_add },
+	{ "prefix_sum", na_prefix_sum },
+	{ "filter", na_filter },
+	{ "slice", na_slice },
+	{ "totable", na_totable },
+	{ "type", na_type },
+	{ NULL, NULL },
+};
+
+int
+luaopen_numarray(lua_State *L)
+{
+	/* Methods live in the metatable, __index finds them there */
+	if (luaL_newmetatable(L, NUMARRAY_METATABLE)) {
+		luaL_setfuncs(L, numarray_meta, 0);
+	}
+	lua_pop(L, 1);
+
+	luaL_newlib(L, numarray_funcs);
+
+	return 1;
+}
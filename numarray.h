@@ -0,0 +1,102 @@
+#ifndef NUMARRAY_H
+#define NUMARRAY_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+/* Element types */
+#define NUMARRAY_F64 0
+#define NUMARRAY_I64 1
+#define NUMARRAY_F32 2
+
+/* Alignment of the array storage, in bytes. */
+#define NUMARRAY_ALIGN 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Typed numeric arrays.
+ *
+ * Contiguous aligned float64, int64 or float32 storage in a userdata, with
+ * kernels (sum, min/max, dot, scale, add) compiled for AVX2 and for the
+ * baseline instruction set and picked at runtime from what the CPU
+ * supports. Slices are views sharing the storage of their array.
+ *
+ * The `numarray` library:
+ *
+ *   numarray.new(n [, type])     zero filled, type "f64" (default),
+ *                                "i64" or "f32"
+ *   numarray.from(t [, type])    copy of the sequence t
+ *   numarray.isa()               kernels in use: "avx2", "sse2" or
+ *                                "generic"
+ *   #a, a[i], a[i] = v           1-based element access
+ *   a:sum(), a:min(), a:max(), a:dot(b)
+ *   a:scale(k), a:add(b)         in place, return a
+ *   a:prefix_sum()               in place running sum, returns a
+ *   a:filter(lo, hi)             new array of the elements in [lo, hi]
+ *   a:slice(i [, j])             view of a[i..j] (negative from the end)
+ *   a:totable(), a:type()
+ */
+
+struct numarray {
+	int type;
+	size_t len;
+	void *data; /* in the array's own userdata, or its parent for views */
+};
+
+/* Push a new zero filled array of `len` elements of `type`. */
+struct numarray *numarray_new(lua_State *L, int type, size_t len);
+
+/* Return the array at `idx` or raise an error. */
+struct numarray *numarray_check(lua_State *L, int idx);
+
+/*
+ * Select the kernels, "avx2", "sse2" or "generic" (NULL picks the best
+ * supported, as on startup). Returns -1 if the CPU can't run them. Meant
+ * for benchmarks, not safe while other threads use arrays.
+ */
+int numarray_use_isa(const char *isa);
+
+/* Name of the kernels in use. */
+const char *numarray_isa(void);
+
+/* Open the `numarray` library. */
+int luaopen_numarray(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* NUMARRAY_H */
@@ -0,0 +1,473 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "examples.h"
+#include "module.h"
+#include "outbuf.h"
+#include "stdlibs.h"
+
+/*
+ * The buffer is the module context of the state. Large strings are kept
+ * alive by an anchor table (registry[buffer address]), one slot per
+ * piece; slots are reused after a flush, so at most OUTBUF_IOV strings
+ * stay anchored longer than needed.
+ */
+struct outbuf {
+	int fd;
+	size_t flush_size;
+	int flush_ms;
+	uint64_t oldest; /* ms, when the first pending byte came */
+	size_t pending;	 /* bytes in iov */
+	int niov;
+	int nanchors;
+	struct iovec iov[OUTBUF_IOV];
+	size_t used; /* of buf */
+	char buf[OUTBUF_SIZE];
+};
+
+static uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+
+	/* Tick precision is plenty and it's cheaper to read */
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int
+extends(const struct outbuf *b, const char *p)
+{
+	if (b->niov == 0) {
+		return 0;
+	}
+
+	const struct iovec *last = &b->iov[b->niov - 1];
+
+	return (const char *)last->iov_base + last->iov_len == p;
+}
+
+/* Append a piece, the caller made room for it */
+static void
+add(struct outbuf *b, const char *p, size_t len)
+{
+	if (b->pending == 0) {
+		b->oldest = now_ms();
+	}
+
+	if (extends(b, p)) {
+		b->iov[b->niov - 1].iov_len += len;
+	} else {
+		b->iov[b->niov].iov_base = (void *)p;
+		b->iov[b->niov].iov_len = len;
+		b->niov++;
+	}
+	b->pending += len;
+}
+
+/* Flush if a piece starting at `p` wouldn't fit */
+static int
+reserve(struct outbuf *b, const char *p)
+{
+	if (b->niov == OUTBUF_IOV && !extends(b, p)) {
+		return outbuf_flush(b);
+	}
+
+	return 0;
+}
+
+/* Flush when the thresholds are reached */
+static int
+check(struct outbuf *b)
+{
+	if (b->pending >= b->flush_size ||
+	    (b->pending > 0 && now_ms() - b->oldest >= (uint64_t)b->flush_ms)) {
+		return outbuf_flush(b);
+	}
+
+	return 0;
+}
+
+static int
+copy(struct outbuf *b, const char *s, size_t len)
+{
+	while (len > 0) {
+		if (b->used == OUTBUF_SIZE && outbuf_flush(b) != 0) {
+			return -1;
+		}
+		if (reserve(b, b->buf + b->used) != 0) {
+			return -1;
+		}
+
+		size_t n = OUTBUF_SIZE - b->used;
+
+		n = n < len ? n : len;
+		memcpy(b->buf + b->used, s, n);
+		add(b, b->buf + b->used, n);
+		b->used += n;
+		s += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* The string at `idx`, referenced in place if it's large */
+static int
+write_string(lua_State *L, struct outbuf *b, int idx)
+{
+	size_t len;
+	const char *s = lua_tolstring(L, idx, &len);
+
+	if (len < OUTBUF_LARGE) {
+		return copy(b, s, len);
+	}
+
+	if (reserve(b, s) != 0) {
+		return -1;
+	}
+
+	idx = lua_absindex(L, idx);
+	lua_rawgetp(L, LUA_REGISTRYINDEX, b);
+	lua_pushvalue(L, idx);
+	lua_rawseti(L, -2, ++b->nanchors);
+	lua_pop(L, 1);
+
+	add(b, s, len);
+
+	return 0;
+}
+
+int
+outbuf_write(struct outbuf *b, const char *s, size_t len)
+{
+	if (copy(b, s, len) != 0) {
+		return -1;
+	}
+
+	return check(b);
+}
+
+int
+outbuf_printf(struct outbuf *b, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	/* Straight into the buffer when it fits */
+	if (b->used == OUTBUF_SIZE && outbuf_flush(b) != 0) {
+		return -1;
+	}
+
+	size_t room = OUTBUF_SIZE - b->used;
+
+	va_start(ap, fmt);
+	n = vsnprintf(b->buf + b->used, room, fmt, ap);
+	va_end(ap);
+
+	if (n < 0) {
+		return -1;
+	}
+	if ((size_t)n < room) {
+		if (reserve(b, b->buf + b->used) != 0) {
+			return -1;
+		}
+		/* A flush leaves the text where the buffer starts again */
+		if (b->used == 0) {
+			va_start(ap, fmt);
+			vsnprintf(b->buf, OUTBUF_SIZE, fmt, ap);
+			va_end(ap);
+		}
+		add(b, b->buf + b->used, n);
+		b->used += n;
+		return check(b);
+	}
+
+	/* Too long for the room left, format it apart */
+	char small[256];
+	char *text = (size_t)n < sizeof(small) ? small : malloc(n + 1);
+
+	if (text == NULL) {
+		return -1;
+	}
+	va_start(ap, fmt);
+	vsnprintf(text, n + 1, fmt, ap);
+	va_end(ap);
+
+	int status = outbuf_write(b, text, n);
+
+	if (text != small) {
+		free(text);
+	}
+
+	return status;
+}
+
+int
+outbuf_flush(struct outbuf *b)
+{
+	struct iovec *iov = b->iov;
+	int n = b->niov;
+	int status = 0;
+
+	while (n > 0) {
+		ssize_t w = writev(b->fd, iov, n);
+
+		if (w < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				struct pollfd pfd = { b->fd, POLLOUT, 0 };
+				poll(&pfd, 1, -1);
+				continue;
+			}
+			status = -1; /* what's left is dropped */
+			break;
+		}
+
+		/* Partial write, skip what went out */
+		while (n > 0 && (size_t)w >= iov->iov_len) {
+			w -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char *)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+
+	b->niov = 0;
+	b->nanchors = 0;
+	b->used = 0;
+	b->pending = 0;
+
+	return status;
+}
+
+void
+outbuf_set_flush(struct outbuf *b, size_t size, int ms)
+{
+	b->flush_size = size > 0 && size <= OUTBUF_SIZE ? size : OUTBUF_SIZE;
+	b->flush_ms = ms > 0 ? ms : OUTBUF_FLUSH_MS;
+}
+
+/*
+ * The library
+ */
+
+static int
+out_print(lua_State *L)
+{
+	struct outbuf *b = module_upvalue(L);
+	int n = lua_gettop(L);
+
+	for (int i = 1; i <= n; i++) {
+		luaL_tolstring(L, i, NULL);
+		if (i > 1) {
+			copy(b, "\t", 1);
+		}
+		write_string(L, b, -1);
+		lua_pop(L, 1);
+	}
+	copy(b, "\n", 1);
+	check(b);
+
+	return 0;
+}
+
+/* Buffer the arguments from `first` on as io.write does */
+static int
+write_args(lua_State *L, struct outbuf *b, int first)
+{
+	int n = lua_gettop(L);
+	int status = 0;
+	char num[64];
+
+	for (int i = first; i <= n && status == 0; i++) {
+		if (lua_type(L, i) == LUA_TNUMBER) {
+			int len = lua_isinteger(L, i) ?
+			    snprintf(num, sizeof(num), LUA_INTEGER_FMT,
+				(LUAI_UACINT)lua_tointeger(L, i)) :
+			    snprintf(num, sizeof(num), LUA_NUMBER_FMT,
+				(LUAI_UACNUMBER)lua_tonumber(L, i));
+			status = copy(b, num, len);
+		} else {
+			luaL_checktype(L, i, LUA_TSTRING);
+			status = write_string(L, b, i);
+		}
+	}
+	if (status == 0) {
+		status = check(b);
+	}
+
+	return status;
+}
+
+static int
+out_write(lua_State *L)
+{
+	struct outbuf *b = module_upvalue(L);
+
+	return luaL_fileresult(L, write_args(L, b, 1) == 0, NULL);
+}
+
+/**
+ * io.write replacement. Upvalues: the buffer, the stock io.write,
+ * io.output and the io.stdout file. Buffered only while the default
+ * output is stdout, returns that file like the stock one.
+ */
+static int
+out_io_write(lua_State *L)
+{
+	struct outbuf *b = module_upvalue(L);
+
+	lua_pushvalue(L, lua_upvalueindex(3));
+	lua_call(L, 0, 1);
+	if (!lua_rawequal(L, -1, lua_upvalueindex(4))) {
+		lua_pop(L, 1);
+		lua_pushvalue(L, lua_upvalueindex(2));
+		lua_insert(L, 1);
+		lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+		return lua_gettop(L);
+	}
+	lua_pop(L, 1);
+
+	if (write_args(L, b, 1) != 0) {
+		return luaL_fileresult(L, 0, NULL);
+	}
+	lua_pushvalue(L, lua_upvalueindex(4));
+
+	return 1;
+}
+
+static int
+out_flush(lua_State *L)
+{
+	struct outbuf *b = module_upvalue(L);
+
+	return luaL_fileresult(L, outbuf_flush(b) == 0, NULL);
+}
+
+static int
+out_setflush(lua_State *L)
+{
+	struct outbuf *b = module_upvalue(L);
+	lua_Integer size = luaL_optinteger(L, 1, 0);
+	lua_Integer ms = luaL_optinteger(L, 2, 0);
+
+	outbuf_set_flush(b, size > 0 ? (size_t)size : 0,
+	    ms > 0 && ms < INT32_MAX ? (int)ms : 0);
+
+	return 0;
+}
+
+/* Whatever is left goes out when the state is closed */
+static int
+out_gc(lua_State *L)
+{
+	outbuf_flush(lua_touserdata(L, 1));
+
+	return 0;
+}
+
+static const luaL_Reg outbuf_funcs[] = {
+	{ "print", out_print },
+	{ "write", out_write },
+	{ "flush", out_flush },
+	{ "setflush", out_setflush },
+	{ NULL, NULL },
+};
+
+static const struct module outbuf_module = {
+	"outbuf",
+	outbuf_funcs,
+	sizeof(struct outbuf),
+};
+
+struct outbuf *
+outbuf_open(lua_State *L, int fd)
+{
+	struct outbuf *b = module_open(L, &outbuf_module);
+
+	/* First open: flush_size is still 0 */
+	if (b->flush_size == 0) {
+		b->fd = fd;
+		outbuf_set_flush(b, 0, 0);
+
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &outbuf_module);
+		lua_createtable(L, 0, 1);
+		lua_pushcfunction(L, out_gc);
+		lua_setfield(L, -2, "__gc");
+		lua_setmetatable(L, -2);
+		lua_pop(L, 1);
+
+		lua_createtable(L, OUTBUF_IOV, 0);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, b);
+	}
+
+	return b;
+}
+
+struct outbuf *
+outbuf_get(lua_State *L)
+{
+	return module_context(L, &outbuf_module);
+}
+
+void
+outbuf_install(lua_State *L)
+{
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &outbuf_module);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return;
+	}
+
+	lua_pushvalue(L, -1);
+	lua_pushcclosure(L, out_print, 1);
+	lua_setglobal(L, "print");
+
+	stdlibs_replace_io_write(L, out_io_write);
+}
@@ -0,0 +1,108 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+/* Bytes buffered before a flush (and the copy buffer size). */
+#define OUTBUF_SIZE 65536
+
+/* Age of the oldest buffered byte forcing a flush, in milliseconds. */
+#define OUTBUF_FLUSH_MS 50
+
+/* Strings this long are written from Lua's memory instead of copied. */
+#define OUTBUF_LARGE 1024
+
+/* Pieces of one writev. */
+#define OUTBUF_IOV 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Buffered output of a Lua state.
+ *
+ * Small writes are copied one after the other into a buffer, strings of
+ * OUTBUF_LARGE bytes or more are referenced where Lua keeps them (and
+ * anchored until written), and everything goes out in one writev once
+ * OUTBUF_SIZE bytes are pending, when the oldest pending byte is older
+ * than OUTBUF_FLUSH_MS (checked on writes, there's no timer), on
+ * outbuf_flush, or when the state is closed.
+ *
+ * Writes to the same fd through stdio aren't ordered with these, so
+ * outbuf_install replaces `print` and `io.write` together; io.write
+ * only buffers while io.output() is io.stdout, and returns that file.
+ */
+struct outbuf;
+
+/*
+ * Open the `outbuf` library in L writing to `fd` (kept if already open)
+ * and return the state's buffer:
+ *   outbuf.print(...)            print, buffered
+ *   outbuf.write(...)            io.write, buffered; returns true
+ *   outbuf.flush()
+ *   outbuf.setflush([size [, ms]])
+ */
+struct outbuf *outbuf_open(lua_State *L, int fd);
+
+/* Buffer of L (or any of its threads), NULL if not open. */
+struct outbuf *outbuf_get(lua_State *L);
+
+/*
+ * Make `print` and `io.write` the buffered ones. A lazy io (see stdlibs.h)
+ * isn't built for this, it gets the buffered write when first used.
+ */
+void outbuf_install(lua_State *L);
+
+/* Buffer a copy of `s`. Returns 0 or -1 (errno set) if a flush failed. */
+int outbuf_write(struct outbuf *b, const char *s, size_t len);
+
+/* Buffer formatted output, same results as outbuf_write. */
+int outbuf_printf(struct outbuf *b, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Write everything pending. Returns 0 or -1 (errno set). */
+int outbuf_flush(struct outbuf *b);
+
+/*
+ * Flush thresholds: pending bytes (up to OUTBUF_SIZE) and milliseconds,
+ * 0 for the defaults.
+ */
+void outbuf_set_flush(struct outbuf *b, size_t size, int ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* OUTBUF_H */
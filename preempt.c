@@ -0,0 +1,99 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <lua.h>
+
+#include "cotrace.h"
+#include "examples.h"
+#include "preempt.h"
+#include "profiler.h"
+
+/* Coroutine driven by the innermost preempt_resume of this OS thread. */
+static _Thread_local lua_State *current;
+static _Thread_local int expired;
+
+/**
+ * Count hook, yields the driven coroutine when its quantum is used up.
+ */
+static void
+preempt_hook(lua_State *L, __UNUSED lua_Debug *ar)
+{
+	/* The profiler leaves our hook alone and samples through it */
+	profiler_sample(L);
+
+	/* Nested coroutines inherit the hook, leave them alone */
+	if (L != current || !lua_isyieldable(L)) {
+		return;
+	}
+
+	expired = 1;
+	lua_yield(L, 0);
+}
+
+int
+preempt_resume(lua_State *co, lua_State *from, int nargs, int *nres,
+    int quantum, int *preempted)
+{
+	*preempted = 0;
+
+	if (quantum <= 0) {
+		lua_State *outer_co = profiler_switch(co);
+		int status = cotrace_resume(co, from, nargs, nres);
+
+		profiler_switch(outer_co);
+		return status;
+	}
+
+	lua_Hook hook = lua_gethook(co);
+	int mask = lua_gethookmask(co);
+	int count = lua_gethookcount(co);
+
+	lua_State *outer = current;
+	lua_State *outer_co = profiler_switch(co);
+	int outer_expired = expired;
+
+	current = co;
+	expired = 0;
+
+	/* Setting the hook also restarts the instruction count */
+	lua_sethook(co, preempt_hook, LUA_MASKCOUNT, quantum);
+	int status = cotrace_resume(co, from, nargs, nres);
+
+	profiler_switch(outer_co);
+	lua_sethook(co, hook, mask, count);
+
+	*preempted = status == LUA_YIELD && expired;
+
+	current = outer;
+	expired = outer_expired;
+
+	return status;
+}
@@ -0,0 +1,63 @@
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <lua.h>
+
+/* Instructions a coroutine may run before it's preempted by default. */
+#define PREEMPT_DEFAULT_QUANTUM 10000
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * lua_resume with an instruction budget.
+ *
+ * A count hook is installed on `co` for the duration of the call and
+ * yields it (without values) once it runs `quantum` VM instructions, so
+ * the caller gets control back even if the script never yields. Resuming
+ * a preempted coroutine discards the arguments and just continues.
+ *
+ * `*preempted` is set to non-zero when the LUA_YIELD returned comes from
+ * the budget rather than from the script. Code that can't yield (the main
+ * thread, a Lua function called from C without a continuation) isn't
+ * preempted, neither are coroutines it resumes on its own. A `quantum` of
+ * 0 disables preemption. The hook previously set on `co` is restored.
+ */
+int preempt_resume(lua_State *co, lua_State *from, int nargs, int *nres,
+    int quantum, int *preempted);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* PREEMPT_H */
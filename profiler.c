@@ -0,0 +1,685 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+
+#include "examples.h"
+#include "profiler.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define PROFILER_METATABLE "profiler"
+
+#define MIN_BUCKETS 256
+#define MAX_ARMED   8	/* threads with a pending sample hook */
+#define MAX_NAMES   64	/* named C functions */
+#define FRAME_SIZE  128	/* longest frame with its separator */
+#define LINE_SIZE   (PROFILER_MAX_DEPTH * FRAME_SIZE)
+
+struct stack {
+	struct stack *next;
+	uint64_t hash;
+	uint64_t count;
+	size_t len;
+	char frames[];
+};
+
+/* Hook of a thread saved while the sample hook replaces it */
+struct armed {
+	lua_State *L;
+	lua_Hook hook;
+	int mask;
+	int count;
+};
+
+struct profiler {
+	lua_State *L;
+	pthread_t owner; /* OS thread being sampled */
+	timer_t timer;
+	int running;
+	struct sigaction old_action;
+
+	/* Shared with the signal handler */
+	volatile sig_atomic_t pending; /* a sample was requested */
+	volatile sig_atomic_t busy;    /* armed list being changed */
+	struct armed armed[MAX_ARMED];
+	int narmed;
+
+	/* Collapsed stack -> count */
+	struct stack **buckets;
+	size_t nbuckets;
+
+	struct profiler_stats stats;
+};
+
+struct cfunction_name {
+	lua_CFunction fn;
+	const char *name;
+};
+
+static _Atomic(struct profiler *) active;
+
+/* Coroutine resumed from C by this OS thread, see profiler_switch */
+static _Thread_local lua_State *running;
+
+static struct cfunction_name names[MAX_NAMES];
+static atomic_int nnames;
+static pthread_mutex_t names_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void sample_hook(lua_State *L, lua_Debug *ar);
+
+static uint64_t
+hash_line(const char *s, size_t len)
+{
+	/* FNV-1a */
+	uint64_t h = 0xcbf29ce484222325u;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 0x100000001b3u;
+	}
+
+	return h;
+}
+
+static const char *
+cfunction_name(lua_CFunction fn)
+{
+	int n = atomic_load_explicit(&nnames, memory_order_acquire);
+
+	for (int i = 0; i < n; i++) {
+		if (names[i].fn == fn) {
+			return names[i].name;
+		}
+	}
+
+	return NULL;
+}
+
+void
+profiler_name_cfunction(lua_CFunction fn, const char *name)
+{
+	pthread_mutex_lock(&names_lock);
+
+	int n = atomic_load_explicit(&nnames, memory_order_relaxed);
+
+	if (cfunction_name(fn) == NULL && n < MAX_NAMES) {
+		names[n].fn = fn;
+		names[n].name = name;
+		atomic_store_explicit(&nnames, n + 1, memory_order_release);
+	}
+
+	pthread_mutex_unlock(&names_lock);
+}
+
+/**
+ * Replace the hook of L by the sample hook, from the signal handler.
+ */
+static void
+arm(struct profiler *p, lua_State *L)
+{
+	lua_Hook hook = lua_gethook(L);
+
+	if (hook == sample_hook || p->narmed == MAX_ARMED) {
+		return;
+	}
+
+	/*
+	 * Setting a hook restarts its count, so a count hook (a preemption
+	 * quantum) stays and takes the sample itself, see profiler_sample.
+	 */
+	if (lua_gethookmask(L) & LUA_MASKCOUNT) {
+		return;
+	}
+
+	struct armed *a = &p->armed[p->narmed];
+	a->L = L;
+	a->hook = hook;
+	a->mask = lua_gethookmask(L);
+	a->count = lua_gethookcount(L);
+	p->narmed++;
+
+	/* Fires at the next instruction */
+	lua_sethook(L, sample_hook, LUA_MASKCOUNT, 1);
+}
+
+/**
+ * Give L its own hook back, unless it was replaced since. Returns 0 if L
+ * wasn't armed.
+ */
+static int
+disarm(struct profiler *p, lua_State *L)
+{
+	for (int i = 0; i < p->narmed; i++) {
+		struct armed *a = &p->armed[i];
+
+		if (a->L == L) {
+			if (lua_gethook(L) == sample_hook) {
+				lua_sethook(L, a->hook, a->mask, a->count);
+			}
+			*a = p->armed[--p->narmed];
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+on_sigprof(__UNUSED int sig)
+{
+	struct profiler *p = atomic_load_explicit(&active,
+	    memory_order_relaxed);
+
+	if (p == NULL || p->busy) {
+		return;
+	}
+
+	p->pending = 1;
+	arm(p, p->L);
+	if (running != NULL) {
+		arm(p, running);
+	}
+}
+
+/**
+ * Append the name of the function of `ar` to buf.
+ */
+static size_t
+format_frame(lua_State *L, lua_Debug *ar, char *buf, size_t size)
+{
+	int n;
+
+	lua_getinfo(L, "Snf", ar);
+
+	if (*ar->what == 'C') {
+		const char *name = ar->name;
+
+		if (name == NULL) {
+			name = cfunction_name(lua_tocfunction(L, -1));
+		}
+		n = snprintf(buf, size, "%s [C]", name ? name : "?");
+	} else if (*ar->what == 'm') {
+		n = snprintf(buf, size, "main %s", ar->short_src);
+	} else {
+		n = snprintf(buf, size, "%s %s:%d", ar->name ? ar->name : "?",
+		    ar->short_src, ar->linedefined);
+	}
+	lua_pop(L, 1);
+
+	if (n < 0) {
+		return 0;
+	}
+	if ((size_t)n >= size) {
+		n = size - 1;
+	}
+
+	/* ';' separates the frames */
+	for (int i = 0; i < n; i++) {
+		if (buf[i] == ';') {
+			buf[i] = ':';
+		}
+	}
+
+	return n;
+}
+
+static int
+grow_buckets(struct profiler *p)
+{
+	size_t n = p->nbuckets ? p->nbuckets * 2 : MIN_BUCKETS;
+	struct stack **buckets = calloc(n, sizeof(*buckets));
+
+	if (buckets == NULL) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < p->nbuckets; i++) {
+		struct stack *s = p->buckets[i];
+
+		while (s != NULL) {
+			struct stack *next = s->next;
+
+			s->next = buckets[s->hash & (n - 1)];
+			buckets[s->hash & (n - 1)] = s;
+			s = next;
+		}
+	}
+
+	free(p->buckets);
+	p->buckets = buckets;
+	p->nbuckets = n;
+
+	return 0;
+}
+
+/**
+ * Walk the stack of L, outermost frame first, and count it.
+ */
+static void
+record(struct profiler *p, lua_State *L)
+{
+	lua_Debug ar;
+	char line[LINE_SIZE];
+	size_t len = 0;
+	int depth = 0;
+
+	while (depth < PROFILER_MAX_DEPTH && lua_getstack(L, depth, &ar)) {
+		depth++;
+	}
+	if (depth == PROFILER_MAX_DEPTH && lua_getstack(L, depth, &ar)) {
+		p->stats.truncated++;
+	}
+	if (depth == 0) {
+		return;
+	}
+
+	/* Every frame takes at most FRAME_SIZE bytes with its ';' */
+	for (int level = depth - 1; level >= 0; level--) {
+		lua_getstack(L, level, &ar);
+		len += format_frame(L, &ar, line + len, FRAME_SIZE);
+		if (level > 0) {
+			line[len++] = ';';
+		}
+	}
+
+	uint64_t hash = hash_line(line, len);
+
+	if (p->nbuckets > 0) {
+		struct stack *s = p->buckets[hash & (p->nbuckets - 1)];
+
+		for (; s != NULL; s = s->next) {
+			if (s->hash == hash && s->len == len &&
+			    memcmp(s->frames, line, len) == 0) {
+				s->count++;
+				p->stats.samples++;
+				return;
+			}
+		}
+	}
+
+	if (p->stats.stacks >= p->nbuckets && grow_buckets(p) != 0) {
+		p->stats.dropped++;
+		return;
+	}
+
+	struct stack *s = malloc(sizeof(*s) + len);
+
+	if (s == NULL) {
+		p->stats.dropped++;
+		return;
+	}
+
+	s->hash = hash;
+	s->count = 1;
+	s->len = len;
+	memcpy(s->frames, line, len);
+	s->next = p->buckets[hash & (p->nbuckets - 1)];
+	p->buckets[hash & (p->nbuckets - 1)] = s;
+
+	p->stats.stacks++;
+	p->stats.samples++;
+}
+
+static void
+sample_hook(lua_State *L, __UNUSED lua_Debug *ar)
+{
+	struct profiler *p = atomic_load_explicit(&active,
+	    memory_order_relaxed);
+
+	if (p == NULL || !pthread_equal(p->owner, pthread_self())) {
+		/* Inherited by a thread created while armed */
+		lua_sethook(L, NULL, 0, 0);
+		return;
+	}
+
+	p->busy = 1;
+	atomic_signal_fence(memory_order_seq_cst);
+
+	if (!disarm(p, L)) {
+		lua_sethook(L, NULL, 0, 0);
+	}
+	if (p->pending) {
+		p->pending = 0;
+		record(p, L);
+	}
+
+	atomic_signal_fence(memory_order_seq_cst);
+	p->busy = 0;
+}
+
+lua_State *
+profiler_switch(lua_State *co)
+{
+	lua_State *prev = running;
+	struct profiler *p = atomic_load_explicit(&active,
+	    memory_order_relaxed);
+
+	/* Leaving `prev`: it may be released once we return */
+	if (p != NULL && prev != NULL &&
+	    pthread_equal(p->owner, pthread_self())) {
+		p->busy = 1;
+		atomic_signal_fence(memory_order_seq_cst);
+		disarm(p, prev);
+		/* Before the handler may run again, or it arms `prev` */
+		running = co;
+		atomic_signal_fence(memory_order_seq_cst);
+		p->busy = 0;
+	} else {
+		running = co;
+	}
+
+	return prev;
+}
+
+void
+profiler_sample(lua_State *L)
+{
+	struct profiler *p = atomic_load_explicit(&active,
+	    memory_order_relaxed);
+
+	if (p == NULL || !p->pending ||
+	    !pthread_equal(p->owner, pthread_self())) {
+		return;
+	}
+
+	p->busy = 1;
+	atomic_signal_fence(memory_order_seq_cst);
+	p->pending = 0;
+	record(p, L);
+	atomic_signal_fence(memory_order_seq_cst);
+	p->busy = 0;
+}
+
+struct profiler *
+profiler_create(lua_State *L)
+{
+	struct profiler *p = calloc(1, sizeof(*p));
+
+	if (p == NULL) {
+		return NULL;
+	}
+
+	/* Sample the main thread, whichever thread opened the profiler */
+	lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+	p->L = lua_tothread(L, -1);
+	lua_pop(L, 1);
+
+	return p;
+}
+
+void
+profiler_destroy(struct profiler *p)
+{
+	if (p == NULL) {
+		return;
+	}
+
+	profiler_stop(p);
+	profiler_reset(p);
+	free(p->buckets);
+	free(p);
+}
+
+int
+profiler_start(struct profiler *p, int interval)
+{
+	struct profiler *expected = NULL;
+
+	if (p->running) {
+		return 0;
+	}
+	if (!atomic_compare_exchange_strong(&active, &expected, p)) {
+		return -1;
+	}
+
+	if (interval <= 0) {
+		interval = PROFILER_DEFAULT_INTERVAL;
+	}
+
+	p->owner = pthread_self();
+	p->pending = 0;
+	p->busy = 0;
+	p->narmed = 0;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_sigprof;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	/* Timer on the CPU clock of this thread, signaling only it */
+	clockid_t clock;
+	struct sigevent sev;
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD_ID;
+	sev.sigev_signo = SIGPROF;
+	sev.sigev_notify_thread_id = syscall(SYS_gettid);
+
+	struct itimerspec its;
+	its.it_interval.tv_sec = interval / 1000000;
+	its.it_interval.tv_nsec = (interval % 1000000) * 1000;
+	its.it_value = its.it_interval;
+
+	if (pthread_getcpuclockid(p->owner, &clock) != 0 ||
+	    sigaction(SIGPROF, &sa, &p->old_action) != 0) {
+		atomic_store(&active, NULL);
+		return -1;
+	}
+	if (timer_create(clock, &sev, &p->timer) != 0) {
+		sigaction(SIGPROF, &p->old_action, NULL);
+		atomic_store(&active, NULL);
+		return -1;
+	}
+	if (timer_settime(p->timer, 0, &its, NULL) != 0) {
+		timer_delete(p->timer);
+		sigaction(SIGPROF, &p->old_action, NULL);
+		atomic_store(&active, NULL);
+		return -1;
+	}
+
+	p->running = 1;
+
+	return 0;
+}
+
+void
+profiler_stop(struct profiler *p)
+{
+	if (!p->running) {
+		return;
+	}
+
+	timer_delete(p->timer);
+
+	/* Put back every hook we replaced */
+	p->busy = 1;
+	atomic_signal_fence(memory_order_seq_cst);
+	while (p->narmed > 0) {
+		disarm(p, p->armed[0].L);
+	}
+	p->pending = 0;
+
+	atomic_store(&active, NULL);
+	sigaction(SIGPROF, &p->old_action, NULL);
+	p->busy = 0;
+	p->running = 0;
+}
+
+void
+profiler_reset(struct profiler *p)
+{
+	for (size_t i = 0; i < p->nbuckets; i++) {
+		struct stack *s = p->buckets[i];
+
+		while (s != NULL) {
+			struct stack *next = s->next;
+			free(s);
+			s = next;
+		}
+		p->buckets[i] = NULL;
+	}
+
+	memset(&p->stats, 0, sizeof(p->stats));
+}
+
+int
+profiler_write(struct profiler *p, FILE *out)
+{
+	for (size_t i = 0; i < p->nbuckets; i++) {
+		for (struct stack *s = p->buckets[i]; s != NULL; s = s->next) {
+			if (fprintf(out, "%.*s %llu\n", (int)s->len, s->frames,
+				(unsigned long long)s->count) < 0) {
+				return -1;
+			}
+		}
+	}
+
+	return fflush(out) == 0 ? 0 : -1;
+}
+
+void
+profiler_stats(struct profiler *p, struct profiler_stats *stats)
+{
+	*stats = p->stats;
+}
+
+/*
+ * Lua library, the profiler userdata is the first upvalue of every
+ * function.
+ */
+
+static struct profiler *
+to_profiler(lua_State *L)
+{
+	return *(struct profiler **)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+static int
+prof_start(lua_State *L)
+{
+	int interval = (int)luaL_optinteger(L, 1, PROFILER_DEFAULT_INTERVAL);
+
+	if (profiler_start(to_profiler(L), interval) != 0) {
+		return luaL_error(L, "can't start the profiler");
+	}
+
+	return 0;
+}
+
+static int
+prof_stop(lua_State *L)
+{
+	profiler_stop(to_profiler(L));
+
+	return 0;
+}
+
+static int
+prof_dump(lua_State *L)
+{
+	const char *filename = luaL_optstring(L, 1, NULL);
+	FILE *out = filename ? fopen(filename, "w") : stdout;
+
+	if (out == NULL) {
+		return luaL_fileresult(L, 0, filename);
+	}
+
+	int error = profiler_write(to_profiler(L), out);
+
+	if (filename != NULL) {
+		error |= fclose(out);
+	}
+
+	return luaL_fileresult(L, error == 0, filename);
+}
+
+static int
+prof_reset(lua_State *L)
+{
+	profiler_reset(to_profiler(L));
+
+	return 0;
+}
+
+static int
+prof_gc(lua_State *L)
+{
+	struct profiler **p = luaL_checkudata(L, 1, PROFILER_METATABLE);
+
+	profiler_destroy(*p);
+	*p = NULL;
+
+	return 0;
+}
+
+static const luaL_Reg profiler_funcs[] = {
+	{ "start", prof_start },
+	{ "stop", prof_stop },
+	{ "dump", prof_dump },
+	{ "reset", prof_reset },
+	{ NULL, NULL },
+};
+
+int
+luaopen_profiler(lua_State *L)
+{
+	struct profiler **p = lua_newuserdatauv(L, sizeof(*p), 0);
+
+	*p = NULL;
+	if (luaL_newmetatable(L, PROFILER_METATABLE)) {
+		lua_pushcfunction(L, prof_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	if ((*p = profiler_create(L)) == NULL) {
+		return luaL_error(L, "can't create the profiler");
+	}
+
+	luaL_newlibtable(L, profiler_funcs);
+	lua_insert(L, -2);
+	luaL_setfuncs(L, profiler_funcs, 1);
+
+	return 1;
+}
@@ -0,0 +1,136 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <lua.h>
+
+/* CPU time between two samples by default, in microseconds. */
+#define PROFILER_DEFAULT_INTERVAL 1000
+
+/* Deepest stack recorded, outer frames are cut beyond it. */
+#define PROFILER_MAX_DEPTH 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Sampling profiler.
+ *
+ * A CPU time timer of the calling OS thread arms a one shot count hook on
+ * the profiled state (and on the coroutine being resumed, see
+ * profiler_switch); the hook walks the stack with lua_getinfo at the next
+ * VM instruction and counts the stack in a hash table. Nothing runs
+ * between two samples, so the cost stays with the sampling rate. A state
+ * that already has a count hook keeps it and is sampled when it fires.
+ *
+ * Lua and C frames are recorded, C functions called by lua_resume or from
+ * C (coroutine bodies, functions waiting in a continuation) have no name
+ * Lua knows about and can be named with profiler_name_cfunction.
+ *
+ * The output is one "frame;frame;...;leaf count" line per stack, the
+ * collapsed format read by flamegraph tools.
+ *
+ * Only one profiler runs at a time in the process.
+ */
+
+struct profiler;
+
+struct profiler_stats {
+	uint64_t samples;   /* stacks recorded */
+	uint64_t truncated; /* stacks deeper than PROFILER_MAX_DEPTH */
+	uint64_t dropped;   /* samples lost (out of memory) */
+	size_t stacks;	    /* distinct stacks */
+};
+
+/* Create a profiler for the state L (stopped). */
+struct profiler *profiler_create(lua_State *L);
+
+/* Stop the profiler if needed and free it with its samples. */
+void profiler_destroy(struct profiler *p);
+
+/*
+ * Start sampling every `interval` microseconds of CPU time of the calling
+ * OS thread, 0 for PROFILER_DEFAULT_INTERVAL. CPU timers expire on kernel
+ * ticks, so shorter intervals than a tick behave like a tick. Returns 0
+ * on success, -1 if another profiler is running or the timer can't be
+ * created.
+ */
+int profiler_start(struct profiler *p, int interval);
+
+/* Stop sampling, recorded stacks are kept. */
+void profiler_stop(struct profiler *p);
+
+/* Forget every recorded stack. */
+void profiler_reset(struct profiler *p);
+
+/* Write the collapsed stacks to `out`. Returns 0 or -1 on write errors. */
+int profiler_write(struct profiler *p, FILE *out);
+
+/* Copy the profiler counters. */
+void profiler_stats(struct profiler *p, struct profiler_stats *stats);
+
+/*
+ * Tell the profiler which coroutine the calling OS thread is about to
+ * resume from C (NULL when back to the caller). Returns the previous one,
+ * to be restored once lua_resume returns.
+ */
+lua_State *profiler_switch(lua_State *co);
+
+/*
+ * Take the pending sample of L, if any. For count hooks of their own
+ * (preempt_resume's), which the profiler leaves in place: replacing them
+ * would restart their count.
+ */
+void profiler_sample(lua_State *L);
+
+/* Name C function frames Lua has no name for. */
+void profiler_name_cfunction(lua_CFunction fn, const char *name);
+
+/*
+ * Open the `profiler` library, bound to the state it's opened in:
+ *
+ *   profiler.start([interval_us])
+ *   profiler.stop()
+ *   profiler.dump([filename])   collapsed stacks, stdout by default
+ *   profiler.reset()
+ */
+int luaopen_profiler(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* PROFILER_H */
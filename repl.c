@@ -27,39 +27,65 @@
  * SUCH DAMAGE.
  */
 
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <lauxlib.h>
 #include <lua.h>
 #include <lualib.h>
 
+#include "allocator.h"
+#include "chunk_cache.h"
+#include "cotrace.h"
 #include "examples.h"
+#include "memstat.h"
+#include "module.h"
+#include "numarray.h"
+#include "outbuf.h"
+#include "profiler.h"
+#include "stdlibs.h"
 
-/* Exit flag */
-static int exit_loop = 0;
+/* Per-state REPL context */
+struct repl_context {
+	int exit_loop; /* exit flag */
+};
+
+/* Wait this long for input before running a GC step, in milliseconds. */
+#define IDLE_GC_TICK 10
+
+/* Work done by every idle GC step, in kilobytes. */
+#define IDLE_GC_STEP 64
 
 /* Lua callback for set exit flag to true. */
 static int
-quit_callback(__UNUSED lua_State *L)
+quit_callback(lua_State *L)
 {
-	exit_loop = 1;
+	struct repl_context *ctx = module_upvalue(L);
+
+	ctx->exit_loop = 1;
 	return 0;
 }
 
-/* Create a simple Lua interpreter(REPL) */
-void
-run_lua_interpreter()
-{
-	char buff[256];
-	int error;
+static const luaL_Reg repl_funcs[] = {
+	{ "quit", quit_callback },
+	{ NULL, NULL },
+};
 
-	/* Create a new Lua State */
-	lua_State *L = luaL_newstate();
-
-	/* Load all Lua standard libraries */
-	luaL_openlibs(L);
+/* `quit` global, with the exit flag of its own state */
+static const struct module repl_module = {
+	NULL,
+	repl_funcs,
+	sizeof(struct repl_context),
+};
 
+/* Install the REPL globals: `val`, `native` and `quit`. */
+void
+setup_interpreter_globals(lua_State *L)
+{
 	/*
 	 * Create a new table with the field `key` with value 'Value from C++'
 	 * as global variable `val`
@@ -76,24 +102,140 @@ run_lua_interpreter()
 	lua_setglobal(L, "native");
 
 	/* Create a new cfunction as global `quit` */
-	lua_pushcfunction(L, &quit_callback);
-	lua_setglobal(L, "quit");
+	module_open(L, &repl_module);
+}
+
+int
+repl_quit_requested(lua_State *L)
+{
+	struct repl_context *ctx = module_context(L, &repl_module);
+
+	return ctx != NULL && ctx->exit_loop;
+}
+
+int
+repl_load(lua_State *L, const char *line, size_t len)
+{
+	struct chunk_cache *cache = chunk_cache_shared();
+
+	if (cache != NULL) {
+		return chunk_cache_load(cache, L, line, len, "line");
+	}
+
+	return luaL_loadbufferx(L, line, len, "line", NULL);
+}
+
+int
+repl_eval(lua_State *L, const char *line, size_t len)
+{
+	/* Try to load code from buffer and execute it as Lua */
+	int error = repl_load(L, line, len);
+
+	if (error == LUA_OK) {
+		error = lua_pcall(L, 0, 1, 0);
+	}
+
+	return error;
+}
+
+static pthread_once_t stdin_once = PTHREAD_ONCE_INIT;
+
+/**
+ * poll can't see what stdio already buffered, so a terminal stdin is read
+ * unbuffered. setvbuf is only allowed before the first read, hence once.
+ */
+static void
+unbuffer_stdin(void)
+{
+	setvbuf(stdin, NULL, _IONBF, 0);
+}
+
+/**
+ * Wait for input on stdin, collecting garbage in bounded steps meanwhile
+ * so the pauses don't land in the next evaluation. Once the cycle is over
+ * it's left to getline to block.
+ */
+static void
+wait_input(lua_State *L, struct outbuf *out)
+{
+	struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+	int done = 0;
+
+	outbuf_flush(out); /* show the prompt before waiting */
+
+	while (!done && poll(&pfd, 1, IDLE_GC_TICK) == 0) {
+		done = lua_gc(L, LUA_GCSTEP, IDLE_GC_STEP);
+	}
+}
+
+/* Create a simple Lua interpreter(REPL) */
+void
+run_lua_interpreter()
+{
+	char *line = NULL; /* grown by getline, lines have no length limit */
+	size_t cap = 0;
+	ssize_t len;
+	int error;
+
+	/* Create a new Lua State */
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
+
+	/* Standard libraries of the setup profile (all by default) */
+	stdlibs_open(L);
+
+	/* Install `val`, `native` and `quit` */
+	setup_interpreter_globals(L);
+
+	/* profiler.start() / profiler.stop() / profiler.dump([file]) */
+	luaL_requiref(L, "profiler", luaopen_profiler, 1);
+	lua_pop(L, 1);
+
+	/* memstat.stats() / memstat.gc(mode, ...) / memstat.step([kb]) */
+	luaL_requiref(L, "memstat", luaopen_memstat, 1);
+	lua_pop(L, 1);
+
+	/* cotrace.enable() / cotrace.install() / cotrace.dump([file]) */
+	luaL_requiref(L, "cotrace", luaopen_cotrace, 1);
+	lua_pop(L, 1);
+
+	/* numarray.new(n [, type]) / numarray.from(t [, type]) */
+	luaL_requiref(L, "numarray", luaopen_numarray, 1);
+	lua_pop(L, 1);
+
+	/* Results, print and io.write share one buffer, flushed by writev */
+	struct outbuf *out = outbuf_open(L, STDOUT_FILENO);
+
+	outbuf_install(L);
+
+	/* Collect while waiting for a terminal */
+	int interactive = isatty(STDIN_FILENO);
+
+	if (interactive) {
+		pthread_once(&stdin_once, unbuffer_stdin);
+	}
 
 	/*
 	 * Start loop
 	 *
 	 * Read from stdin until receive EOF
 	 */
-	while (fputs("> ", stdout), fgets(buff, sizeof(buff), stdin) != NULL) {
-		/* Try to load code from buffer and execute it as Lua */
-		error = luaL_loadbuffer(L, buff, strlen(buff), "line") ||
-		    lua_pcall(L, 0, 1, 0);
+	for (;;) {
+		outbuf_write(out, "> ", 2);
+		if (interactive) {
+			wait_input(L, out);
+		}
+		if ((len = getline(&line, &cap, stdin)) < 0) {
+			break;
+		}
+
+		error = repl_eval(L, line, len);
 
 		/*
 		 * If a error was found, print it to stderr and remove from
 		 * stack.
 		 */
 		if (error) {
+			outbuf_flush(out); /* keep stdout and stderr in order */
 			fprintf(stderr, "%s", lua_tostring(L, -1));
 			lua_pop(L, 1); /* pop error message from the stack */
 		}
@@ -107,23 +249,27 @@ run_lua_interpreter()
 				/* If it's a string, retrieve the C string and
 				 * print it. */
 				const char *r_str = lua_tostring(L, -1);
-				printf("String value: %s\n", r_str);
+				outbuf_printf(out, "String value: %s\n", r_str);
 
 				/* Remove from stack. */
 				lua_pop(L, 1);
 				break;
 			}
 			default:
+				/* Remove from stack. */
+				lua_pop(L, 1);
 				break;
 			}
 		}
 
 		/* If exit flag is true, quit loop. */
-		if (exit_loop) {
+		if (repl_quit_requested(L)) {
 			break;
 		}
 	}
 
+	free(line);
+
 	/* Close Lua */
-	lua_close(L);
+	allocator_close(L);
 }
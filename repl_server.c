@@ -0,0 +1,774 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "examples.h"
+#include "module.h"
+#include "preempt.h"
+#include "repl_server.h"
+#include "state_pool.h"
+#include "stdlibs.h"
+
+#define LISTEN_BACKLOG 128
+
+/* Events taken from the kernel per loop iteration */
+#define MAX_EVENTS 256
+
+#define PROMPT "> "
+
+struct session {
+	struct repl_server *srv;
+	int fd;
+	lua_State *L;
+	uint32_t events; /* epoll interest */
+
+	char in[REPL_SERVER_MAX_LINE];
+	size_t inlen;
+
+	/* Pending output, sent from outpos */
+	char *out;
+	size_t outlen;
+	size_t outpos;
+	size_t outcap;
+
+	/* Line being evaluated, resumed one quantum at a time */
+	lua_State *co;
+	int co_ref;
+	int queued; /* in the run queue */
+
+	int closing; /* quit(): close once the line is done and flushed */
+	int eof;     /* end of input: same once the lines received are done */
+	int broken;  /* write error, hang up or no memory: close now */
+
+	struct session *next_dirty;
+	struct session *next_run;
+};
+
+struct repl_server {
+	int epfd;
+	int listener;
+	int paused; /* out of descriptors, not accepting */
+	struct state_pool *states;
+
+	/* Sessions with new output, flushed at the end of the iteration */
+	struct session *dirty;
+
+	/* Sessions with a line to resume, in turn */
+	struct session *run_head;
+	struct session *run_tail;
+};
+
+/* Queue the session for the flush at the end of the loop iteration */
+static void
+mark_dirty(struct session *s)
+{
+	struct repl_server *srv = s->srv;
+
+	if (s->next_dirty == NULL && srv->dirty != s) {
+		s->next_dirty = srv->dirty;
+		srv->dirty = s;
+	}
+}
+
+static void
+out_append(struct session *s, const char *data, size_t len)
+{
+	if (s->outlen + len > s->outcap) {
+		size_t cap = s->outcap ? s->outcap : 1024;
+
+		while (cap < s->outlen + len) {
+			cap *= 2;
+		}
+
+		char *out = realloc(s->out, cap);
+		if (out == NULL) {
+			s->broken = 1;
+			return;
+		}
+		s->out = out;
+		s->outcap = cap;
+	}
+
+	memcpy(s->out + s->outlen, data, len);
+	s->outlen += len;
+
+	mark_dirty(s);
+}
+
+static size_t
+out_pending(struct session *s)
+{
+	return s->outlen - s->outpos;
+}
+
+/**
+ * Queue the line of the session for another quantum, unless the client is
+ * too far behind reading the answers: the flush queues it again.
+ */
+static void
+session_schedule(struct session *s)
+{
+	struct repl_server *srv = s->srv;
+
+	if (s->co == NULL || s->queued ||
+	    out_pending(s) >= REPL_SERVER_MAX_OUTPUT) {
+		return;
+	}
+
+	s->queued = 1;
+	s->next_run = NULL;
+	if (srv->run_tail != NULL) {
+		srv->run_tail->next_run = s;
+	} else {
+		srv->run_head = s;
+	}
+	srv->run_tail = s;
+}
+
+/*
+ * Session served by a state. Closures of a previous session can outlive
+ * it (the pool reset is shallow), so they look it up here instead of
+ * keeping a pointer; session_close clears it.
+ */
+struct session_slot {
+	struct session *s;
+	int io_patched; /* io.write replaced, kept by the pool reset */
+};
+
+static struct session *
+to_session(lua_State *L)
+{
+	struct session_slot *slot = module_upvalue(L);
+
+	if (slot->s == NULL) {
+		luaL_error(L, "no session");
+	}
+
+	return slot->s;
+}
+
+/* print() of a session, writes to its client */
+static int
+session_print(lua_State *L)
+{
+	struct session *s = to_session(L);
+	int n = lua_gettop(L);
+
+	for (int i = 1; i <= n; i++) {
+		size_t len;
+		const char *str = luaL_tolstring(L, i, &len);
+
+		if (i > 1) {
+			out_append(s, "\t", 1);
+		}
+		out_append(s, str, len);
+		lua_pop(L, 1);
+	}
+	out_append(s, "\n", 1);
+
+	return 0;
+}
+
+/**
+ * io.write of a session. Upvalues: the slot, the stock io.write,
+ * io.output and the io.stdout file. Writes to the client while the
+ * default output is stdout, returns that file like the stock one.
+ */
+static int
+session_io_write(lua_State *L)
+{
+	lua_pushvalue(L, lua_upvalueindex(3));
+	lua_call(L, 0, 1);
+	if (!lua_rawequal(L, -1, lua_upvalueindex(4))) {
+		lua_pop(L, 1);
+		lua_pushvalue(L, lua_upvalueindex(2));
+		lua_insert(L, 1);
+		lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+		return lua_gettop(L);
+	}
+	lua_pop(L, 1);
+
+	struct session *s = to_session(L);
+	int n = lua_gettop(L);
+	char num[64];
+
+	for (int i = 1; i <= n; i++) {
+		if (lua_type(L, i) == LUA_TNUMBER) {
+			int len = lua_isinteger(L, i) ?
+			    snprintf(num, sizeof(num), LUA_INTEGER_FMT,
+				(LUAI_UACINT)lua_tointeger(L, i)) :
+			    snprintf(num, sizeof(num), LUA_NUMBER_FMT,
+				(LUAI_UACNUMBER)lua_tonumber(L, i));
+			out_append(s, num, len);
+		} else {
+			size_t len;
+			const char *str = luaL_checklstring(L, i, &len);
+
+			out_append(s, str, len);
+		}
+	}
+	lua_pushvalue(L, lua_upvalueindex(4));
+
+	return 1;
+}
+
+/* quit() of a session, closes it after the pending output */
+static int
+session_quit(lua_State *L)
+{
+	to_session(L)->closing = 1;
+
+	return 0;
+}
+
+static const luaL_Reg session_funcs[] = {
+	{ "print", session_print },
+	{ "quit", session_quit },
+	{ NULL, NULL },
+};
+
+/* `print` and `quit` globals talking to the current session */
+static const struct module session_module = {
+	NULL,
+	session_funcs,
+	sizeof(struct session_slot),
+};
+
+/**
+ * Queue the output of the line just finished, the same the REPL prints.
+ */
+static void
+session_done(struct session *s, int status, int nres)
+{
+	lua_State *co = s->co;
+
+	if (status != LUA_OK) {
+		size_t mlen;
+		const char *msg = lua_tolstring(co, -1, &mlen);
+
+		if (msg == NULL) {
+			msg = "(error object is not a string)";
+			mlen = strlen(msg);
+		}
+		out_append(s, msg, mlen);
+		out_append(s, "\n", 1);
+	} else if (nres > 0 && lua_type(co, -nres) == LUA_TSTRING) {
+		size_t rlen;
+		const char *r_str = lua_tolstring(co, -nres, &rlen);
+
+		out_append(s, "String value: ", 14);
+		out_append(s, r_str, rlen);
+		out_append(s, "\n", 1);
+	}
+
+	luaL_unref(s->L, LUA_REGISTRYINDEX, s->co_ref);
+	s->co = NULL;
+
+	if (!s->closing) {
+		out_append(s, PROMPT, sizeof(PROMPT) - 1);
+	}
+}
+
+/**
+ * Run the line being evaluated for one quantum, it's queued again if
+ * preempted.
+ */
+static void
+session_step(struct session *s)
+{
+	int nres;
+	int preempted;
+	int status = preempt_resume(s->co, s->L, 0, &nres,
+	    PREEMPT_DEFAULT_QUANTUM, &preempted);
+
+	if (status == LUA_YIELD) {
+		/* Out of quantum, or a plain yield: its values are dropped */
+		lua_pop(s->co, nres);
+		session_schedule(s);
+		return;
+	}
+
+	session_done(s, status, nres);
+}
+
+/**
+ * Start evaluating one line in a new thread of the session state, its
+ * first quantum runs right away.
+ */
+static void
+session_eval(struct session *s, const char *line, size_t len)
+{
+	lua_State *L = s->L;
+
+	s->co = lua_newthread(L);
+	s->co_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	int status = repl_load(s->co, line, len);
+
+	if (status != LUA_OK) {
+		session_done(s, status, 1);
+		return;
+	}
+
+	session_step(s);
+}
+
+/**
+ * Evaluate the complete lines received so far, until one is preempted or
+ * the client is too far behind reading the answers.
+ */
+static void
+session_process(struct session *s)
+{
+	size_t start = 0;
+
+	while (s->co == NULL && !s->closing && !s->broken &&
+	    out_pending(s) < REPL_SERVER_MAX_OUTPUT) {
+		char *nl = memchr(s->in + start, '\n', s->inlen - start);
+
+		if (nl == NULL) {
+			break;
+		}
+
+		size_t len = nl - (s->in + start) + 1;
+
+		session_eval(s, s->in + start, len);
+		start += len;
+	}
+
+	/* Keep the partial line */
+	memmove(s->in, s->in + start, s->inlen - start);
+	s->inlen -= start;
+
+	if (s->inlen == sizeof(s->in) &&
+	    memchr(s->in, '\n', s->inlen) == NULL) {
+		static const char msg[] = "line too long\n" PROMPT;
+
+		out_append(s, msg, sizeof(msg) - 1);
+		s->inlen = 0;
+	}
+}
+
+static void
+session_read(struct session *s)
+{
+	/* Lines still waiting for the client to catch up come first */
+	if (s->inlen == sizeof(s->in)) {
+		return;
+	}
+
+	ssize_t n = read(s->fd, s->in + s->inlen, sizeof(s->in) - s->inlen);
+
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EINTR) {
+			s->broken = 1;
+		}
+		return;
+	}
+
+	s->inlen += n;
+	session_process(s);
+
+	/* End of input, close once the answers are out */
+	if (n == 0) {
+		s->eof = 1;
+	}
+}
+
+/* Whether the session has nothing left to evaluate */
+static int
+session_over(struct session *s)
+{
+	if (s->co != NULL) {
+		return 0;
+	}
+
+	return s->closing ||
+	    (s->eof && memchr(s->in, '\n', s->inlen) == NULL);
+}
+
+/* Update the epoll interest from the session state */
+static int
+session_watch(struct session *s)
+{
+	struct epoll_event ev = { 0 };
+
+	ev.events = out_pending(s) > 0 ? EPOLLOUT : 0;
+	if (!s->closing && !s->eof && s->inlen < sizeof(s->in) &&
+	    out_pending(s) < REPL_SERVER_MAX_OUTPUT) {
+		ev.events |= EPOLLIN;
+	}
+	ev.data.ptr = s;
+
+	if (ev.events == s->events) {
+		return 0;
+	}
+	s->events = ev.events;
+
+	return epoll_ctl(s->srv->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+}
+
+/* Leave the state without a session, see struct session_slot */
+static void
+session_detach(lua_State *L)
+{
+	struct session_slot *slot = module_context(L, &session_module);
+
+	if (slot != NULL) {
+		slot->s = NULL;
+	}
+}
+
+static void
+session_close(struct session *s)
+{
+	struct repl_server *srv = s->srv;
+
+	for (struct session **p = &srv->dirty; *p != NULL;
+	    p = &(*p)->next_dirty) {
+		if (*p == s) {
+			*p = s->next_dirty;
+			break;
+		}
+	}
+
+	struct session *prev = NULL;
+
+	for (struct session **p = &srv->run_head; s->queued && *p != NULL;
+	    prev = *p, p = &(*p)->next_run) {
+		if (*p == s) {
+			*p = s->next_run;
+			if (srv->run_tail == s) {
+				srv->run_tail = prev;
+			}
+			break;
+		}
+	}
+
+	/* A line still running is dropped with the state */
+	if (s->co != NULL) {
+		luaL_unref(s->L, LUA_REGISTRYINDEX, s->co_ref);
+	}
+
+	epoll_ctl(srv->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+	close(s->fd);
+	session_detach(s->L);
+	state_pool_release(srv->states, s->L);
+	free(s->out);
+	free(s);
+
+	/* A descriptor is available again */
+	if (srv->paused) {
+		struct epoll_event ev = { EPOLLIN, { .ptr = NULL } };
+
+		epoll_ctl(srv->epfd, EPOLL_CTL_ADD, srv->listener, &ev);
+		srv->paused = 0;
+	}
+}
+
+/**
+ * Send the pending output. Returns 0 while the session goes on, -1 when
+ * it's over.
+ */
+static int
+session_flush(struct session *s)
+{
+	while (!s->broken && out_pending(s) > 0) {
+		ssize_t n = send(s->fd, s->out + s->outpos, out_pending(s),
+		    MSG_NOSIGNAL);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN) {
+				s->broken = 1;
+			}
+			break;
+		}
+		s->outpos += n;
+	}
+
+	if (out_pending(s) == 0) {
+		s->outpos = s->outlen = 0;
+	}
+
+	/*
+	 * Room again for the answers of lines already received, their
+	 * output queues the session for another flush.
+	 */
+	if (!s->broken && s->inlen > 0 &&
+	    out_pending(s) < REPL_SERVER_MAX_OUTPUT) {
+		session_process(s);
+	}
+	session_schedule(s);
+
+	if (s->broken || (session_over(s) && out_pending(s) == 0)) {
+		return -1;
+	}
+
+	return session_watch(s);
+}
+
+/**
+ * Give every line being evaluated one more quantum, then go on with the
+ * next lines of the sessions whose line is done.
+ */
+static void
+run_sessions(struct repl_server *srv)
+{
+	struct session *s = srv->run_head;
+
+	srv->run_head = srv->run_tail = NULL;
+	while (s != NULL) {
+		struct session *next = s->next_run;
+
+		s->queued = 0;
+		if (!s->broken) {
+			session_step(s);
+		}
+		if (s->co == NULL) {
+			session_process(s);
+		}
+		s = next;
+	}
+}
+
+static void
+flush_dirty(struct repl_server *srv)
+{
+	while (srv->dirty != NULL) {
+		struct session *s = srv->dirty;
+
+		srv->dirty = s->next_dirty;
+		s->next_dirty = NULL;
+
+		if (session_flush(s) != 0) {
+			session_close(s);
+		}
+	}
+}
+
+static void
+session_open(struct repl_server *srv, int fd)
+{
+	struct session *s = calloc(1, sizeof(*s));
+	lua_State *L = state_pool_acquire(srv->states);
+
+	if (s == NULL || L == NULL) {
+		if (L != NULL) {
+			state_pool_release(srv->states, L);
+		}
+		free(s);
+		close(fd);
+		return;
+	}
+
+	s->srv = srv;
+	s->fd = fd;
+	s->L = L;
+	s->events = EPOLLIN;
+
+	/* print and quit talk to the session, reverted by the pool */
+	struct session_slot *slot = module_open(L, &session_module);
+
+	slot->s = s;
+
+	/* io.write too, a field of io (or its opener) the reset keeps */
+	if (!slot->io_patched) {
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &session_module);
+		stdlibs_replace_io_write(L, session_io_write);
+		slot->io_patched = 1;
+	}
+
+	struct epoll_event ev = { EPOLLIN, { .ptr = s } };
+
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0 ||
+	    epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		close(fd);
+		session_detach(L);
+		state_pool_release(srv->states, L);
+		free(s);
+		return;
+	}
+
+	out_append(s, PROMPT, sizeof(PROMPT) - 1);
+}
+
+static int
+accept_sessions(struct repl_server *srv)
+{
+	for (;;) {
+		int fd = accept(srv->listener, NULL, NULL);
+
+		if (fd >= 0) {
+			session_open(srv, fd);
+			continue;
+		}
+
+		switch (errno) {
+		case EAGAIN:
+			return 0;
+		case EINTR:
+		case ECONNABORTED:
+			continue;
+		case EMFILE:
+		case ENFILE:
+		case ENOBUFS:
+		case ENOMEM:
+			/* Leave them in the backlog until a session ends */
+			epoll_ctl(srv->epfd, EPOLL_CTL_DEL, srv->listener,
+			    NULL);
+			srv->paused = 1;
+			return 0;
+		default:
+			perror("accept");
+			return -1;
+		}
+	}
+}
+
+static int
+listen_unix(const char *path)
+{
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(fd, LISTEN_BACKLOG) != 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+serve(struct repl_server *srv)
+{
+	struct epoll_event events[MAX_EVENTS];
+
+	for (;;) {
+		/* Lines waiting for their next quantum: poll, don't block */
+		int n = epoll_wait(srv->epfd, events, MAX_EVENTS,
+		    srv->run_head != NULL ? 0 : -1);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("epoll_wait");
+			return -1;
+		}
+
+		for (int i = 0; i < n; i++) {
+			struct session *s = events[i].data.ptr;
+
+			if (s == NULL) {
+				if (accept_sessions(srv) != 0) {
+					return -1;
+				}
+				continue;
+			}
+
+			/* Nobody to answer, stop a line that may never end */
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				s->broken = 1;
+			} else if (events[i].events & EPOLLIN) {
+				session_read(s);
+			}
+			/* Writable, or new output: either way flush it */
+			mark_dirty(s);
+		}
+
+		run_sessions(srv);
+		flush_dirty(srv);
+	}
+}
+
+int
+repl_server_run(const char *path, size_t warm)
+{
+	struct repl_server srv = { -1, -1, 0, NULL, NULL, NULL, NULL };
+	struct epoll_event ev = { EPOLLIN, { .ptr = NULL } };
+	int error = -1;
+
+	srv.listener = listen_unix(path);
+	srv.epfd = epoll_create1(EPOLL_CLOEXEC);
+	srv.states = state_pool_create(warm, ALLOCATOR_POOL);
+
+	if (srv.listener < 0 || srv.epfd < 0 || srv.states == NULL ||
+	    epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.listener, &ev) != 0) {
+		fprintf(stderr, "can't start the REPL server\n");
+	} else {
+		fprintf(stderr, "REPL server listening on %s\n", path);
+		error = serve(&srv);
+	}
+
+	if (srv.listener >= 0) {
+		close(srv.listener);
+	}
+	if (srv.epfd >= 0) {
+		close(srv.epfd);
+	}
+	state_pool_destroy(srv.states);
+
+	return error;
+}
@@ -0,0 +1,75 @@
+#ifndef REPL_SERVER_H
+#define REPL_SERVER_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+/* Longest line a session can send, longer ones are rejected. */
+#define REPL_SERVER_MAX_LINE 4096
+
+/* Pending output above which a session isn't read anymore. */
+#define REPL_SERVER_MAX_OUTPUT (64 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Multiplexed REPL server.
+ *
+ * Clients connect to a Unix stream socket and talk to the same REPL as
+ * run_lua_interpreter: one line per evaluation, a "> " prompt when ready
+ * for the next one. Every session gets its own state from a state pool
+ * (`print` and `io.write` write to the session, `quit` closes it) and all
+ * of them are served by one thread with epoll and non-blocking sockets.
+ * The output of every line evaluated in a loop iteration is sent with one
+ * write per session; sessions whose peer doesn't read aren't read either.
+ *
+ *   nc -U /tmp/repl.sock
+ *
+ * Lines run in coroutines preempted every PREEMPT_DEFAULT_QUANTUM VM
+ * instructions (see preempt.h) and resumed in turn, so a busy session
+ * only slows the others down. Code that can't yield, a C function calling
+ * back into Lua or a coroutine the line resumes itself, still runs to
+ * completion.
+ */
+
+/*
+ * Serve sessions on the socket `path`, keeping up to `warm` states ready
+ * for new sessions. Only returns on errors, with -1.
+ */
+int repl_server_run(const char *path, size_t warm);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* REPL_SERVER_H */
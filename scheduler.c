@@ -0,0 +1,833 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "channel.h"
+#include "coro_pool.h"
+#include "examples.h"
+#include "preempt.h"
+#include "scheduler.h"
+
+#define TASK_READY    0
+#define TASK_SLEEPING 1
+#define TASK_WAITING  2
+
+/* Initial size of the run queue and the timer heap. */
+#define MIN_CAPACITY 64
+
+/* Finished threads kept for new tasks. */
+#define IDLE_THREADS 256
+
+/* Channel wakeups taken at once. */
+#define WAKE_BATCH 64
+
+/* Longest sleep in seconds, about 31 years: the deadline stays in range. */
+#define MAX_SLEEP 1e9
+
+struct task {
+	lua_State *co;
+	int ref;   /* registry reference pinning the thread */
+	int nargs; /* values to pass on the next resume */
+	int state;
+	uint64_t cpu_ns;   /* CPU time used by the task so far */
+	struct task *prev; /* every live task, or the free list */
+	struct task *next;
+};
+
+struct timer {
+	uint64_t deadline;
+	uint64_t seq; /* keeps FIFO order between equal deadlines */
+	struct task *task;
+};
+
+struct scheduler {
+	lua_State *L;
+	int waits_ref; /* key -> list of waiting tasks */
+	struct coro_pool *coros;
+
+	/* Run queue, ring buffer with a power of two capacity */
+	struct task **queue;
+	size_t qhead;
+	size_t qlen;
+	size_t qcap;
+	size_t round_left; /* steps left before checking the timers */
+
+	/* Event source, see scheduler_set_poller */
+	scheduler_poller poll;
+	void *poll_ud;
+
+	/* Tasks blocked on channels, woken from any thread (see wake_ring) */
+	struct channel_waker *waker;
+	int wake_fd;	  /* eventfd semaphore */
+	atomic_int rung; /* a ring is pending */
+
+	/* Timers, binary min-heap */
+	struct timer *heap;
+	size_t hlen;
+	size_t hcap;
+	uint64_t seq;
+
+	int quantum;		 /* instruction budget per resume, 0 = off */
+	struct task *current;	 /* task being resumed */
+	uint64_t slice_start;	 /* thread CPU time when it was resumed */
+	struct task *tasks;	 /* live tasks */
+	size_t ntasks;
+	struct task *free_tasks; /* recycled task structs */
+	size_t waiting;
+
+	struct scheduler_stats stats;
+};
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t
+cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Make room for `n` tasks in the run queue. Reserved for every live task
+ * when it's spawned, so requeueing a task never fails.
+ */
+static int
+queue_reserve(struct scheduler *s, size_t n)
+{
+	if (n > s->qcap) {
+		size_t cap = s->qcap ? s->qcap * 2 : MIN_CAPACITY;
+
+		while (cap < n) {
+			cap *= 2;
+		}
+
+		struct task **q = malloc(cap * sizeof(*q));
+
+		if (q == NULL) {
+			return -1;
+		}
+
+		/* Unwrap the ring while copying */
+		for (size_t i = 0; i < s->qlen; i++) {
+			q[i] = s->queue[(s->qhead + i) & (s->qcap - 1)];
+		}
+
+		free(s->queue);
+		s->queue = q;
+		s->qhead = 0;
+		s->qcap = cap;
+	}
+
+	return 0;
+}
+
+static void
+queue_push(struct scheduler *s, struct task *t)
+{
+	s->queue[(s->qhead + s->qlen) & (s->qcap - 1)] = t;
+	s->qlen++;
+	t->state = TASK_READY;
+}
+
+static struct task *
+queue_pop(struct scheduler *s)
+{
+	if (s->qlen == 0) {
+		return NULL;
+	}
+
+	struct task *t = s->queue[s->qhead];
+	s->qhead = (s->qhead + 1) & (s->qcap - 1);
+	s->qlen--;
+
+	return t;
+}
+
+static inline int
+timer_before(const struct timer *a, const struct timer *b)
+{
+	if (a->deadline != b->deadline) {
+		return a->deadline < b->deadline;
+	}
+	return a->seq < b->seq;
+}
+
+static int
+heap_push(struct scheduler *s, struct task *t, uint64_t deadline)
+{
+	if (s->hlen == s->hcap) {
+		size_t cap = s->hcap ? s->hcap * 2 : MIN_CAPACITY;
+		struct timer *heap = realloc(s->heap, cap * sizeof(*heap));
+
+		if (heap == NULL) {
+			return -1;
+		}
+		s->heap = heap;
+		s->hcap = cap;
+	}
+
+	struct timer tm = { deadline, s->seq++, t };
+	size_t i = s->hlen++;
+
+	/* Sift up */
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+
+		if (!timer_before(&tm, &s->heap[parent])) {
+			break;
+		}
+		s->heap[i] = s->heap[parent];
+		i = parent;
+	}
+	s->heap[i] = tm;
+	t->state = TASK_SLEEPING;
+
+	return 0;
+}
+
+static struct task *
+heap_pop(struct scheduler *s)
+{
+	struct task *t = s->heap[0].task;
+	struct timer last = s->heap[--s->hlen];
+	size_t i = 0;
+
+	/* Sift down the last timer from the root */
+	for (;;) {
+		size_t child = 2 * i + 1;
+
+		if (child >= s->hlen) {
+			break;
+		}
+		if (child + 1 < s->hlen &&
+		    timer_before(&s->heap[child + 1], &s->heap[child])) {
+			child++;
+		}
+		if (!timer_before(&s->heap[child], &last)) {
+			break;
+		}
+		s->heap[i] = s->heap[child];
+		i = child;
+	}
+	if (s->hlen > 0) {
+		s->heap[i] = last;
+	}
+
+	return t;
+}
+
+/**
+ * Move every expired timer to the run queue.
+ */
+static void
+fire_timers(struct scheduler *s)
+{
+	if (s->hlen == 0) {
+		return;
+	}
+
+	uint64_t now = now_ns();
+
+	while (s->hlen > 0 && s->heap[0].deadline <= now) {
+		queue_push(s, heap_pop(s));
+	}
+}
+
+/**
+ * Channel waker callback, from any thread: ring the eventfd when the first
+ * key comes in, take_wakeups answers every ring with exactly one read.
+ */
+static void
+wake_ring(void *ud)
+{
+	struct scheduler *s = ud;
+	uint64_t one = 1;
+
+	if (atomic_exchange(&s->rung, 1) == 0) {
+		while (write(s->wake_fd, &one, sizeof(one)) < 0 &&
+		    errno == EINTR) {
+		}
+	}
+}
+
+/**
+ * Move the tasks their channel woke to the run queue.
+ */
+static void
+take_wakeups(struct scheduler *s)
+{
+	void *keys[WAKE_BATCH];
+	uint64_t count;
+	size_t n;
+
+	if (atomic_load_explicit(&s->rung, memory_order_relaxed) == 0 ||
+	    atomic_exchange(&s->rung, 0) == 0) {
+		return;
+	}
+
+	/* The ring that went with the flag may still be on its way */
+	while (read(s->wake_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+	}
+
+	do {
+		n = channel_waker_take(s->waker, keys, WAKE_BATCH);
+		for (size_t i = 0; i < n; i++) {
+			lua_pushlightuserdata(s->L, keys[i]);
+			scheduler_notify(s, s->L, -1);
+			lua_pop(s->L, 1);
+		}
+	} while (n == WAKE_BATCH);
+}
+
+static struct task *
+task_new(struct scheduler *s)
+{
+	struct task *t = s->free_tasks;
+
+	if (t != NULL) {
+		s->free_tasks = t->next;
+	} else if ((t = malloc(sizeof(*t))) == NULL) {
+		return NULL;
+	}
+
+	memset(t, 0, sizeof(*t));
+
+	t->next = s->tasks;
+	if (s->tasks != NULL) {
+		s->tasks->prev = t;
+	}
+	s->tasks = t;
+	s->ntasks++;
+
+	return t;
+}
+
+static void
+task_release(struct scheduler *s, struct task *t)
+{
+	if (t->co != NULL) {
+		coro_pool_release(s->coros, t->co, t->ref);
+	}
+
+	if (t->prev != NULL) {
+		t->prev->next = t->next;
+	} else {
+		s->tasks = t->next;
+	}
+	if (t->next != NULL) {
+		t->next->prev = t->prev;
+	}
+
+	t->co = NULL;
+	t->next = s->free_tasks;
+	s->ntasks--;
+	s->free_tasks = t;
+}
+
+/**
+ * Whether the value at `idx` can key the wait table: not nil nor NaN.
+ */
+static int
+valid_key(lua_State *L, int idx)
+{
+	if (lua_type(L, idx) == LUA_TNUMBER && !lua_isinteger(L, idx)) {
+		lua_Number n = lua_tonumber(L, idx);
+
+		return n == n;
+	}
+
+	return !lua_isnoneornil(L, idx);
+}
+
+/**
+ * Park the task on the key at `key` in its own stack.
+ */
+static void
+task_wait(struct scheduler *s, struct task *t, int key)
+{
+	lua_State *co = t->co;
+
+	lua_rawgeti(co, LUA_REGISTRYINDEX, s->waits_ref);
+	int waits = lua_gettop(co);
+
+	lua_pushvalue(co, key);
+	if (lua_rawget(co, waits) == LUA_TNIL) {
+		lua_pop(co, 1);
+		lua_newtable(co);
+		lua_pushvalue(co, key);
+		lua_pushvalue(co, -2);
+		lua_rawset(co, waits);
+	}
+
+	lua_pushlightuserdata(co, t);
+	lua_rawseti(co, -2, lua_rawlen(co, -2) + 1);
+	lua_pop(co, 2);
+
+	t->state = TASK_WAITING;
+	s->waiting++;
+}
+
+/**
+ * Decide where a task goes from the values it yielded.
+ */
+static void
+task_yielded(struct scheduler *s, struct task *t, int nres)
+{
+	lua_State *co = t->co;
+	int first = lua_gettop(co) - nres + 1;
+	const char *request = NULL;
+
+	if (nres > 0 && lua_type(co, first) == LUA_TSTRING) {
+		request = lua_tostring(co, first);
+	}
+
+	if (request != NULL && strcmp(request, "sleep") == 0) {
+		lua_Number secs = nres > 1 ? lua_tonumber(co, first + 1) : 0;
+		uint64_t deadline = now_ns();
+
+		if (secs > MAX_SLEEP) {
+			secs = MAX_SLEEP;
+		}
+		if (secs > 0) {
+			deadline += (uint64_t)(secs * 1e9);
+		}
+		lua_pop(co, nres);
+		if (heap_push(s, t, deadline) == 0) {
+			return;
+		}
+	} else if (request != NULL && strcmp(request, "wait") == 0 &&
+	    nres > 1 && valid_key(co, first + 1)) {
+		task_wait(s, t, first + 1);
+		lua_pop(co, nres);
+		return;
+	} else {
+		lua_pop(co, nres);
+	}
+
+	/* Plain yield (or no memory for the timer): run again later */
+	queue_push(s, t);
+}
+
+static void
+task_resume(struct scheduler *s, struct task *t)
+{
+	int nres;
+	int preempted;
+
+	s->current = t;
+	s->slice_start = cpu_ns();
+
+	int status = preempt_resume(t->co, s->L, t->nargs, &nres, s->quantum,
+	    &preempted);
+
+	uint64_t slice = cpu_ns() - s->slice_start;
+
+	s->current = NULL;
+	t->cpu_ns += slice;
+	t->nargs = 0;
+	s->stats.resumes++;
+	s->stats.cpu_ns += slice;
+	if (slice > s->stats.max_slice_ns) {
+		s->stats.max_slice_ns = slice;
+	}
+
+	if (preempted) {
+		/* Used up its quantum, back to the end of the queue */
+		s->stats.preemptions++;
+		queue_push(s, t);
+		return;
+	}
+	if (status == LUA_YIELD) {
+		task_yielded(s, t, nres);
+		return;
+	}
+
+	if (status == LUA_OK) {
+		s->stats.finished++;
+	} else {
+		fprintf(stderr, "%s\n", lua_tostring(t->co, -1));
+		s->stats.errors++;
+	}
+
+	task_release(s, t);
+}
+
+int
+scheduler_spawn(struct scheduler *s, lua_State *L, int nargs)
+{
+	struct task *t = task_new(s);
+
+	if (t == NULL) {
+		lua_pop(L, nargs + 1);
+		return -1;
+	}
+
+	/* Move the function and its arguments to a recycled thread */
+	t->co = coro_pool_acquire(s->coros, &t->ref);
+	if (t->co == NULL || !lua_checkstack(t->co, nargs + 1) ||
+	    queue_reserve(s, s->ntasks) != 0) {
+		task_release(s, t);
+		lua_pop(L, nargs + 1);
+		return -1;
+	}
+	lua_xmove(L, t->co, nargs + 1);
+	t->nargs = nargs;
+
+	queue_push(s, t);
+	s->stats.spawned++;
+
+	return 0;
+}
+
+int
+scheduler_notify(struct scheduler *s, lua_State *L, int idx)
+{
+	int woken = 0;
+
+	idx = lua_absindex(L, idx);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, s->waits_ref);
+
+	lua_pushvalue(L, idx);
+	if (lua_rawget(L, -2) != LUA_TTABLE) {
+		lua_pop(L, 2);
+		return 0;
+	}
+
+	lua_Integer n = lua_rawlen(L, -1);
+	for (lua_Integer i = 1; i <= n; i++) {
+		lua_rawgeti(L, -1, i);
+		struct task *t = lua_touserdata(L, -1);
+		lua_pop(L, 1);
+
+		queue_push(s, t);
+		s->waiting--;
+		woken++;
+	}
+	lua_pop(L, 1);
+
+	/* Nobody waits on the key anymore */
+	lua_pushvalue(L, idx);
+	lua_pushnil(L);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+
+	return woken;
+}
+
+int
+scheduler_step(struct scheduler *s)
+{
+	/* Check the timers and events once per round to keep it fair */
+	if (s->round_left == 0 || s->qlen == 0) {
+		if (s->poll != NULL) {
+			s->poll(s->poll_ud, 0);
+		}
+		take_wakeups(s);
+		fire_timers(s);
+		s->round_left = s->qlen;
+	}
+
+	struct task *t = queue_pop(s);
+
+	if (t == NULL) {
+		return s->tasks != NULL ? 0 : -1;
+	}
+
+	s->round_left--;
+	task_resume(s, t);
+
+	return 1;
+}
+
+size_t
+scheduler_run(struct scheduler *s)
+{
+	for (;;) {
+		int ran = scheduler_step(s);
+
+		if (ran > 0) {
+			continue;
+		}
+		if (ran < 0) {
+			break; /* done */
+		}
+
+		/* Nothing ready, wait for events until the next timer */
+		uint64_t delta = 0;
+
+		if (s->hlen > 0) {
+			uint64_t now = now_ns();
+
+			if (s->heap[0].deadline > now) {
+				delta = s->heap[0].deadline - now;
+			}
+		}
+		int timeout = -1;
+
+		if (s->hlen > 0) {
+			uint64_t ms = (delta + 999999) / 1000000;
+
+			timeout = ms < INT_MAX ? (int)ms : INT_MAX;
+		}
+
+		if (s->poll != NULL && s->poll(s->poll_ud, timeout) >= 0) {
+			continue;
+		}
+		if (s->hlen == 0 && channel_waker_remote(s->waker) == 0) {
+			break; /* only tasks that nobody will notify */
+		}
+
+		/* Sleep until the next timer or a channel wakeup */
+		struct pollfd pfd = { s->wake_fd, POLLIN, 0 };
+
+		poll(&pfd, 1, timeout);
+	}
+
+	return s->waiting;
+}
+
+int
+scheduler_wake_fd(struct scheduler *s)
+{
+	return s->wake_fd;
+}
+
+void
+scheduler_set_poller(struct scheduler *s, scheduler_poller poll, void *ud)
+{
+	s->poll = poll;
+	s->poll_ud = ud;
+}
+
+void
+scheduler_set_quantum(struct scheduler *s, int quantum)
+{
+	s->quantum = quantum > 0 ? quantum : 0;
+}
+
+void
+scheduler_stats(struct scheduler *s, struct scheduler_stats *stats)
+{
+	*stats = s->stats;
+	stats->ready = s->qlen;
+	stats->sleeping = s->hlen;
+	stats->waiting = s->waiting;
+}
+
+/*
+ * Lua library, the scheduler is the first upvalue of every function.
+ */
+
+static struct scheduler *
+to_scheduler(lua_State *L)
+{
+	return lua_touserdata(L, lua_upvalueindex(1));
+}
+
+static int
+sched_spawn(lua_State *L)
+{
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+
+	if (scheduler_spawn(to_scheduler(L), L, lua_gettop(L) - 1) != 0) {
+		return luaL_error(L, "can't spawn a new task");
+	}
+
+	return 0;
+}
+
+static int
+sched_yield(lua_State *L)
+{
+	return lua_yield(L, 0);
+}
+
+static int
+sched_sleep(lua_State *L)
+{
+	lua_Number secs = luaL_checknumber(L, 1);
+
+	lua_pushliteral(L, "sleep");
+	lua_pushnumber(L, secs);
+
+	return lua_yield(L, 2);
+}
+
+static int
+sched_wait(lua_State *L)
+{
+	luaL_argcheck(L, valid_key(L, 1), 1, "key expected");
+
+	lua_pushliteral(L, "wait");
+	lua_pushvalue(L, 1);
+
+	return lua_yield(L, 2);
+}
+
+static int
+sched_notify(lua_State *L)
+{
+	luaL_checkany(L, 1);
+	lua_pushinteger(L, scheduler_notify(to_scheduler(L), L, 1));
+
+	return 1;
+}
+
+static int
+sched_cpu(lua_State *L)
+{
+	struct scheduler *s = to_scheduler(L);
+	struct task *t = s->current;
+
+	if (t == NULL || t->co != L) {
+		return luaL_error(L, "not called from a task");
+	}
+
+	/* Time of the previous slices plus the current one */
+	lua_pushnumber(L, (t->cpu_ns + cpu_ns() - s->slice_start) / 1e9);
+
+	return 1;
+}
+
+static int
+sched_now(lua_State *L)
+{
+	lua_pushnumber(L, now_ns() / 1e9);
+
+	return 1;
+}
+
+static const luaL_Reg sched_funcs[] = {
+	{ "spawn", sched_spawn },
+	{ "yield", sched_yield },
+	{ "sleep", sched_sleep },
+	{ "wait", sched_wait },
+	{ "notify", sched_notify },
+	{ "cpu", sched_cpu },
+	{ "now", sched_now },
+	{ NULL, NULL },
+};
+
+struct scheduler *
+scheduler_create(lua_State *L)
+{
+	struct scheduler *s = calloc(1, sizeof(*s));
+
+	if (s == NULL) {
+		return NULL;
+	}
+
+	s->L = L;
+	s->coros = coro_pool_create(L, IDLE_THREADS, 0);
+	if (s->coros == NULL) {
+		free(s);
+		return NULL;
+	}
+
+	s->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_SEMAPHORE);
+	s->waker = channel_waker_create(wake_ring, s);
+	if (s->wake_fd < 0 || s->waker == NULL) {
+		channel_waker_close(s->waker);
+		if (s->wake_fd >= 0) {
+			close(s->wake_fd);
+		}
+		coro_pool_destroy(s->coros);
+		free(s);
+		return NULL;
+	}
+	channel_set_waker(L, s->waker);
+
+	lua_newtable(L);
+	s->waits_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	/* Install the `sched` global */
+	luaL_newlibtable(L, sched_funcs);
+	lua_pushlightuserdata(L, s);
+	luaL_setfuncs(L, sched_funcs, 1);
+	lua_setglobal(L, "sched");
+
+	return s;
+}
+
+void
+scheduler_destroy(struct scheduler *s)
+{
+	if (s == NULL) {
+		return;
+	}
+
+	/* No more rings once closed, parked coroutines free it later */
+	channel_set_waker(s->L, NULL);
+	channel_waker_close(s->waker);
+	close(s->wake_fd);
+
+	while (s->tasks != NULL) {
+		task_release(s, s->tasks);
+	}
+
+	while (s->free_tasks != NULL) {
+		struct task *t = s->free_tasks;
+		s->free_tasks = t->next;
+		free(t);
+	}
+
+	coro_pool_destroy(s->coros);
+	luaL_unref(s->L, LUA_REGISTRYINDEX, s->waits_ref);
+
+	/* `sched` functions point to the scheduler */
+	lua_pushnil(s->L);
+	lua_setglobal(s->L, "sched");
+
+	free(s->queue);
+	free(s->heap);
+	free(s);
+}
@@ -0,0 +1,149 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Coroutine scheduler.
+ *
+ * Drives many Lua coroutines from C with the same lua_resume loop shown in
+ * lua2c.c. Ready coroutines are resumed round-robin; what a coroutine
+ * yields tells the scheduler what to do next:
+ *
+ *   coroutine.yield()               back to the end of the run queue
+ *   coroutine.yield("sleep", secs)  parked in the timer heap
+ *   coroutine.yield("wait", key)    parked until sched.notify(key)
+ *
+ * A "wait" without a usable key (nil or NaN) is a plain yield, sched.wait
+ * raises an error instead. Tasks blocked on a channel wait on a key of
+ * their own that the channel wakes, from whichever thread unblocks it.
+ *
+ * The `sched` global exposes the same requests as functions: spawn(f, ...),
+ * yield(), sleep(secs), wait(key), notify(key), now() and cpu(), the CPU
+ * time used by the calling task.
+ *
+ * With an instruction quantum set, a task that runs that many instructions
+ * without yielding is preempted and requeued like a plain yield.
+ */
+
+struct scheduler;
+
+/*
+ * Event source polled by the scheduler (see scheduler_set_poller). Waits
+ * up to `timeout` milliseconds (-1 forever, 0 not at all) and notifies the
+ * tasks whose events arrived. Returns the number of events, or -1 when
+ * nothing is in flight.
+ */
+typedef int (*scheduler_poller)(void *ud, int timeout);
+
+struct scheduler_stats {
+	uint64_t spawned;
+	uint64_t resumes;
+	uint64_t finished;
+	uint64_t errors;
+	uint64_t preemptions;  /* resumes cut short by the quantum */
+	uint64_t cpu_ns;       /* CPU time spent in tasks */
+	uint64_t max_slice_ns; /* longest single resume */
+	size_t ready;	       /* tasks in the run queue */
+	size_t sleeping;       /* tasks in the timer heap */
+	size_t waiting;	       /* tasks parked on a key */
+};
+
+/*
+ * Create a scheduler for the state L and install the `sched` global.
+ * It must be destroyed before L is closed.
+ */
+struct scheduler *scheduler_create(lua_State *L);
+
+/* Release every task and the scheduler itself. */
+void scheduler_destroy(struct scheduler *s);
+
+/*
+ * Spawn a task running the function below `nargs` arguments on top of the
+ * stack of L (any thread of the scheduler state). Pops the function and
+ * its arguments. Returns 0 on success, -1 if the task can't be created.
+ */
+int scheduler_spawn(struct scheduler *s, lua_State *L, int nargs);
+
+/*
+ * Wake every task waiting on the key at `idx` in L. Returns the number of
+ * tasks moved to the run queue.
+ */
+int scheduler_notify(struct scheduler *s, lua_State *L, int idx);
+
+/*
+ * Resume the next ready task. Returns 1 if a task ran, 0 if tasks exist but
+ * none is ready and -1 when there are no tasks left.
+ */
+int scheduler_step(struct scheduler *s);
+
+/*
+ * Run until no task can make progress anymore: sleeps (or polls the event
+ * source) while only timers, events and channels other threads can reach
+ * are pending. Returns the number of tasks left waiting on a key.
+ */
+size_t scheduler_run(struct scheduler *s);
+
+/*
+ * Descriptor readable while other threads have woken tasks. An event
+ * source must return from a blocking poll when it is, without reading it.
+ */
+int scheduler_wake_fd(struct scheduler *s);
+
+/*
+ * Poll `poll` once per round of the run queue and whenever no task is
+ * ready. NULL removes the event source.
+ */
+void scheduler_set_poller(struct scheduler *s, scheduler_poller poll,
+    void *ud);
+
+/*
+ * Preempt tasks after `quantum` VM instructions per resume, 0 (the
+ * default) lets them run until they yield.
+ */
+void scheduler_set_quantum(struct scheduler *s, int quantum);
+
+/* Copy the scheduler counters. */
+void scheduler_stats(struct scheduler *s, struct scheduler_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SCHEDULER_H */
@@ -0,0 +1,242 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "examples.h"
+#include "outbuf.h"
+#include "script_loader.h"
+
+/* Whole mapped file, returned in one piece */
+struct map_reader {
+	const char *data;
+	size_t len;
+};
+
+struct stream_reader {
+	int fd;
+	int first;   /* nothing read yet */
+	int comment; /* skipping the '#' first line */
+	int error;   /* errno of a failed read */
+	char buf[SCRIPT_LOADER_CHUNK];
+};
+
+static const char *
+map_read(__UNUSED lua_State *L, void *ud, size_t *size)
+{
+	struct map_reader *r = ud;
+
+	*size = r->len;
+	r->len = 0;
+
+	return *size > 0 ? r->data : NULL;
+}
+
+static const char *
+stream_read(__UNUSED lua_State *L, void *ud, size_t *size)
+{
+	struct stream_reader *r = ud;
+
+	for (;;) {
+		ssize_t n = read(r->fd, r->buf, sizeof(r->buf));
+
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n < 0) {
+				r->error = errno;
+			}
+			*size = 0;
+			return NULL;
+		}
+
+		const char *p = r->buf;
+
+		if (r->first) {
+			r->first = 0;
+			r->comment = p[0] == '#';
+		}
+		if (r->comment) {
+			/* Keep the newline so line numbers don't shift */
+			const char *nl = memchr(p, '\n', n);
+
+			if (nl == NULL) {
+				continue;
+			}
+			r->comment = 0;
+			n -= nl - p;
+			p = nl;
+		}
+
+		*size = n;
+		return p;
+	}
+}
+
+static int
+file_error(lua_State *L, const char *what, const char *path, int err)
+{
+	lua_pushfstring(L, "cannot %s %s: %s", what, path, strerror(err));
+
+	return LUA_ERRFILE;
+}
+
+int
+script_load_stream(lua_State *L, int fd, const char *chunkname)
+{
+	struct stream_reader r;
+
+	r.fd = fd;
+	r.first = 1;
+	r.comment = 0;
+	r.error = 0;
+
+	int status = lua_load(L, stream_read, &r, chunkname, NULL);
+
+	if (r.error != 0) {
+		/* Whatever was parsed is incomplete */
+		lua_pop(L, 1);
+		return file_error(L, "read", chunkname + 1, r.error);
+	}
+
+	return status;
+}
+
+/**
+ * Hand the whole mapping to lua_load.
+ */
+static int
+load_mapped(lua_State *L, const char *map, size_t size,
+    const char *chunkname)
+{
+	struct map_reader r = { map, size };
+
+	if (size > 0 && map[0] == '#') {
+		const char *nl = memchr(map, '\n', size);
+
+		r.len = nl != NULL ? size - (nl - map) : 0;
+		r.data = nl;
+	}
+
+	return lua_load(L, map_read, &r, chunkname, NULL);
+}
+
+int
+script_load_file(lua_State *L, const char *path)
+{
+	if (strcmp(path, "-") == 0) {
+		return script_load_stream(L, STDIN_FILENO, "=stdin");
+	}
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return file_error(L, "open", path, errno);
+	}
+
+	const char *chunkname = lua_pushfstring(L, "@%s", path);
+	struct stat st;
+	int status;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		size_t size = st.st_size;
+		void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) {
+			close(fd);
+			madvise(map, size, MADV_SEQUENTIAL);
+
+			/* The parser is done with the source once it returns */
+			status = load_mapped(L, map, size, chunkname);
+			munmap(map, size);
+			lua_remove(L, -2);
+
+			return status;
+		}
+	}
+
+	/* Not a regular file (or empty), stream it */
+	status = script_load_stream(L, fd, chunkname);
+	close(fd);
+	lua_remove(L, -2);
+
+	return status;
+}
+
+static int
+traceback(lua_State *L)
+{
+	const char *msg = lua_tostring(L, 1);
+
+	if (msg == NULL) {
+		msg = lua_pushfstring(L, "(error object is a %s value)",
+		    luaL_typename(L, 1));
+	}
+	luaL_traceback(L, L, msg, 1);
+
+	return 1;
+}
+
+int
+script_run(lua_State *L, const char *path)
+{
+	int base = lua_gettop(L);
+	int status;
+
+	lua_pushcfunction(L, traceback);
+
+	status = script_load_file(L, path);
+	if (status == LUA_OK) {
+		status = lua_pcall(L, 0, 0, base + 1);
+	}
+
+	if (status != LUA_OK) {
+		struct outbuf *out = outbuf_get(L);
+
+		/* What the script printed comes before its error */
+		if (out != NULL) {
+			outbuf_flush(out);
+		}
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+	}
+	lua_settop(L, base);
+
+	return status;
+}
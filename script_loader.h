@@ -0,0 +1,72 @@
+#ifndef SCRIPT_LOADER_H
+#define SCRIPT_LOADER_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <lua.h>
+
+/* Read size of the streaming reader. */
+#define SCRIPT_LOADER_CHUNK (64 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Script loading through lua_load readers.
+ *
+ * Regular files are memory-mapped and handed to the parser in one piece,
+ * nothing is copied nor allocated for the source. Pipes, terminals and
+ * sockets are streamed in SCRIPT_LOADER_CHUNK pieces, with no limit on the
+ * script size. Both skip a first line starting with '#' and accept text
+ * and precompiled chunks, like luaL_loadfile.
+ */
+
+/*
+ * Load the script `path` ("-" for stdin) as a function on top of the
+ * stack. Returns the lua_load status, or LUA_ERRFILE with the message on
+ * the stack.
+ */
+int script_load_file(lua_State *L, const char *path);
+
+/* Load a script streamed from `fd`, named `chunkname` (as in lua_load). */
+int script_load_stream(lua_State *L, int fd, const char *chunkname);
+
+/*
+ * Load and run the script `path`. Prints the error, with a traceback, to
+ * stderr and returns the Lua status.
+ */
+int script_run(lua_State *L, const char *path);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SCRIPT_LOADER_H */
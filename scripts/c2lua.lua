@@ -0,0 +1,12 @@
+-- Resume a coroutine created in C from Lua (c2lua.c)
+
+-- Prints value from entrypoint
+print(coroutine.resume(coroutine_function))
+-- Print the 3 expected values
+print(coroutine.resume(coroutine_function))
+print(coroutine.resume(coroutine_function))
+print(coroutine.resume(coroutine_function))
+-- Prints the last value (c function didn't yield after it)
+print(coroutine.resume(coroutine_function))
+-- Shows error becauses coroutine didn't yield again.
+print(coroutine.resume(coroutine_function))
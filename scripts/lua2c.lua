@@ -0,0 +1,14 @@
+-- Create a new coroutine in Lua and resume it from C (lua2c.c)
+
+-- Creates a coroutine
+local co = coroutine.create(function()
+    -- Prints 'Hello from Lua' from coroutine thread
+    print("Hello from Lua")
+    -- Yields value 'Send from Lua' and when it resumes returns 'Send from C'
+    d = coroutine.yield("Send from Lua")
+    -- Prints resumed value
+    print(d)
+end)
+
+-- Return the created routine with the inner function
+return co
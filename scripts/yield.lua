@@ -0,0 +1,7 @@
+-- Lua chunk called with lua_pcallk from a C coroutine (yield.c)
+
+print('Lua code running...');
+coroutine.yield(1);
+print('Lua code resumed... and running again.');
+coroutine.yield(1);
+print('Lua code resumed last time');
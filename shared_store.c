@@ -0,0 +1,1178 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "examples.h"
+#include "shared_store.h"
+
+#define VIEW_METATABLE	  "shared_store.view"
+#define VERSION_METATABLE "shared_store.version"
+
+#define STORE_MAGIC 0x31545353 /* "SST1" */
+
+/* Slot key and value types */
+#define T_NONE	  0 /* empty slot */
+#define T_BOOLEAN 1
+#define T_INTEGER 2
+#define T_NUMBER  3
+#define T_STRING  4
+#define T_TABLE	  5
+
+/*
+ * Region layout, every reference is an offset from the start so a saved
+ * file can be mapped anywhere:
+ *
+ *   header | tables and strings, 8-byte aligned
+ *
+ * A table is a header and a power of two of slots, half full at most,
+ * probed linearly. Tables are 32-byte aligned so no slot crosses a cache
+ * line.
+ */
+struct region_header {
+	uint32_t magic;
+	uint32_t unused;
+	uint64_t root; /* offset of the root table */
+	uint64_t size; /* of the whole region */
+};
+
+struct store_table {
+	uint32_t mask;	 /* slots - 1 */
+	uint32_t count;	 /* used slots */
+	uint64_t len;	 /* border, for # */
+	uint8_t pad[16]; /* slots start on a 32-byte boundary */
+};
+
+struct store_slot {
+	uint32_t hash;
+	uint8_t key_type;
+	uint8_t value_type;
+	uint16_t unused;
+	uint32_t key_len;   /* of string keys */
+	uint32_t value_len; /* of string values */
+	uint64_t key;	    /* integer, or offset of the string */
+	uint64_t value;	    /* offset of strings and tables, else the bits */
+};
+
+#define TABLE_SLOTS(t) ((const struct store_slot *)((t) + 1))
+
+/* A published region */
+struct store_version {
+	atomic_long refs;
+	uint64_t generation;
+	const char *base;
+	size_t size;
+};
+
+struct shared_store {
+	atomic_int refs;
+	pthread_mutex_t lock; /* held to swap or take `current` */
+	struct store_version *current;
+	atomic_uint_least64_t generation;
+
+	/* Named stores */
+	char *name;
+	struct shared_store *next;
+};
+
+/*
+ * A table of a version. Root views hold a store reference and follow its
+ * versions, the version in use is kept alive by user value 1 (a version
+ * userdata, which caches the views of its tables in its own user value).
+ */
+struct store_view {
+	struct shared_store *store; /* root views only */
+	const struct store_version *v;
+	uint64_t generation;
+	uint64_t table;
+};
+
+static pthread_mutex_t named_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct shared_store *named_stores;
+
+static size_t
+align_to(size_t n, size_t a)
+{
+	return (n + a - 1) & ~(a - 1);
+}
+
+static uint32_t
+hash_string(const char *s, size_t len)
+{
+	uint32_t h = 2166136261u; /* FNV-1a */
+
+	for (size_t i = 0; i < len; i++) {
+		h = (h ^ (unsigned char)s[i]) * 16777619u;
+	}
+
+	return h;
+}
+
+static uint32_t
+hash_integer(lua_Integer i)
+{
+	uint64_t x = (uint64_t)i;
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+
+	return (uint32_t)x;
+}
+
+/* Slots for `count` entries, at least one always empty */
+static size_t
+table_slots(size_t count)
+{
+	size_t n = 2;
+
+	while (n < count * 2) {
+		n *= 2;
+	}
+
+	return n;
+}
+
+/*
+ * Versions
+ */
+
+static void
+version_release(struct store_version *v)
+{
+	if (v != NULL &&
+	    atomic_fetch_sub_explicit(&v->refs, 1, memory_order_acq_rel) ==
+		1) {
+		munmap((void *)v->base, v->size);
+		free(v);
+	}
+}
+
+/* Take a reference to the current version, NULL if none yet */
+static struct store_version *
+acquire(struct shared_store *s)
+{
+	struct store_version *v;
+
+	pthread_mutex_lock(&s->lock);
+	v = s->current;
+	if (v != NULL) {
+		atomic_fetch_add_explicit(&v->refs, 1, memory_order_relaxed);
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	return v;
+}
+
+/* Swap in the region, which is unmapped with the version */
+static int
+publish_region(struct shared_store *s, const char *base, size_t size)
+{
+	struct store_version *v = malloc(sizeof(*v));
+
+	if (v == NULL) {
+		munmap((void *)base, size);
+		return -1;
+	}
+
+	atomic_init(&v->refs, 1);
+	v->base = base;
+	v->size = size;
+
+	pthread_mutex_lock(&s->lock);
+	struct store_version *old = s->current;
+	uint64_t generation = atomic_load_explicit(&s->generation,
+	    memory_order_relaxed);
+
+	v->generation = generation + 1;
+	s->current = v;
+	atomic_store_explicit(&s->generation, v->generation,
+	    memory_order_release);
+	pthread_mutex_unlock(&s->lock);
+
+	version_release(old);
+
+	return 0;
+}
+
+/*
+ * Building, like channel messages: measure then write. Every error is
+ * raised while measuring, before anything is mapped. Strings and tables
+ * seen twice are stored once, `seen` maps them to their offset.
+ */
+
+static int
+check_key(lua_State *L, int idx)
+{
+	switch (lua_type(L, idx)) {
+	case LUA_TSTRING:
+		return T_STRING;
+	case LUA_TNUMBER:
+		/* Integral floats are integer keys already */
+		if (lua_isinteger(L, idx)) {
+			return T_INTEGER;
+		}
+		/* FALLTHROUGH */
+	default:
+		return luaL_error(L, "can't store a %s key",
+		    luaL_typename(L, idx));
+	}
+}
+
+static size_t
+measure(lua_State *L, int idx, int seen, int depth)
+{
+	size_t size = 0;
+	size_t len;
+	size_t count = 0;
+
+	idx = lua_absindex(L, idx);
+
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+	case LUA_TNUMBER:
+		return 0;
+	case LUA_TSTRING:
+	case LUA_TTABLE:
+		break;
+	default:
+		return luaL_error(L, "can't store a %s value",
+		    luaL_typename(L, idx));
+	}
+
+	lua_pushvalue(L, idx);
+	if (lua_rawget(L, seen) != LUA_TNIL) {
+		lua_pop(L, 1);
+		return 0;
+	}
+	lua_pop(L, 1);
+	lua_pushvalue(L, idx);
+	lua_pushboolean(L, 1);
+	lua_rawset(L, seen);
+
+	if (lua_type(L, idx) == LUA_TSTRING) {
+		lua_tolstring(L, idx, &len);
+		if (len > UINT32_MAX) {
+			luaL_error(L, "string too long to store");
+		}
+		return align_to(len + 1, 8);
+	}
+
+	if (depth >= SHARED_STORE_MAX_DEPTH) {
+		luaL_error(L, "table nested too deep to store");
+	}
+	luaL_checkstack(L, 4, "table nested too deep to store");
+
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		check_key(L, -2);
+		size += measure(L, -2, seen, depth + 1);
+		size += measure(L, -1, seen, depth + 1);
+		lua_pop(L, 1);
+		count++;
+	}
+
+	return size + sizeof(struct store_table) +
+	    table_slots(count) * sizeof(struct store_slot) + 32;
+}
+
+struct writer {
+	char *base;
+	size_t len;
+	int seen;
+};
+
+static uint64_t
+reserve(struct writer *w, size_t size, size_t align)
+{
+	uint64_t off = align_to(w->len, align);
+
+	w->len = off + size;
+
+	return off;
+}
+
+/* Offset of the string or table at `idx`, written already or now */
+static int
+find_seen(lua_State *L, struct writer *w, int idx, uint64_t *off)
+{
+	int found;
+
+	lua_pushvalue(L, idx);
+	found = lua_rawget(L, w->seen) == LUA_TNUMBER;
+	*off = found ? (uint64_t)lua_tointeger(L, -1) : 0;
+	lua_pop(L, 1);
+
+	return found;
+}
+
+static void
+set_seen(lua_State *L, struct writer *w, int idx, uint64_t off)
+{
+	lua_pushvalue(L, idx);
+	lua_pushinteger(L, off);
+	lua_rawset(L, w->seen);
+}
+
+static uint64_t
+write_string(lua_State *L, struct writer *w, int idx, uint32_t *len)
+{
+	size_t n;
+	const char *s = lua_tolstring(L, idx, &n);
+	uint64_t off;
+
+	*len = n;
+	if (!find_seen(L, w, idx, &off)) {
+		off = reserve(w, n + 1, 8);
+		memcpy(w->base + off, s, n + 1);
+		set_seen(L, w, idx, off);
+	}
+
+	return off;
+}
+
+static uint64_t write_table(lua_State *L, struct writer *w, int idx);
+
+static void
+write_value(lua_State *L, struct writer *w, int idx, struct store_slot *slot)
+{
+	lua_Number n;
+
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+		slot->value_type = T_BOOLEAN;
+		slot->value = lua_toboolean(L, idx);
+		break;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, idx)) {
+			slot->value_type = T_INTEGER;
+			slot->value = (uint64_t)lua_tointeger(L, idx);
+		} else {
+			n = lua_tonumber(L, idx);
+			slot->value_type = T_NUMBER;
+			memcpy(&slot->value, &n, sizeof(n));
+		}
+		break;
+	case LUA_TSTRING:
+		slot->value_type = T_STRING;
+		slot->value = write_string(L, w, idx, &slot->value_len);
+		break;
+	default:
+		slot->value_type = T_TABLE;
+		slot->value = write_table(L, w, idx);
+		break;
+	}
+}
+
+static uint64_t
+write_table(lua_State *L, struct writer *w, int idx)
+{
+	uint64_t off;
+	size_t count = 0;
+
+	idx = lua_absindex(L, idx);
+	if (find_seen(L, w, idx, &off)) {
+		return off;
+	}
+	luaL_checkstack(L, 4, "table nested too deep to store");
+
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		lua_pop(L, 1);
+		count++;
+	}
+
+	size_t nslots = table_slots(count);
+
+	/* Recorded first, so cycles refer back to it */
+	off = reserve(w, sizeof(struct store_table) +
+		nslots * sizeof(struct store_slot),
+	    32);
+	set_seen(L, w, idx, off);
+
+	struct store_table *t = (struct store_table *)(w->base + off);
+	struct store_slot *slots = (struct store_slot *)(t + 1);
+
+	t->mask = nslots - 1;
+	t->count = count;
+	t->len = lua_rawlen(L, idx);
+
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		struct store_slot key = { 0 };
+
+		if (lua_type(L, -2) == LUA_TSTRING) {
+			size_t len;
+			const char *s = lua_tolstring(L, -2, &len);
+
+			key.hash = hash_string(s, len);
+			key.key_type = T_STRING;
+			key.key = write_string(L, w, lua_absindex(L, -2),
+			    &key.key_len);
+		} else {
+			key.hash = hash_integer(lua_tointeger(L, -2));
+			key.key_type = T_INTEGER;
+			key.key = (uint64_t)lua_tointeger(L, -2);
+		}
+
+		uint32_t i = key.hash & t->mask;
+
+		while (slots[i].key_type != T_NONE) {
+			i = (i + 1) & t->mask;
+		}
+		slots[i] = key;
+		write_value(L, w, lua_absindex(L, -1), &slots[i]);
+		lua_pop(L, 1);
+	}
+
+	return off;
+}
+
+/*
+ * Build the table at `idx` into a new read-only anonymous mapping.
+ * Returns its address or NULL (errno set).
+ */
+static char *
+build(lua_State *L, int idx, size_t *size)
+{
+	struct writer w;
+
+	luaL_checktype(L, idx, LUA_TTABLE);
+	idx = lua_absindex(L, idx);
+
+	lua_newtable(L);
+	w.seen = lua_gettop(L);
+	*size = sizeof(struct region_header) + 32 +
+	    measure(L, idx, w.seen, 0);
+
+	w.base = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (w.base == MAP_FAILED) {
+		lua_pop(L, 1);
+		return NULL;
+	}
+
+	lua_newtable(L); /* offsets this time */
+	lua_replace(L, w.seen);
+	w.len = sizeof(struct region_header);
+
+	struct region_header *h = (struct region_header *)w.base;
+
+	h->magic = STORE_MAGIC;
+	h->root = write_table(L, &w, idx);
+	h->size = *size;
+	lua_pop(L, 1);
+
+	mprotect(w.base, *size, PROT_READ);
+
+	return w.base;
+}
+
+struct shared_store *
+shared_store_create(void)
+{
+	struct shared_store *s = calloc(1, sizeof(*s));
+
+	if (s == NULL) {
+		return NULL;
+	}
+
+	atomic_init(&s->refs, 1);
+	atomic_init(&s->generation, 0);
+	pthread_mutex_init(&s->lock, NULL);
+
+	return s;
+}
+
+void
+shared_store_retain(struct shared_store *s)
+{
+	atomic_fetch_add_explicit(&s->refs, 1, memory_order_relaxed);
+}
+
+void
+shared_store_release(struct shared_store *s)
+{
+	if (atomic_fetch_sub_explicit(&s->refs, 1, memory_order_acq_rel) !=
+	    1) {
+		return;
+	}
+
+	version_release(s->current);
+	pthread_mutex_destroy(&s->lock);
+	free(s->name);
+	free(s);
+}
+
+int
+shared_store_publish(struct shared_store *s, lua_State *L, int idx)
+{
+	size_t size;
+	char *base = build(L, idx, &size);
+
+	if (base == NULL) {
+		return -1;
+	}
+
+	return publish_region(s, base, size);
+}
+
+/* Whether the string at `off`, `len` bytes and a NUL, is in the region */
+static int
+valid_string(size_t size, uint64_t off, uint32_t len)
+{
+	return off < size && len < size - off;
+}
+
+/* Set the bit of the table at `off`, returns 0 if it was set already */
+static int
+mark_table(uint8_t *seen, uint64_t off)
+{
+	uint8_t bit = 1 << (off / 32 % 8);
+
+	if (seen[off / 32 / 8] & bit) {
+		return 0;
+	}
+	seen[off / 32 / 8] |= bit;
+
+	return 1;
+}
+
+/*
+ * Check every table reachable from the root of a loaded region: inside
+ * the region, a power of two of slots with an empty one (probes end),
+ * known types, and strings and tables referenced from inside too. Each
+ * table is checked once, tables refer to each other freely. Returns 0 or
+ * -1 (errno set).
+ */
+static int
+validate_region(const char *base, size_t size)
+{
+	const struct region_header *h = (const struct region_header *)base;
+	size_t max_tables = size / 32 + 1;
+	uint8_t *seen = calloc(max_tables / 8 + 1, 1);
+	uint64_t *todo = malloc(max_tables * sizeof(*todo));
+	size_t ntodo = 0;
+	int nomem = seen == NULL || todo == NULL;
+	int ok = !nomem;
+
+	if (ok) {
+		mark_table(seen, h->root);
+		todo[ntodo++] = h->root;
+	}
+
+	while (ok && ntodo > 0) {
+		uint64_t off = todo[--ntodo];
+		const struct store_table *t;
+
+		ok = off % 32 == 0 && off >= sizeof(*h) &&
+		    off + sizeof(*t) <= size;
+		if (!ok) {
+			break;
+		}
+
+		t = (const struct store_table *)(base + off);
+
+		uint64_t nslots = (uint64_t)t->mask + 1;
+		const struct store_slot *slots = TABLE_SLOTS(t);
+		int empty = 0;
+
+		ok = (nslots & t->mask) == 0 &&
+		    nslots <= (size - off - sizeof(*t)) / sizeof(*slots);
+
+		for (uint64_t i = 0; ok && i < nslots; i++) {
+			const struct store_slot *slot = &slots[i];
+
+			if (slot->key_type == T_NONE) {
+				empty = 1;
+				continue;
+			}
+
+			ok = (slot->key_type == T_INTEGER ||
+				 (slot->key_type == T_STRING &&
+				     valid_string(size, slot->key,
+					 slot->key_len))) &&
+			    slot->value_type >= T_BOOLEAN &&
+			    slot->value_type <= T_TABLE &&
+			    (slot->value_type != T_STRING ||
+				valid_string(size, slot->value,
+				    slot->value_len));
+
+			/* Tables start 32-byte aligned, one bit each */
+			uint64_t v = slot->value;
+
+			if (ok && slot->value_type == T_TABLE) {
+				ok = v < size && v % 32 == 0;
+				if (ok && mark_table(seen, v)) {
+					todo[ntodo++] = v;
+				}
+			}
+		}
+		ok = ok && empty;
+	}
+
+	free(seen);
+	free(todo);
+	if (!ok) {
+		errno = nomem ? ENOMEM : EINVAL;
+	}
+
+	return ok ? 0 : -1;
+}
+
+int
+shared_store_publish_file(struct shared_store *s, const char *path)
+{
+	struct region_header h;
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	/* Kept if the calls succeed but the header is wrong */
+	errno = EINVAL;
+	if (fstat(fd, &st) != 0 || read(fd, &h, sizeof(h)) != sizeof(h) ||
+	    h.magic != STORE_MAGIC || h.size != (uint64_t)st.st_size ||
+	    h.root >= h.size) {
+		close(fd);
+		return -1;
+	}
+
+	char *base = mmap(NULL, h.size, PROT_READ, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (base == MAP_FAILED) {
+		return -1;
+	}
+
+	/* Any file can be passed, nothing in it is trusted */
+	if (validate_region(base, h.size) != 0) {
+		int saved = errno;
+
+		munmap(base, h.size);
+		errno = saved;
+		return -1;
+	}
+
+	return publish_region(s, base, h.size);
+}
+
+int
+shared_store_save(lua_State *L, int idx, const char *path)
+{
+	size_t size;
+	char *base = build(L, idx, &size);
+
+	if (base == NULL) {
+		return -1;
+	}
+
+	/* Replace the file at once, it may be mapped by others */
+	size_t len = strlen(path);
+	char *tmp = malloc(len + sizeof(".tmp"));
+	int ok = 0;
+
+	if (tmp != NULL) {
+		memcpy(tmp, path, len);
+		memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+		int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		    0644);
+
+		if (fd >= 0) {
+			ok = write(fd, base, size) == (ssize_t)size;
+			ok = close(fd) == 0 && ok;
+			ok = ok && rename(tmp, path) == 0;
+			if (!ok) {
+				int saved = errno;
+				unlink(tmp);
+				errno = saved;
+			}
+		}
+		free(tmp);
+	}
+	munmap(base, size);
+
+	return ok ? 0 : -1;
+}
+
+uint64_t
+shared_store_generation(struct shared_store *s)
+{
+	return atomic_load_explicit(&s->generation, memory_order_acquire);
+}
+
+/*
+ * Views
+ */
+
+/* Push a userdata owning the reference `v`, with an empty view cache */
+static void
+push_version(lua_State *L, struct store_version *v)
+{
+	struct store_version **ud = lua_newuserdatauv(L, sizeof(*ud), 1);
+
+	*ud = v;
+	luaL_setmetatable(L, VERSION_METATABLE);
+
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushliteral(L, "v");
+	lua_setfield(L, -2, "__mode");
+	lua_setmetatable(L, -2);
+	lua_setiuservalue(L, -2, 1);
+}
+
+/* Push the view of `table` in the version userdata at `version` */
+static void
+push_table(lua_State *L, int version, uint64_t table)
+{
+	lua_getiuservalue(L, version, 1);
+	if (lua_rawgeti(L, -1, table) != LUA_TNIL) {
+		lua_remove(L, -2);
+		return;
+	}
+	lua_pop(L, 1);
+
+	struct store_view *view = lua_newuserdatauv(L, sizeof(*view), 1);
+
+	view->store = NULL;
+	view->v = *(struct store_version **)lua_touserdata(L, version);
+	view->generation = view->v->generation;
+	view->table = table;
+	luaL_setmetatable(L, VIEW_METATABLE);
+	lua_pushvalue(L, version);
+	lua_setiuservalue(L, -2, 1);
+
+	lua_pushvalue(L, -1);
+	lua_rawseti(L, -3, table);
+	lua_remove(L, -2);
+}
+
+static void
+push_string(lua_State *L, const struct store_version *v, uint64_t off,
+    uint32_t len)
+{
+	lua_pushlstring(L, v->base + off, len);
+}
+
+/* Push the value of `slot`, `version` as in push_table */
+static void
+push_value(lua_State *L, int version, const struct store_version *v,
+    const struct store_slot *slot)
+{
+	lua_Number n;
+
+	switch (slot->value_type) {
+	case T_BOOLEAN:
+		lua_pushboolean(L, slot->value != 0);
+		break;
+	case T_INTEGER:
+		lua_pushinteger(L, (lua_Integer)slot->value);
+		break;
+	case T_NUMBER:
+		memcpy(&n, &slot->value, sizeof(n));
+		lua_pushnumber(L, n);
+		break;
+	case T_STRING:
+		push_string(L, v, slot->value, slot->value_len);
+		break;
+	default:
+		push_table(L, version, slot->value);
+		break;
+	}
+}
+
+/* Make a root view read the latest version */
+static void
+refresh(lua_State *L, int idx, struct store_view *view)
+{
+	struct store_version *v = acquire(view->store);
+
+	if (v == NULL) {
+		return;
+	}
+
+	push_version(L, v);
+	lua_setiuservalue(L, idx, 1);
+	view->v = v;
+	view->generation = v->generation;
+	view->table = ((const struct region_header *)v->base)->root;
+}
+
+static struct store_view *
+check_view(lua_State *L, int idx)
+{
+	struct store_view *view = luaL_checkudata(L, idx, VIEW_METATABLE);
+
+	if (view->store != NULL &&
+	    atomic_load_explicit(&view->store->generation,
+		memory_order_acquire) != view->generation) {
+		refresh(L, lua_absindex(L, idx), view);
+	}
+
+	return view;
+}
+
+/* Table of a view, NULL for a store published nothing yet */
+static const struct store_table *
+view_table(const struct store_view *view)
+{
+	if (view->v == NULL) {
+		return NULL;
+	}
+
+	return (const struct store_table *)(view->v->base + view->table);
+}
+
+/* Slot of the key at `idx`, NULL if absent */
+static const struct store_slot *
+find(lua_State *L, const struct store_view *view, int idx)
+{
+	const struct store_table *t = view_table(view);
+	const char *s = NULL;
+	size_t len = 0;
+	lua_Integer key = 0;
+	uint32_t hash;
+	int isnum;
+
+	if (t == NULL) {
+		return NULL;
+	}
+
+	if (lua_type(L, idx) == LUA_TSTRING) {
+		s = lua_tolstring(L, idx, &len);
+		hash = hash_string(s, len);
+	} else {
+		key = lua_tointegerx(L, idx, &isnum);
+		if (!isnum) {
+			return NULL;
+		}
+		hash = hash_integer(key);
+	}
+
+	const struct store_slot *slots = TABLE_SLOTS(t);
+
+	for (uint32_t i = hash & t->mask; slots[i].key_type != T_NONE;
+	     i = (i + 1) & t->mask) {
+		const struct store_slot *slot = &slots[i];
+
+		if (slot->hash != hash) {
+			continue;
+		}
+		if (s != NULL ?
+			(slot->key_type == T_STRING && slot->key_len == len &&
+			    memcmp(view->v->base + slot->key, s, len) == 0) :
+			(slot->key_type == T_INTEGER &&
+			    (lua_Integer)slot->key == key)) {
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+static int
+view_index(lua_State *L)
+{
+	struct store_view *view = check_view(L, 1);
+	const struct store_slot *slot = find(L, view, 2);
+
+	if (slot == NULL) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_getiuservalue(L, 1, 1);
+	push_value(L, lua_gettop(L), view->v, slot);
+
+	return 1;
+}
+
+static int
+view_newindex(lua_State *L)
+{
+	return luaL_error(L, "shared store is read-only");
+}
+
+static int
+view_len(lua_State *L)
+{
+	const struct store_table *t = view_table(check_view(L, 1));
+
+	lua_pushinteger(L, t != NULL ? (lua_Integer)t->len : 0);
+
+	return 1;
+}
+
+static int
+view_next(lua_State *L)
+{
+	struct store_view *view = luaL_checkudata(L, 1, VIEW_METATABLE);
+	const struct store_table *t = view_table(view);
+	uint32_t i = 0;
+
+	if (t == NULL) {
+		return 0;
+	}
+
+	const struct store_slot *slots = TABLE_SLOTS(t);
+
+	if (!lua_isnil(L, 2)) {
+		const struct store_slot *slot = find(L, view, 2);
+
+		if (slot == NULL) {
+			return luaL_error(L, "invalid key to 'next'");
+		}
+		i = slot - slots + 1;
+	}
+
+	lua_settop(L, 2);
+	lua_getiuservalue(L, 1, 1); /* 3: version */
+
+	for (; i <= t->mask; i++) {
+		if (slots[i].key_type == T_STRING) {
+			push_string(L, view->v, slots[i].key, slots[i].key_len);
+		} else if (slots[i].key_type == T_INTEGER) {
+			lua_pushinteger(L, (lua_Integer)slots[i].key);
+		} else {
+			continue;
+		}
+		push_value(L, 3, view->v, &slots[i]);
+		return 2;
+	}
+
+	return 0;
+}
+
+static int
+view_pairs(lua_State *L)
+{
+	struct store_view *view = check_view(L, 1);
+
+	lua_pushcfunction(L, view_next);
+
+	/* Root views iterate the version of now, not the latest */
+	if (view->store != NULL && view->v != NULL) {
+		lua_getiuservalue(L, 1, 1);
+		push_table(L, lua_gettop(L), view->table);
+		lua_remove(L, -2);
+	} else {
+		lua_pushvalue(L, 1);
+	}
+	lua_pushnil(L);
+
+	return 3;
+}
+
+static int
+view_gc(lua_State *L)
+{
+	struct store_view *view = luaL_checkudata(L, 1, VIEW_METATABLE);
+
+	if (view->store != NULL) {
+		shared_store_release(view->store);
+		view->store = NULL;
+	}
+
+	return 0;
+}
+
+static int
+version_gc(lua_State *L)
+{
+	struct store_version **ud = luaL_checkudata(L, 1, VERSION_METATABLE);
+
+	version_release(*ud);
+	*ud = NULL;
+
+	return 0;
+}
+
+static const luaL_Reg view_meta[] = {
+	{ "__index", view_index },
+	{ "__newindex", view_newindex },
+	{ "__len", view_len },
+	{ "__pairs", view_pairs },
+	{ "__gc", view_gc },
+	{ NULL, NULL },
+};
+
+static void
+create_metatables(lua_State *L)
+{
+	if (luaL_newmetatable(L, VIEW_METATABLE)) {
+		luaL_setfuncs(L, view_meta, 0);
+	}
+	lua_pop(L, 1);
+
+	if (luaL_newmetatable(L, VERSION_METATABLE)) {
+		lua_pushcfunction(L, version_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_pop(L, 1);
+}
+
+void
+shared_store_push(lua_State *L, struct shared_store *s)
+{
+	create_metatables(L);
+
+	struct store_view *view = lua_newuserdatauv(L, sizeof(*view), 1);
+
+	shared_store_retain(s);
+	view->store = s;
+	view->v = NULL;
+	view->generation = 0;
+	view->table = 0;
+	luaL_setmetatable(L, VIEW_METATABLE);
+	refresh(L, lua_gettop(L), view);
+}
+
+/*
+ * The library
+ */
+
+/* Named store, created on first use. They live as long as the process */
+static struct shared_store *
+named(lua_State *L, const char *name)
+{
+	struct shared_store *s;
+
+	pthread_mutex_lock(&named_lock);
+	for (s = named_stores; s != NULL; s = s->next) {
+		if (strcmp(s->name, name) == 0) {
+			break;
+		}
+	}
+
+	if (s == NULL && (s = shared_store_create()) != NULL) {
+		if ((s->name = strdup(name)) == NULL) {
+			shared_store_release(s);
+			s = NULL;
+		} else {
+			s->next = named_stores;
+			named_stores = s;
+		}
+	}
+	pthread_mutex_unlock(&named_lock);
+
+	if (s == NULL) {
+		luaL_error(L, "not enough memory");
+	}
+
+	return s;
+}
+
+static int
+store_open(lua_State *L)
+{
+	shared_store_push(L, named(L, luaL_checkstring(L, 1)));
+
+	return 1;
+}
+
+static int
+store_publish(lua_State *L)
+{
+	struct shared_store *s = named(L, luaL_checkstring(L, 1));
+
+	if (shared_store_publish(s, L, 2) != 0) {
+		return luaL_error(L, "can't map the store: %s",
+		    strerror(errno));
+	}
+	lua_pushinteger(L, shared_store_generation(s));
+
+	return 1;
+}
+
+static int
+store_generation(lua_State *L)
+{
+	struct shared_store *s = named(L, luaL_checkstring(L, 1));
+
+	lua_pushinteger(L, shared_store_generation(s));
+
+	return 1;
+}
+
+static int
+store_save(lua_State *L)
+{
+	const char *path = luaL_checkstring(L, 2);
+
+	return luaL_fileresult(L, shared_store_save(L, 1, path) == 0, path);
+}
+
+static int
+store_load(lua_State *L)
+{
+	struct shared_store *s = named(L, luaL_checkstring(L, 1));
+	const char *path = luaL_checkstring(L, 2);
+
+	if (shared_store_publish_file(s, path) != 0) {
+		return luaL_fileresult(L, 0, path);
+	}
+	lua_pushinteger(L, shared_store_generation(s));
+
+	return 1;
+}
+
+static const luaL_Reg store_funcs[] = {
+	{ "open", store_open },
+	{ "publish", store_publish },
+	{ "generation", store_generation },
+	{ "save", store_save },
+	{ "load", store_load },
+	{ NULL, NULL },
+};
+
+int
+luaopen_shared_store(lua_State *L)
+{
+	create_metatables(L);
+	luaL_newlib(L, store_funcs);
+
+	return 1;
+}
@@ -0,0 +1,104 @@
+#ifndef SHARED_STORE_H
+#define SHARED_STORE_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <lua.h>
+
+/* Deepest table nesting a store can hold. */
+#define SHARED_STORE_MAX_DEPTH 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Read-only data shared by every Lua state of the process.
+ *
+ * A Lua table (booleans, numbers, strings and nested tables of them, with
+ * string or integer keys) is built once into a single mmap'd region: one
+ * open-addressing hash table per Lua table, 32-byte slots, strings stored
+ * once. States read it through view userdata with __index, __len and
+ * __pairs, no copy is made and no lock is taken.
+ *
+ * Publishing a new version swaps it in atomically. A store's root view
+ * always reads the latest version, a nested table keeps the version it
+ * was read from; versions are unmapped when the last view goes away.
+ * Regions can also be saved to a file and mapped back, even by another
+ * process; a loaded region is checked whole before it's published.
+ */
+struct shared_store;
+
+/* Create an empty store. Returns NULL if out of memory. */
+struct shared_store *shared_store_create(void);
+
+/* Reference counting, the store is freed with its last reference. */
+void shared_store_retain(struct shared_store *s);
+void shared_store_release(struct shared_store *s);
+
+/*
+ * Build the table at `idx` and publish it as the new version. Raises an
+ * error on values that can't be stored, returns 0 or -1 (errno set) if
+ * the region can't be mapped.
+ */
+int shared_store_publish(struct shared_store *s, lua_State *L, int idx);
+
+/*
+ * Publish the region saved in `path`. Returns 0 or -1 (errno set, EINVAL
+ * for a file that isn't a valid region).
+ */
+int shared_store_publish_file(struct shared_store *s, const char *path);
+
+/* Build the table at `idx` into the file `path`. Returns 0 or -1. */
+int shared_store_save(lua_State *L, int idx, const char *path);
+
+/* Number of versions published so far. */
+uint64_t shared_store_generation(struct shared_store *s);
+
+/* Push the root view of the store (takes its own reference). */
+void shared_store_push(lua_State *L, struct shared_store *s);
+
+/*
+ * Open the `shared_store` library, on process wide named stores:
+ *   shared_store.open(name)          root view, nil fields until published
+ *   shared_store.publish(name, t)    returns the new generation
+ *   shared_store.generation(name)
+ *   shared_store.save(t, path)       true, or nil and an error message
+ *   shared_store.load(name, path)    publish a saved file, same results
+ */
+int luaopen_shared_store(lua_State *L);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SHARED_STORE_H */
@@ -0,0 +1,302 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "examples.h"
+#include "state_pool.h"
+#include "stdlibs.h"
+
+struct state_pool {
+	pthread_mutex_t lock;
+	int alloc_flags;
+	size_t size;  /* capacity of `idle` */
+	size_t count; /* warm states in `idle` */
+	lua_State **idle;
+	struct state_pool_stats stats;
+};
+
+/* Registry keys of the snapshot taken right after the state is built. */
+static const char baseline_globals_key = 'G';
+static const char baseline_loaded_key = 'L';
+static const char baseline_meta_key = 'M';
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Store a shallow copy of the table at `idx` in the registry under `key`.
+ */
+static void
+snapshot_table(lua_State *L, int idx, const void *key)
+{
+	idx = lua_absindex(L, idx);
+	lua_newtable(L);
+
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, -4);
+	}
+
+	lua_rawsetp(L, LUA_REGISTRYINDEX, key);
+}
+
+/**
+ * Make the table at `idx` equal to the copy stored under `key` again.
+ */
+static void
+restore_table(lua_State *L, int idx, const void *key)
+{
+	idx = lua_absindex(L, idx);
+	lua_rawgetp(L, LUA_REGISTRYINDEX, key);
+	int base = lua_gettop(L);
+
+	/* Drop entries created after the snapshot (clearing is allowed) */
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		lua_pop(L, 1);
+		lua_pushvalue(L, -1);
+		if (lua_rawget(L, base) == LUA_TNIL) {
+			lua_pushvalue(L, -2);
+			lua_pushnil(L);
+			lua_rawset(L, idx);
+		}
+		lua_pop(L, 1);
+	}
+
+	/* Put back entries removed or replaced */
+	lua_pushnil(L);
+	while (lua_next(L, base) != 0) {
+		lua_pushvalue(L, -2);
+		lua_rawget(L, idx);
+		if (!lua_rawequal(L, -1, -2)) {
+			lua_pop(L, 1);
+			lua_pushvalue(L, -2);
+			lua_insert(L, -2);
+			lua_rawset(L, idx);
+		} else {
+			lua_pop(L, 2);
+		}
+	}
+
+	lua_pop(L, 1);
+}
+
+/* Protected part of the state setup. */
+static int
+snapshot_state(lua_State *L)
+{
+	lua_pushglobaltable(L);
+	snapshot_table(L, -1, &baseline_globals_key);
+
+	if (!lua_getmetatable(L, -1)) {
+		lua_pushboolean(L, 0);
+	}
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &baseline_meta_key);
+
+	luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+	snapshot_table(L, -1, &baseline_loaded_key);
+
+	return 0;
+}
+
+/* Protected part of the state reset. */
+static int
+reset_state(lua_State *L)
+{
+	lua_pushglobaltable(L);
+	restore_table(L, -1, &baseline_globals_key);
+
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &baseline_meta_key);
+	if (lua_isboolean(L, -1)) {
+		lua_pop(L, 1);
+		lua_pushnil(L);
+	}
+	lua_setmetatable(L, -2);
+
+	luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+	restore_table(L, -1, &baseline_loaded_key);
+
+	/* Give the collector a chance to reclaim the previous user garbage */
+	lua_gc(L, LUA_GCSTEP, 0);
+
+	return 0;
+}
+
+/**
+ * Build a state the same way the REPL does and take its baseline snapshot.
+ */
+static lua_State *
+state_new(struct state_pool *pool)
+{
+	lua_State *L = allocator_newstate(pool->alloc_flags);
+
+	if (L == NULL) {
+		return NULL;
+	}
+
+	stdlibs_open(L);
+	setup_interpreter_globals(L);
+
+	lua_pushcfunction(L, snapshot_state);
+	if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+		fprintf(stderr, "state_pool: %s\n", lua_tostring(L, -1));
+		allocator_close(L);
+		return NULL;
+	}
+
+	return L;
+}
+
+struct state_pool *
+state_pool_create(size_t size, int alloc_flags)
+{
+	struct state_pool *pool = calloc(1, sizeof(*pool));
+
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->idle = calloc(size > 0 ? size : 1, sizeof(*pool->idle));
+	if (pool->idle == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->alloc_flags = alloc_flags;
+	pool->size = size;
+
+	/* Pre-warm every slot */
+	while (pool->count < pool->size) {
+		lua_State *L = state_new(pool);
+
+		if (L == NULL) {
+			break;
+		}
+		pool->idle[pool->count++] = L;
+	}
+
+	pool->stats.idle = pool->count;
+
+	return pool;
+}
+
+void
+state_pool_destroy(struct state_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	while (pool->count > 0) {
+		allocator_close(pool->idle[--pool->count]);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->idle);
+	free(pool);
+}
+
+lua_State *
+state_pool_acquire(struct state_pool *pool)
+{
+	lua_State *L = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->count > 0) {
+		L = pool->idle[--pool->count];
+		pool->stats.hits++;
+	} else {
+		pool->stats.misses++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Build the state outside of the lock */
+	if (L == NULL) {
+		L = state_new(pool);
+	}
+
+	return L;
+}
+
+void
+state_pool_release(struct state_pool *pool, lua_State *L)
+{
+	uint64_t start = now_ns();
+	int ok;
+
+	lua_settop(L, 0);
+	lua_pushcfunction(L, reset_state);
+	ok = lua_pcall(L, 0, 0, 0) == LUA_OK;
+
+	uint64_t elapsed = now_ns() - start;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stats.reset_ns += elapsed;
+	if (ok && pool->count < pool->size) {
+		pool->idle[pool->count++] = L;
+		pool->stats.resets++;
+		L = NULL;
+	} else {
+		pool->stats.discarded++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Pool full or reset failed */
+	if (L != NULL) {
+		allocator_close(L);
+	}
+}
+
+void
+state_pool_stats(struct state_pool *pool, struct state_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool->lock);
+	*stats = pool->stats;
+	stats->idle = pool->count;
+	pthread_mutex_unlock(&pool->lock);
+}
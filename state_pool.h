@@ -0,0 +1,82 @@
+#ifndef STATE_POOL_H
+#define STATE_POOL_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lua.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+struct state_pool;
+
+/* Pool counters, see state_pool_stats. */
+struct state_pool_stats {
+	uint64_t hits;	    /* acquires served by a warm state */
+	uint64_t misses;    /* acquires that had to build a new state */
+	uint64_t resets;    /* states reset and returned to the pool */
+	uint64_t discarded; /* states closed on release (pool full or error) */
+	uint64_t reset_ns;  /* total time spent resetting states */
+	size_t idle;	    /* warm states waiting in the pool */
+};
+
+/*
+ * Create a pool holding up to `size` states, all of them are created
+ * upfront with the standard libraries (see stdlibs_open) and the REPL
+ * globals installed.
+ * `alloc_flags` selects the allocator strategy (see allocator.h).
+ */
+struct state_pool *state_pool_create(size_t size, int alloc_flags);
+
+/* Close every idle state and free the pool. */
+void state_pool_destroy(struct state_pool *pool);
+
+/* Take a ready to use state, a new one is built if the pool is empty. */
+lua_State *state_pool_acquire(struct state_pool *pool);
+
+/*
+ * Give back a state. Globals (and package.loaded entries) created or
+ * replaced since the state was built are restored, the reset is shallow:
+ * fields changed inside the original tables are kept.
+ */
+void state_pool_release(struct state_pool *pool, lua_State *L);
+
+/* Copy the pool counters. */
+void state_pool_stats(struct state_pool *pool, struct state_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* STATE_POOL_H */
@@ -0,0 +1,348 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "stdlibs.h"
+
+static const struct {
+	const char *name;
+	lua_CFunction open;
+	unsigned flag;
+} libs[] = {
+	{ LUA_COLIBNAME, luaopen_coroutine, STDLIBS_COROUTINE },
+	{ LUA_TABLIBNAME, luaopen_table, STDLIBS_TABLE },
+	{ LUA_IOLIBNAME, luaopen_io, STDLIBS_IO },
+	{ LUA_OSLIBNAME, luaopen_os, STDLIBS_OS },
+	{ LUA_STRLIBNAME, luaopen_string, STDLIBS_STRING },
+	{ LUA_MATHLIBNAME, luaopen_math, STDLIBS_MATH },
+	{ LUA_UTF8LIBNAME, luaopen_utf8, STDLIBS_UTF8 },
+	{ LUA_DBLIBNAME, luaopen_debug, STDLIBS_DEBUG },
+};
+
+#define NLIBS (sizeof(libs) / sizeof(libs[0]))
+
+/* Written before the states are created, read-only after that. */
+static unsigned profile = STDLIBS_ALL;
+
+/* Whether the `len` bytes at `s` are `name`. */
+static int
+is_name(const char *s, size_t len, const char *name)
+{
+	return strlen(name) == len && strncmp(s, name, len) == 0;
+}
+
+int
+stdlibs_parse(const char *list, unsigned *eager)
+{
+	unsigned mask = 0;
+
+	while (*list != '\0') {
+		size_t len = strcspn(list, ",");
+		size_t i = 0;
+
+		if (is_name(list, len, "all")) {
+			mask |= STDLIBS_ALL;
+		} else if (len > 0 && !is_name(list, len, "base") &&
+		    !is_name(list, len, "package")) {
+			while (i < NLIBS && !is_name(list, len, libs[i].name)) {
+				i++;
+			}
+			if (i == NLIBS) {
+				return -1;
+			}
+			mask |= libs[i].flag;
+		}
+
+		list += len;
+		if (*list == ',') {
+			list++;
+		}
+	}
+
+	*eager = mask;
+	return 0;
+}
+
+void
+stdlibs_set_profile(unsigned eager)
+{
+	profile = eager & STDLIBS_ALL;
+}
+
+/**
+ * __index of the global table: build the library named `k` if it's one
+ * of the stubs (upvalue, set of names) and make it a global.
+ *
+ * This is `require` without the searchers: package.loaded[k], else the
+ * opener in package.preload, so one replaced there (see
+ * stdlibs_replace_io_write) runs on the first use either way.
+ */
+static int
+lazy_global(lua_State *L)
+{
+	if (lua_type(L, 2) != LUA_TSTRING) {
+		return 0;
+	}
+
+	const char *name = lua_tostring(L, 2);
+
+	lua_pushvalue(L, 2);
+	if (lua_rawget(L, lua_upvalueindex(1)) == LUA_TNIL) {
+		return 0;
+	}
+
+	luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+	if (lua_getfield(L, -1, name) == LUA_TNIL) {
+		lua_pop(L, 1);
+		luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+		if (lua_getfield(L, -1, name) != LUA_TFUNCTION) {
+			return 0;
+		}
+		lua_pushvalue(L, 2);
+		lua_call(L, 1, 1);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -4, name);
+	}
+
+	lua_pushvalue(L, -1);
+	lua_setfield(L, 1, name);
+	return 1;
+}
+
+/* Metamethods of the string metatable, string arithmetic coerces */
+static const struct {
+	const char *event;
+	int op;
+} string_arith[] = {
+	{ "__add", LUA_OPADD },
+	{ "__sub", LUA_OPSUB },
+	{ "__mul", LUA_OPMUL },
+	{ "__mod", LUA_OPMOD },
+	{ "__pow", LUA_OPPOW },
+	{ "__div", LUA_OPDIV },
+	{ "__idiv", LUA_OPIDIV },
+	{ "__unm", LUA_OPUNM },
+};
+
+#define NARITH (sizeof(string_arith) / sizeof(string_arith[0]))
+
+static int lazy_string(lua_State *L);
+
+/**
+ * Build the string library (pushed) for a string metatable stub. If it
+ * was loaded without luaopen_string running, by a package.loaded entry
+ * set by hand, the stub would stay and call itself: run it then.
+ */
+static void
+load_string(lua_State *L)
+{
+	luaL_requiref(L, LUA_STRLIBNAME, luaopen_string, 1);
+
+	lua_pushliteral(L, "");
+	if (lua_getmetatable(L, -1)) {
+		lua_getfield(L, -1, "__index");
+		if (lua_tocfunction(L, -1) == lazy_string) {
+			lua_pushcfunction(L, luaopen_string);
+			lua_call(L, 0, 0);
+		}
+		lua_pop(L, 2);
+	}
+	lua_pop(L, 1);
+}
+
+/**
+ * __index of the string metatable until the string library is built:
+ * build it and look `k` up.
+ */
+static int
+lazy_string(lua_State *L)
+{
+	load_string(L);
+
+	lua_pushvalue(L, 2);
+	lua_gettable(L, -2);
+	return 1;
+}
+
+/**
+ * Arithmetic metamethod of the stub (operation as upvalue): build the
+ * string library and do the operation again, with its metamethods.
+ */
+static int
+lazy_arith(lua_State *L)
+{
+	int op = (int)lua_tointeger(L, lua_upvalueindex(1));
+
+	load_string(L);
+	lua_pop(L, 1);
+
+	/* __unm gets its operand twice */
+	lua_settop(L, op == LUA_OPUNM ? 1 : 2);
+	lua_arith(L, op);
+	return 1;
+}
+
+void
+stdlibs_open_profile(lua_State *L, unsigned eager)
+{
+	int nlazy = 0;
+
+	luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+	luaL_requiref(L, LUA_LOADLIBNAME, luaopen_package, 1);
+	lua_pop(L, 2);
+
+	for (size_t i = 0; i < NLIBS; i++) {
+		if (eager & libs[i].flag) {
+			luaL_requiref(L, libs[i].name, libs[i].open, 1);
+			lua_pop(L, 1);
+		} else {
+			nlazy++;
+		}
+	}
+
+	if (nlazy == 0) {
+		return;
+	}
+
+	/* package.preload[name] = luaopen function, stubs[name] = true */
+	luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+	lua_createtable(L, 0, nlazy);
+	for (size_t i = 0; i < NLIBS; i++) {
+		if (!(eager & libs[i].flag)) {
+			lua_pushcfunction(L, libs[i].open);
+			lua_setfield(L, -3, libs[i].name);
+			lua_pushboolean(L, 1);
+			lua_setfield(L, -2, libs[i].name);
+		}
+	}
+
+	lua_pushglobaltable(L);
+	lua_createtable(L, 0, 1);
+	lua_pushvalue(L, -3);
+	lua_pushcclosure(L, lazy_global, 1);
+	lua_setfield(L, -2, "__index");
+	lua_setmetatable(L, -2);
+	lua_pop(L, 3);
+
+	if (!(eager & STDLIBS_STRING)) {
+		lua_pushliteral(L, "");
+		lua_createtable(L, 0, NARITH + 1);
+		lua_pushcfunction(L, lazy_string);
+		lua_setfield(L, -2, "__index");
+		for (size_t i = 0; i < NARITH; i++) {
+			lua_pushinteger(L, string_arith[i].op);
+			lua_pushcclosure(L, lazy_arith, 1);
+			lua_setfield(L, -2, string_arith[i].event);
+		}
+		lua_setmetatable(L, -2);
+		lua_pop(L, 1);
+	}
+}
+
+void
+stdlibs_open(lua_State *L)
+{
+	stdlibs_open_profile(L, profile);
+}
+
+/**
+ * Replace write in the io table on top by `write` closed over the value
+ * right below, the stock io.write, io.output and io.stdout.
+ */
+static void
+patch_write(lua_State *L, lua_CFunction write)
+{
+	lua_pushvalue(L, -2);
+	lua_getfield(L, -2, "write");
+	lua_getfield(L, -3, "output");
+	lua_getfield(L, -4, "stdout");
+	lua_pushcclosure(L, write, 4);
+	lua_setfield(L, -2, "write");
+}
+
+/**
+ * package.preload.io of a state where io isn't built yet. Upvalues: the
+ * value, the replacement write and the original opener, whose io table
+ * gets patched.
+ */
+static int
+open_io(lua_State *L)
+{
+	lua_pushvalue(L, lua_upvalueindex(3));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, 1);
+
+	if (lua_istable(L, -1)) {
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_insert(L, -2);
+		patch_write(L, lua_tocfunction(L, lua_upvalueindex(2)));
+	}
+
+	return 1;
+}
+
+void
+stdlibs_replace_io_write(lua_State *L, lua_CFunction write)
+{
+	/*
+	 * Read io raw: with a lazy io the global stub would build it. Not
+	 * built yet, it's patched once the opener runs.
+	 */
+	lua_pushglobaltable(L);
+	lua_pushliteral(L, "io");
+	if (lua_rawget(L, -2) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+		lua_getfield(L, -1, "io");
+		lua_remove(L, -2);
+	}
+	lua_remove(L, -2);
+
+	if (lua_istable(L, -1)) {
+		patch_write(L, write);
+	} else {
+		luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+		if (lua_getfield(L, -1, "io") == LUA_TFUNCTION) {
+			lua_pushvalue(L, -4);
+			lua_pushcfunction(L, write);
+			lua_rotate(L, -3, 2); /* value, write, opener */
+			lua_pushcclosure(L, open_io, 3);
+			lua_setfield(L, -2, "io");
+		} else {
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 2);
+}
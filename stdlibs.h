@@ -0,0 +1,92 @@
+#ifndef STDLIBS_H
+#define STDLIBS_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <lua.h>
+
+/* Standard libraries of a profile, base and package are always open. */
+#define STDLIBS_COROUTINE 0x01
+#define STDLIBS_TABLE	  0x02
+#define STDLIBS_IO	  0x04
+#define STDLIBS_OS	  0x08
+#define STDLIBS_STRING	  0x10
+#define STDLIBS_MATH	  0x20
+#define STDLIBS_UTF8	  0x40
+#define STDLIBS_DEBUG	  0x80
+#define STDLIBS_ALL	  0xff
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * State setup profiles.
+ *
+ * A profile is the set of libraries opened eagerly, as luaL_openlibs
+ * does. The others cost nothing until used: they are registered in
+ * package.preload, so `require` builds them, and the global table gets a
+ * metatable whose __index builds a library (and sets its global) the
+ * first time its name is read. If the string library is left out, the
+ * string metatable gets a stub too so methods (`s:upper()`) and string
+ * arithmetic coercion (`"10" + 1`) keep working.
+ *
+ * A state replacing the global table metatable loses the stubs, `require`
+ * still works. Reading a cleared library global builds it again.
+ */
+
+/*
+ * Parse a comma separated list of library names ("string,table"), "all"
+ * for every one. "base" and "package" are accepted and ignored. Returns
+ * 0 or -1 on an unknown name.
+ */
+int stdlibs_parse(const char *list, unsigned *eager);
+
+/* Profile used by stdlibs_open, STDLIBS_ALL unless set. */
+void stdlibs_set_profile(unsigned eager);
+
+/* Open base, package and the `eager` libraries, the others lazily. */
+void stdlibs_open_profile(lua_State *L, unsigned eager);
+
+/* Same with the profile from stdlibs_set_profile. */
+void stdlibs_open(lua_State *L);
+
+/*
+ * Replace io.write in L by `write`, a closure over the value on top of
+ * the stack (popped), the stock io.write, io.output and io.stdout. A lazy
+ * io gets it when it's built.
+ */
+void stdlibs_replace_io_write(lua_State *L, lua_CFunction write);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* STDLIBS_H */
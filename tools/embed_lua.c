@@ -0,0 +1,165 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Build tool: compile a Lua script and write a C header with its stripped
+ * bytecode (NAME_bytecode) and its original source (NAME_source), NAME being
+ * the script file name without extension.
+ *
+ * It links the same Lua library as the program, so the bytecode format
+ * always matches the one luaL_loadbufferx expects at runtime.
+ *
+ * Usage: embed_lua input.lua output.h
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "examples.h"
+
+struct output {
+	FILE *fp;
+	size_t count;
+};
+
+static void
+write_bytes(struct output *out, const unsigned char *p, size_t sz)
+{
+	for (size_t i = 0; i < sz; i++, out->count++) {
+		fprintf(out->fp, "%s0x%02x,", out->count % 12 ? " " : "\n\t",
+		    p[i]);
+	}
+}
+
+static int
+writer(__UNUSED lua_State *L, const void *p, size_t sz, void *ud)
+{
+	write_bytes(ud, p, sz);
+	return 0;
+}
+
+/**
+ * Build the C symbol prefix from the script path.
+ */
+static void
+symbol_name(const char *path, char *name, size_t size)
+{
+	const char *base = strrchr(path, '/');
+	size_t i;
+
+	base = base != NULL ? base + 1 : path;
+
+	for (i = 0; i + 1 < size && base[i] != '\0' && base[i] != '.'; i++) {
+		name[i] = isalnum((unsigned char)base[i]) ? base[i] : '_';
+	}
+	name[i] = '\0';
+}
+
+int
+main(int argc, char **argv)
+{
+	char name[128];
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s input.lua output.h\n", argv[0]);
+		return 1;
+	}
+
+	symbol_name(argv[1], name, sizeof(name));
+
+	lua_State *L = luaL_newstate();
+
+	/* Read the source once, it is compiled and embedded as is */
+	FILE *in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	luaL_Buffer b;
+	char chunk[4096];
+	size_t n;
+
+	luaL_buffinit(L, &b);
+	while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+		luaL_addlstring(&b, chunk, n);
+	}
+	fclose(in);
+	luaL_pushresult(&b);
+
+	size_t len;
+	const char *src = lua_tolstring(L, -1, &len);
+
+	if (luaL_loadbufferx(L, src, len, argv[1], "t") != LUA_OK) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return 1;
+	}
+
+	FILE *fp = fopen(argv[2], "w");
+	if (fp == NULL) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	struct output out = { fp, 0 };
+
+	fprintf(fp, "/* Generated by embed_lua from %s, do not edit. */\n\n",
+	    argv[1]);
+
+	fprintf(fp, "static const unsigned char %s_bytecode[] = {", name);
+	if (lua_dump(L, writer, &out, 1) != 0) {
+		fprintf(stderr, "%s: can't dump bytecode\n", argv[1]);
+		fclose(fp);
+		remove(argv[2]);
+		return 1;
+	}
+	fprintf(fp, "\n};\n\n");
+
+	/* Keep the source around (NUL terminated) to compare both loads */
+	out.count = 0;
+	fprintf(fp, "static const unsigned char %s_source[] = {", name);
+	write_bytes(&out, (const unsigned char *)src, len + 1);
+	fprintf(fp, "\n};\n");
+
+	lua_close(L);
+
+	if (fclose(fp) != 0) {
+		perror(argv[2]);
+		remove(argv[2]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Load generator for the REPL server (see repl_server.h).
+ *
+ * Opens SESSIONS connections and keeps every one of them evaluating LINE
+ * for SECONDS, sending the next line as soon as the prompt comes back.
+ * Reports the sessions held, the evaluations per second and their
+ * latency.
+ *
+ * Usage: repl_load PATH [SESSIONS [SECONDS [LINE]]]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SESSIONS 1000
+#define DEFAULT_SECONDS	 5
+#define DEFAULT_LINE	 "x = (x or 0) + 1"
+
+#define MAX_EVENTS 256
+
+struct client {
+	int fd;
+	char tail[2];  /* last bytes received, the prompt is "> " */
+	uint64_t sent; /* when the line went out, 0 before the first prompt */
+};
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* One descriptor per session, ask for as many as allowed. */
+static void
+raise_fd_limit(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+}
+
+static int
+connect_unix(const char *path)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * Read what arrived, returns 1 when the prompt came back, 0 if not yet
+ * and -1 if the session is over.
+ */
+static int
+client_read(struct client *c)
+{
+	char buf[4096];
+	int prompt = 0;
+
+	for (;;) {
+		ssize_t n = read(c->fd, buf, sizeof(buf));
+
+		if (n == 0) {
+			return -1;
+		}
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno == EAGAIN ? prompt : -1;
+		}
+
+		if (n >= 2) {
+			memcpy(c->tail, buf + n - 2, 2);
+		} else {
+			c->tail[0] = c->tail[1];
+			c->tail[1] = buf[0];
+		}
+		prompt = c->tail[0] == '>' && c->tail[1] == ' ';
+	}
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s PATH [SESSIONS [SECONDS [LINE]]]\n",
+		    argv[0]);
+		return 1;
+	}
+
+	const char *path = argv[1];
+	long sessions = argc > 2 ? strtol(argv[2], NULL, 10)
+				 : DEFAULT_SESSIONS;
+	long seconds = argc > 3 ? strtol(argv[3], NULL, 10) : DEFAULT_SECONDS;
+	const char *line = argc > 4 ? argv[4] : DEFAULT_LINE;
+
+	char msg[1024];
+	int msglen = snprintf(msg, sizeof(msg), "%s\n", line);
+
+	if (sessions <= 0 || msglen < 0 || (size_t)msglen >= sizeof(msg)) {
+		fprintf(stderr, "bad arguments\n");
+		return 1;
+	}
+
+	raise_fd_limit();
+
+	struct client *clients = calloc(sessions, sizeof(*clients));
+	size_t cap = 1 << 20;
+	uint64_t *latency = malloc(cap * sizeof(*latency));
+	int epfd = epoll_create1(0);
+
+	if (clients == NULL || latency == NULL || epfd < 0) {
+		perror("repl_load");
+		return 1;
+	}
+
+	/* Open the sessions */
+	long held = 0;
+
+	for (long i = 0; i < sessions; i++) {
+		struct client *c = &clients[held];
+		struct epoll_event ev = { EPOLLIN, { .ptr = c } };
+
+		c->fd = connect_unix(path);
+		if (c->fd < 0) {
+			perror(path);
+			break;
+		}
+		epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+		held++;
+	}
+	printf("sessions held: %ld of %ld\n", held, sessions);
+
+	/* Keep every session busy */
+	struct epoll_event events[MAX_EVENTS];
+	uint64_t start = now_ns();
+	uint64_t end = start + seconds * 1000000000ull;
+	uint64_t evals = 0;
+	size_t nlat = 0;
+	long lost = 0;
+
+	while (now_ns() < end && lost < held) {
+		int n = epoll_wait(epfd, events, MAX_EVENTS, 100);
+
+		for (int i = 0; i < n; i++) {
+			struct client *c = events[i].data.ptr;
+			int ready = client_read(c);
+
+			if (ready < 0) {
+				epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+				lost++;
+				continue;
+			}
+			if (ready == 0) {
+				continue;
+			}
+
+			uint64_t now = now_ns();
+
+			if (c->sent != 0) {
+				evals++;
+				if (nlat < cap) {
+					latency[nlat++] = now - c->sent;
+				}
+			}
+
+			/* Tiny line, the socket buffer has room */
+			if (write(c->fd, msg, msglen) != msglen) {
+				epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+				lost++;
+				continue;
+			}
+			c->sent = now;
+		}
+	}
+
+	double elapsed = (now_ns() - start) / 1e9;
+
+	printf("sessions lost: %ld\n", lost);
+	printf("evals: %llu in %.3f s, %.0f evals/s\n",
+	    (unsigned long long)evals, elapsed, evals / elapsed);
+
+	qsort(latency, nlat, sizeof(*latency), compare_u64);
+	if (nlat > 0) {
+		printf("latency p50 %llu us, p99 %llu us, max %llu us\n",
+		    (unsigned long long)latency[nlat / 2] / 1000,
+		    (unsigned long long)latency[nlat * 99 / 100] / 1000,
+		    (unsigned long long)latency[nlat - 1] / 1000);
+	}
+
+	for (long i = 0; i < held; i++) {
+		close(clients[i].fd);
+	}
+	close(epfd);
+	free(latency);
+	free(clients);
+
+	return 0;
+}
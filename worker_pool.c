@@ -0,0 +1,744 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+
+#include "allocator.h"
+#include "channel.h"
+#include "chunk_cache.h"
+#include "coro_pool.h"
+#include "cotrace.h"
+#include "examples.h"
+#include "stdlibs.h"
+#include "worker_pool.h"
+
+/* Slots of every work-stealing deque, power of two. */
+#define DEQUE_SIZE 1024
+
+/* Jobs a worker takes from the injection queue at once. */
+#define INJECT_BATCH 32
+
+/* Channel wakeups taken at once. */
+#define WAKE_BATCH 64
+
+struct worker_job {
+	struct worker_job *next; /* injection queue, then parked or ready */
+	struct worker_pool *pool;
+	char *src;
+	size_t len;
+	int status;
+	char *result;
+	size_t result_len;
+	atomic_int done;
+
+	/* Set aside while started, on the worker that started it */
+	lua_State *co;
+	int ref;
+	void *key; /* channel wait */
+};
+
+/*
+ * Chase-Lev work-stealing deque (C11 version by Le, Pop, Cohen and
+ * Zappa Nardelli). The owner pushes and takes at the bottom, thieves
+ * steal from the top.
+ */
+struct deque {
+	atomic_int_fast64_t top;
+	atomic_int_fast64_t bottom;
+	_Atomic(struct worker_job *) buf[DEQUE_SIZE];
+};
+
+struct worker {
+	pthread_t thread;
+	struct worker_pool *pool;
+	uint32_t seed; /* victim selection */
+	int started;
+	lua_State *L;
+	struct coro_pool *coros; /* jobs run as coroutines */
+	struct deque deque;
+
+	/* Started jobs, only this worker can resume them */
+	struct worker_job *parked; /* blocked on a channel */
+	struct worker_job *ready;  /* to resume, FIFO */
+	struct worker_job *ready_tail;
+	int ready_turn;		   /* alternate with new jobs */
+	struct channel_waker *waker;
+	atomic_int woken; /* the waker has keys */
+};
+
+struct worker_pool {
+	int nworkers;
+	struct worker *workers;
+
+	/* Injection queue for jobs submitted from outside */
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;
+	struct worker_job *head;
+	struct worker_job *tail;
+	int idle;
+	int stop;
+
+	/* Completion */
+	pthread_mutex_t done_lock;
+	pthread_cond_t done_cond;
+	size_t submitted;
+	size_t completed;
+};
+
+static int
+deque_push(struct deque *d, struct worker_job *job)
+{
+	int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+	int_fast64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+
+	if (b - t >= DEQUE_SIZE) {
+		return -1; /* full */
+	}
+
+	atomic_store_explicit(&d->buf[b & (DEQUE_SIZE - 1)], job,
+	    memory_order_release);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+
+	return 0;
+}
+
+static struct worker_job *
+deque_take(struct deque *d)
+{
+	int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+
+	b--;
+	atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int_fast64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+	struct worker_job *job = NULL;
+
+	if (t <= b) {
+		job = atomic_load_explicit(&d->buf[b & (DEQUE_SIZE - 1)],
+		    memory_order_acquire);
+		if (t == b) {
+			/* Last job, race against the thieves */
+			if (!atomic_compare_exchange_strong_explicit(&d->top,
+				&t, t + 1, memory_order_seq_cst,
+				memory_order_relaxed)) {
+				job = NULL;
+			}
+			atomic_store_explicit(&d->bottom, b + 1,
+			    memory_order_relaxed);
+		}
+	} else {
+		/* Empty */
+		atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+	}
+
+	return job;
+}
+
+static struct worker_job *
+deque_steal(struct deque *d)
+{
+	int_fast64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+	if (t >= b) {
+		return NULL;
+	}
+
+	struct worker_job *job = atomic_load_explicit(
+	    &d->buf[t & (DEQUE_SIZE - 1)], memory_order_acquire);
+
+	if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+		memory_order_seq_cst, memory_order_relaxed)) {
+		return NULL; /* lost the race */
+	}
+
+	return job;
+}
+
+/**
+ * Move a batch of jobs from the injection queue to the worker deque and
+ * return the first one. Must be called with the pool lock held.
+ */
+static struct worker_job *
+inject_locked(struct worker *w)
+{
+	struct worker_pool *pool = w->pool;
+	struct worker_job *first = pool->head;
+
+	if (first == NULL) {
+		return NULL;
+	}
+	pool->head = first->next;
+
+	for (int i = 1; i < INJECT_BATCH && pool->head != NULL; i++) {
+		if (deque_push(&w->deque, pool->head) != 0) {
+			break;
+		}
+		pool->head = pool->head->next;
+	}
+
+	if (pool->head == NULL) {
+		pool->tail = NULL;
+	} else if (pool->idle > 0) {
+		pthread_cond_signal(&pool->wakeup);
+	}
+
+	return first;
+}
+
+static struct worker_job *
+steal(struct worker *w)
+{
+	struct worker_pool *pool = w->pool;
+
+	if (pool->nworkers < 2) {
+		return NULL;
+	}
+
+	/* Start from a random victim and try every other worker once */
+	w->seed ^= w->seed << 13;
+	w->seed ^= w->seed >> 17;
+	w->seed ^= w->seed << 5;
+	int start = w->seed % pool->nworkers;
+
+	for (int i = 0; i < pool->nworkers; i++) {
+		struct worker *victim = &pool->workers[(start + i) %
+		    pool->nworkers];
+
+		if (victim == w) {
+			continue;
+		}
+
+		struct worker_job *job = deque_steal(&victim->deque);
+		if (job != NULL) {
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+ready_push(struct worker *w, struct worker_job *job)
+{
+	job->next = NULL;
+	if (w->ready_tail != NULL) {
+		w->ready_tail->next = job;
+	} else {
+		w->ready = job;
+	}
+	w->ready_tail = job;
+}
+
+static struct worker_job *
+ready_pop(struct worker *w)
+{
+	struct worker_job *job = w->ready;
+
+	w->ready = job->next;
+	if (w->ready == NULL) {
+		w->ready_tail = NULL;
+	}
+
+	return job;
+}
+
+/**
+ * Channel waker callback, from any thread: wake the worker if it sleeps.
+ * The pool lock orders it with the check in next_job.
+ */
+static void
+worker_wake(void *ud)
+{
+	struct worker *w = ud;
+
+	if (atomic_exchange(&w->woken, 1) == 0) {
+		pthread_mutex_lock(&w->pool->lock);
+		pthread_cond_broadcast(&w->pool->wakeup);
+		pthread_mutex_unlock(&w->pool->lock);
+	}
+}
+
+/**
+ * Move the parked jobs their channel woke to the ready list.
+ */
+static void
+take_wakeups(struct worker *w)
+{
+	void *keys[WAKE_BATCH];
+	size_t n;
+
+	if (atomic_load_explicit(&w->woken, memory_order_relaxed) == 0 ||
+	    atomic_exchange(&w->woken, 0) == 0) {
+		return;
+	}
+
+	do {
+		n = channel_waker_take(w->waker, keys, WAKE_BATCH);
+		for (size_t i = 0; i < n; i++) {
+			struct worker_job **p = &w->parked;
+
+			while (*p != NULL && (*p)->key != keys[i]) {
+				p = &(*p)->next;
+			}
+			if (*p != NULL) {
+				struct worker_job *job = *p;
+
+				*p = job->next;
+				ready_push(w, job);
+			}
+		}
+	} while (n == WAKE_BATCH);
+}
+
+/**
+ * Next job for the worker, a new one or one set aside, NULL once the pool
+ * is stopping and drained.
+ */
+static struct worker_job *
+next_job(struct worker *w)
+{
+	struct worker_pool *pool = w->pool;
+	struct worker_job *job;
+
+	for (;;) {
+		take_wakeups(w);
+
+		/* Resumed jobs take turns with new ones */
+		if (w->ready != NULL && (w->ready_turn = !w->ready_turn)) {
+			return ready_pop(w);
+		}
+		if ((job = deque_take(&w->deque)) != NULL) {
+			return job;
+		}
+		if ((job = steal(w)) != NULL) {
+			return job;
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		if ((job = inject_locked(w)) == NULL && w->ready == NULL &&
+		    atomic_load(&w->woken) == 0) {
+			/* Parked jobs keep the worker until they are done */
+			if (pool->stop && w->parked == NULL) {
+				pthread_mutex_unlock(&pool->lock);
+				return NULL;
+			}
+			pool->idle++;
+			pthread_cond_wait(&pool->wakeup, &pool->lock);
+			pool->idle--;
+		}
+		pthread_mutex_unlock(&pool->lock);
+
+		if (job != NULL) {
+			return job;
+		}
+	}
+}
+
+static char *
+copy_string(const char *s, size_t len)
+{
+	char *copy = malloc(len + 1);
+
+	if (copy != NULL) {
+		memcpy(copy, s, len);
+		copy[len] = '\0';
+	}
+
+	return copy;
+}
+
+/**
+ * Store the value on top of the stack as the job result, without calling
+ * any metamethod.
+ */
+static void
+store_result(lua_State *L, struct worker_job *job)
+{
+	const char *s;
+	size_t len;
+
+	switch (lua_type(L, -1)) {
+	case LUA_TNIL:
+	case LUA_TNONE:
+		return;
+	case LUA_TSTRING:
+	case LUA_TNUMBER:
+		s = lua_tolstring(L, -1, &len);
+		break;
+	case LUA_TBOOLEAN:
+		s = lua_toboolean(L, -1) ? "true" : "false";
+		len = strlen(s);
+		break;
+	default:
+		s = lua_pushfstring(L, "%s: %p", luaL_typename(L, -1),
+		    lua_topointer(L, -1));
+		len = strlen(s);
+		break;
+	}
+
+	job->result = copy_string(s, len);
+	job->result_len = job->result != NULL ? len : 0;
+}
+
+/**
+ * Set aside a job that yielded `nres` values: ("wait", key) from a blocked
+ * channel parks it until the channel wakes the key, a plain yield lets the
+ * other jobs run first. Returns 0 to resume it right away instead, after
+ * ("sleep", secs): there is no timer here, the worker sleeps too.
+ */
+static int
+pause_job(struct worker *w, struct worker_job *job, int nres)
+{
+	lua_State *co = job->co;
+	int first = lua_gettop(co) - nres + 1;
+	const char *request = "";
+
+	if (nres > 0 && lua_type(co, first) == LUA_TSTRING) {
+		request = lua_tostring(co, first);
+	}
+
+	if (strcmp(request, "wait") == 0 && nres > 1 &&
+	    lua_islightuserdata(co, first + 1)) {
+		job->key = lua_touserdata(co, first + 1);
+		job->next = w->parked;
+		w->parked = job;
+		lua_pop(co, nres);
+		return 1;
+	}
+
+	if (strcmp(request, "sleep") == 0) {
+		lua_Number secs = nres > 1 ? lua_tonumber(co, first + 1) : 0;
+
+		lua_pop(co, nres);
+		if (secs > 0) {
+			struct timespec ts = { (time_t)secs,
+				(long)((secs - (time_t)secs) * 1e9) };
+
+			nanosleep(&ts, NULL);
+		}
+		return 0;
+	}
+
+	lua_pop(co, nres);
+	ready_push(w, job);
+
+	return 1;
+}
+
+/**
+ * Load the job chunk in a new coroutine. Returns the load status, an error
+ * is left on the coroutine.
+ */
+static int
+start_job(struct worker *w, struct worker_job *job)
+{
+	struct chunk_cache *cache = chunk_cache_shared();
+
+	job->co = coro_pool_acquire(w->coros, &job->ref);
+	if (job->co == NULL) {
+		return LUA_ERRMEM;
+	}
+
+	if (cache != NULL) {
+		return chunk_cache_load(cache, job->co, job->src, job->len,
+		    "=job");
+	}
+
+	return luaL_loadbufferx(job->co, job->src, job->len, "=job", NULL);
+}
+
+static void
+finish_job(struct worker *w, struct worker_job *job, int status)
+{
+	lua_State *L = w->L;
+	struct worker_pool *pool = w->pool;
+
+	if (job->co == NULL) {
+		lua_pushliteral(L, "not enough memory");
+	} else {
+		if (status == LUA_OK) {
+			lua_settop(job->co, 1); /* first result or nil */
+		}
+		lua_xmove(job->co, L, 1);
+		coro_pool_release(w->coros, job->co, job->ref);
+		job->co = NULL;
+	}
+	job->status = status;
+	store_result(L, job);
+	lua_settop(L, 0);
+
+	pthread_mutex_lock(&pool->done_lock);
+	atomic_store_explicit(&job->done, 1, memory_order_release);
+	pool->completed++;
+	pthread_cond_broadcast(&pool->done_cond);
+	pthread_mutex_unlock(&pool->done_lock);
+}
+
+/**
+ * Run a new job, or resume one set aside, until it's done or set aside
+ * again.
+ */
+static void
+run_job(struct worker *w, struct worker_job *job)
+{
+	int status;
+	int nres;
+
+	if (job->co == NULL && (status = start_job(w, job)) != LUA_OK) {
+		finish_job(w, job, status);
+		return;
+	}
+
+	while ((status = cotrace_resume(job->co, w->L, 0, &nres)) ==
+	    LUA_YIELD) {
+		if (pause_job(w, job, nres)) {
+			return;
+		}
+	}
+
+	finish_job(w, job, status);
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct worker_job *job;
+
+	while ((job = next_job(w)) != NULL) {
+		run_job(w, job);
+	}
+
+	return NULL;
+}
+
+struct worker_pool *
+worker_pool_create(int nworkers)
+{
+	if (nworkers <= 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = ncpu > 0 ? (int)ncpu : 1;
+	}
+
+	struct worker_pool *pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->workers = calloc(nworkers, sizeof(*pool->workers));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wakeup, NULL);
+	pthread_mutex_init(&pool->done_lock, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	/* Every worker owns a state built like the REPL one */
+	for (int i = 0; i < nworkers; i++) {
+		struct worker *w = &pool->workers[i];
+
+		w->pool = pool;
+		w->seed = 2463534242u + i;
+		w->L = allocator_newstate(ALLOCATOR_POOL);
+		if (w->L == NULL) {
+			break;
+		}
+		stdlibs_open(w->L);
+		setup_interpreter_globals(w->L);
+		luaL_requiref(w->L, "channel", luaopen_channel, 1);
+		lua_pop(w->L, 1);
+		w->coros = coro_pool_create(w->L, 1, 0);
+		w->waker = channel_waker_create(worker_wake, w);
+		if (w->coros == NULL || w->waker == NULL) {
+			channel_waker_close(w->waker);
+			coro_pool_destroy(w->coros);
+			allocator_close(w->L);
+			break;
+		}
+		channel_set_waker(w->L, w->waker);
+		pool->nworkers++;
+	}
+
+	/* Thieves read nworkers, it must not change once threads run */
+	int started = 0;
+	for (int i = 0; i < pool->nworkers; i++) {
+		struct worker *w = &pool->workers[i];
+
+		if (pthread_create(&w->thread, NULL, worker_main, w) == 0) {
+			w->started = 1;
+			started++;
+		}
+	}
+
+	if (started == 0) {
+		worker_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void
+worker_pool_destroy(struct worker_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->wakeup);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->nworkers; i++) {
+		if (pool->workers[i].started) {
+			pthread_join(pool->workers[i].thread, NULL);
+		}
+		channel_waker_close(pool->workers[i].waker);
+		coro_pool_destroy(pool->workers[i].coros);
+		allocator_close(pool->workers[i].L);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wakeup);
+	pthread_mutex_destroy(&pool->done_lock);
+	pthread_cond_destroy(&pool->done_cond);
+	free(pool->workers);
+	free(pool);
+}
+
+int
+worker_pool_size(struct worker_pool *pool)
+{
+	return pool->nworkers;
+}
+
+struct worker_job *
+worker_pool_submit(struct worker_pool *pool, const char *src, size_t len)
+{
+	struct worker_job *job = calloc(1, sizeof(*job));
+
+	if (job == NULL) {
+		return NULL;
+	}
+
+	job->src = copy_string(src, len);
+	if (job->src == NULL) {
+		free(job);
+		return NULL;
+	}
+	job->len = len;
+	job->pool = pool;
+
+	pthread_mutex_lock(&pool->done_lock);
+	pool->submitted++;
+	pthread_mutex_unlock(&pool->done_lock);
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->tail != NULL) {
+		pool->tail->next = job;
+	} else {
+		pool->head = job;
+	}
+	pool->tail = job;
+	if (pool->idle > 0) {
+		pthread_cond_signal(&pool->wakeup);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return job;
+}
+
+void
+worker_pool_wait_all(struct worker_pool *pool)
+{
+	pthread_mutex_lock(&pool->done_lock);
+	while (pool->completed < pool->submitted) {
+		pthread_cond_wait(&pool->done_cond, &pool->done_lock);
+	}
+	pthread_mutex_unlock(&pool->done_lock);
+}
+
+int
+worker_job_done(struct worker_job *job)
+{
+	return atomic_load_explicit(&job->done, memory_order_acquire);
+}
+
+int
+worker_job_wait(struct worker_job *job, const char **result, size_t *len)
+{
+	struct worker_pool *pool = job->pool;
+
+	if (!worker_job_done(job)) {
+		pthread_mutex_lock(&pool->done_lock);
+		while (!worker_job_done(job)) {
+			pthread_cond_wait(&pool->done_cond, &pool->done_lock);
+		}
+		pthread_mutex_unlock(&pool->done_lock);
+	}
+
+	if (result != NULL) {
+		*result = job->result;
+	}
+	if (len != NULL) {
+		*len = job->result_len;
+	}
+
+	return job->status;
+}
+
+void
+worker_job_free(struct worker_job *job)
+{
+	if (job == NULL) {
+		return;
+	}
+
+	free(job->src);
+	free(job->result);
+	free(job);
+}
@@ -0,0 +1,92 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2025 Joel Pelaez Jorge
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Worker pool.
+ *
+ * One OS thread per core, each one owning a Lua state set up like the REPL
+ * (standard libraries, `channel` plus `val`, `native` and `quit`).
+ * Submitted scripts land in a shared injection queue; workers move them in
+ * batches to their own work-stealing deque and idle workers steal from the
+ * others. Jobs run as coroutines: one blocked on a channel is parked on
+ * its worker, which runs other jobs until the channel wakes it from
+ * whichever thread unblocks it. A plain yield lets other jobs run first,
+ * ("sleep", secs) still sleeps the worker.
+ */
+
+struct worker_pool;
+struct worker_job;
+
+/* Start `nworkers` threads, 0 means one per online CPU. */
+struct worker_pool *worker_pool_create(int nworkers);
+
+/* Run every pending job, stop the threads and free the pool. */
+void worker_pool_destroy(struct worker_pool *pool);
+
+/* Number of worker threads. */
+int worker_pool_size(struct worker_pool *pool);
+
+/*
+ * Queue a script (copied) for execution. Returns NULL if out of memory.
+ * The job must be released with worker_job_free once it's done.
+ */
+struct worker_job *worker_pool_submit(struct worker_pool *pool,
+    const char *src, size_t len);
+
+/* Wait until every submitted job is done. */
+void worker_pool_wait_all(struct worker_pool *pool);
+
+/* Return non-zero if the job already ran. */
+int worker_job_done(struct worker_job *job);
+
+/*
+ * Wait for the job and return its Lua status. On LUA_OK `result` is the
+ * first value returned by the script as a string (NULL for nil), on
+ * error it is the error message. The string belongs to the job.
+ */
+int worker_job_wait(struct worker_job *job, const char **result,
+    size_t *len);
+
+/* Release a finished job. */
+void worker_job_free(struct worker_job *job);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* WORKER_POOL_H */
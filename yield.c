@@ -33,7 +33,12 @@
 #include <lua.h>
 #include <lualib.h>
 
+#include "allocator.h"
+#include "coro_pool.h"
 #include "examples.h"
+#include "preempt.h"
+#include "profiler.h"
+#include "scripts/yield.h"
 
 /**
  * Continucation function for yielable calls
@@ -63,15 +68,9 @@ continuation_func(lua_State *L, int status, __UNUSED lua_KContext ctx)
 static int
 call_lua_with_continuation(lua_State *L)
 {
-	const char *lua_code =
-	    "print('Lua code running...');"
-	    "coroutine.yield(1);"
-	    "print('Lua code resumed... and running again.');"
-	    "coroutine.yield(1);"
-	    "print('Lua code resumed last time');";
-
-	/* Load the Lua chunk onto the stack */
-	if (luaL_loadstring(L, lua_code) != LUA_OK) {
+	/* Load the precompiled scripts/yield.lua onto the stack */
+	if (luaL_loadbufferx(L, (const char *)yield_bytecode,
+		sizeof(yield_bytecode), "=yield", "b") != LUA_OK) {
 		printf("Error loading Lua code: %s\n", lua_tostring(L, -1));
 		return 0;
 	}
@@ -107,25 +106,41 @@ void
 direct_call_to_coroutine(void)
 {
 	/* Create the main Lua state and load libraries */
-	lua_State *L = luaL_newstate();
+	lua_State *L = allocator_newstate(ALLOCATOR_POOL);
 	luaL_openlibs(L);
 
-	/* Create a new thread (coroutine) to run our function in */
-	lua_State *T = lua_newthread(L);
+	/* Take a thread (coroutine) from a pool to run our function in */
+	struct coro_pool *coros = coro_pool_create(L, 1, 0);
+	int ref;
+	lua_State *T = coros ? coro_pool_acquire(coros, &ref) : NULL;
+
+	if (T == NULL) {
+		fprintf(stderr, "can't create a coroutine\n");
+		coro_pool_destroy(coros);
+		allocator_close(L);
+		return;
+	}
 
 	/* Push the C function we want to run onto the new thread's stack */
 	lua_pushcfunction(T, call_lua_with_continuation);
+	profiler_name_cfunction(call_lua_with_continuation,
+	    "call_lua_with_continuation");
 
 	int nresults;
 	int status;
+	int preempted;
 
 	do {
 		/* Resume the coroutine to start or continue execution of
-		 * 'call_lua_with_continuation' */
-		status = lua_resume(T, L, 0, &nresults);
+		 * 'call_lua_with_continuation', with an instruction budget */
+		status = preempt_resume(T, L, 0, &nresults,
+		    PREEMPT_DEFAULT_QUANTUM, &preempted);
 
 		/* Handle the call result inside the coroutine */
-		if (status == LUA_OK) {
+		if (preempted) {
+			/* Used up its quantum, nothing to report */
+			continue;
+		} else if (status == LUA_OK) {
 			/* The call terminates */
 			printf("C code: coroutine ended.\n");
 		} else if (status == LUA_YIELD) {
@@ -140,6 +155,8 @@ direct_call_to_coroutine(void)
 		}
 	} while (status == LUA_YIELD);
 
-	/* Clean up */
-	lua_close(L);
+	/* Clean up, the thread is reset and kept until the pool goes away */
+	coro_pool_release(coros, T, ref);
+	coro_pool_destroy(coros);
+	allocator_close(L);
 }